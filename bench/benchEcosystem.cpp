@@ -0,0 +1,219 @@
+#include <benchmark/benchmark.h>
+#include <sstream>
+#include <unistd.h>
+#include <boost/serialization/vector.hpp>
+#include "benchParameters.h"
+#include "checkpoint.h"
+#include "ecosystem.h"
+#include "lattice.h"
+#include "migrants.h"
+
+/* Every other agent of a population of `state.range(0)` agents is dead */
+static void BM_removeDeadAgents(benchmark::State &state) {
+  unsigned numAgents = state.range(0);
+  Population p(16);
+  p.reserve(numAgents);
+  SlotVector order;
+  order.reserve(numAgents);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    p.clear();
+    order.clear();
+    for (unsigned n = 0; n < numAgents; n++) {
+      unsigned slot = p.allocate(false);
+      p.setEnergy(slot, n % 2);
+      order.push_back(slot);
+    }
+    state.ResumeTiming();
+
+    benchmark::DoNotOptimize(removeDeadAgents(p, order));
+  }
+  state.SetItemsProcessed(state.iterations() * numAgents);
+}
+BENCHMARK(BM_removeDeadAgents)
+->ArgName("agents")->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+/* Population sizes crossed with chromosome sizes from 16 B to 64 KB, up to
+ * a 32 MB slab */
+static void ecosystemSizes(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"agents", "bytes"});
+  for (long agents = 256; agents <= 16384; agents *= 8) {
+    for (long bytes = 16; bytes <= (64 << 10); bytes *= 8) {
+      if (agents * bytes <= (32 << 20)) {
+        b->Args({agents, bytes});
+      }
+    }
+  }
+}
+
+/* One generation per iteration, after a few generations of warm-up so the
+ * population has reached its working size */
+static void BM_ecosystemRun(benchmark::State &state) {
+  Parameters params = benchParameters();
+  params.sizePopulation = state.range(0);
+  params.sizeChromosome = state.range(1);
+
+  Ecosystem e(params, 1);
+  e.run(5);
+
+  int64_t numAgents = 0;
+  for (auto _ : state) {
+    numAgents += e.size();
+    e.run(1);
+  }
+  state.SetItemsProcessed(numAgents);
+}
+BENCHMARK(BM_ecosystemRun)->Apply(ecosystemSizes)->Unit(benchmark::kMillisecond);
+
+/* One generation of a square lattice of side `state.range(0)` per
+ * iteration, to compare with `BM_ecosystemRun` at as many agents */
+static void BM_latticeRun(benchmark::State &state) {
+  Parameters params = benchParameters();
+  params.sizeChromosome = state.range(1);
+
+  Lattice lattice(params, state.range(0), state.range(0), 1);
+  lattice.run(5);
+
+  for (auto _ : state) {
+    lattice.run(1);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(0));
+}
+BENCHMARK(BM_latticeRun)->ArgNames({"side", "bytes"})
+->ArgsProduct({{16, 128}, {16, 128, 1024}})->Unit(benchmark::kMillisecond);
+
+/* Pairs a population of `state.range(1)` agents scattered over twice as
+ * many slots, with engine `state.range(0)` (0 shuffle, 1 permutation) */
+static void BM_pairing(benchmark::State &state) {
+  std::unique_ptr<PairingEngine> engine =
+    createPairingEngine(state.range(0) ? "permutation" : "shuffle");
+  unsigned numAgents = state.range(1);
+  ThreadPool pool(1);
+
+  Population p(16);
+  p.reserve(2 * numAgents);
+  SlotVector order;
+  for (unsigned n = 0; n < 2 * numAgents; n++) {
+    unsigned slot = p.allocate(false);
+    if (n % 2) {
+      order.push_back(slot);
+    }
+  }
+
+  uint64_t stream = 0;
+  for (auto _ : state) {
+    engine->arrange(p, order, 1, stream++, pool);
+  }
+  state.SetItemsProcessed(state.iterations() * numAgents);
+}
+BENCHMARK(BM_pairing)->ArgNames({"engine", "agents"})
+->ArgsProduct({{0, 1}, {1 << 10, 1 << 15, 1 << 20}});
+
+/* Saves `state.range(1)` agents of 64 bytes, scattered over twice as many
+ * slots, gathered from the population (mode 0) or from a snapshot taken
+ * beforehand (mode 1).  The file is not synced by the page cache until
+ * `commit`, so this is mostly the cost of producing the file */
+static void BM_writeCheckpoint(benchmark::State &state) {
+  unsigned numAgents = state.range(1);
+  Parameters params = benchParameters();
+  params.sizeChromosome = 64;
+
+  Population p(params.sizeChromosome);
+  p.reserve(2 * numAgents);
+  SlotVector order;
+  for (unsigned n = 0; n < 2 * numAgents; n++) {
+    unsigned slot = p.allocate();
+    p.setEnergy(slot, n);
+    if (n % 2) {
+      order.push_back(slot);
+    }
+  }
+
+  CheckpointSnapshot snapshot;
+  snapshot.capture(params, 1, 0, p, order);
+  for (auto _ : state) {
+    if (state.range(0)) {
+      snapshot.write("bench.ckpt", false);
+    } else {
+      writeCheckpoint("bench.ckpt", params, 1, 0, p, order);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * numAgents *
+                          (sizeof(double) + sizeof(uint32_t) +
+                           params.sizeChromosome));
+  unlink("bench.ckpt");
+}
+BENCHMARK(BM_writeCheckpoint)->ArgNames({"snapshot", "agents"})
+->ArgsProduct({{0, 1}, {1 << 14, 1 << 20}})->Unit(benchmark::kMillisecond);
+
+/* Packs and unpacks 256 migrants of `state.range(0)` bytes, as a Boost
+ * archive of agents and as a migrant batch */
+static void migrantSizes(benchmark::internal::Benchmark *b) {
+  b->ArgName("bytes")->RangeMultiplier(8)->Range(16, 64 << 10);
+}
+
+static const unsigned numMigrants = 256;
+
+static void BM_migrantArchive(benchmark::State &state) {
+  unsigned size = state.range(0);
+  Population p(size);
+  for (unsigned n = 0; n < numMigrants; n++) {
+    p.setEnergy(p.allocate(), n);
+  }
+
+  Population q(size);
+  for (auto _ : state) {
+    std::vector<Agent> agents;
+    for (unsigned n = 0; n < numMigrants; n++) {
+      agents.push_back(p.getAgent(n));
+    }
+
+    std::ostringstream oss;
+    boost::archive::binary_oarchive oa(oss);
+    oa << agents;
+
+    std::istringstream iss(oss.str());
+    boost::archive::binary_iarchive ia(iss);
+    ia >> agents;
+
+    q.clear();
+    for (unsigned n = 0; n < agents.size(); n++) {
+      q.insert(agents[n]);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * numMigrants);
+}
+BENCHMARK(BM_migrantArchive)->Apply(migrantSizes);
+
+static void BM_migrantBatch(benchmark::State &state) {
+  unsigned size = state.range(0);
+  Population p(size);
+  for (unsigned n = 0; n < numMigrants; n++) {
+    p.setEnergy(p.allocate(), n);
+  }
+
+  Population q(size);
+  MigrantBatch batch;
+  MigrantBatch received;
+  for (auto _ : state) {
+    batch.clear(size);
+    for (unsigned n = 0; n < numMigrants; n++) {
+      batch.append(p, n);
+    }
+
+    received.data().swap(batch.data());
+    received.validate();
+
+    q.clear();
+    for (unsigned n = 0; n < received.size(); n++) {
+      received.insert(q, n);
+    }
+    received.data().swap(batch.data());
+  }
+  state.SetItemsProcessed(state.iterations() * numMigrants);
+}
+BENCHMARK(BM_migrantBatch)->Apply(migrantSizes);
+
+BENCHMARK_MAIN();
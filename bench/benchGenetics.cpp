@@ -0,0 +1,176 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <vector>
+#include "agent.h"
+#include "benchParameters.h"
+#include "population.h"
+
+/* Chromosome sizes from 16 B to 64 KB */
+static void chromosomeSizes(benchmark::internal::Benchmark *b) {
+  b->ArgName("bytes")->RangeMultiplier(8)->Range(16, 64 << 10);
+}
+
+/* Population sizes from 1K to 1M agents */
+static void populationSizes(benchmark::internal::Benchmark *b) {
+  b->ArgName("agents")->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+}
+
+/* Population of `size`-byte chromosomes with two random agents, in slots 0
+ * and 1, and a free slot 2 for their children */
+static Population pairPopulation(unsigned size, Random &random) {
+  Population population(size);
+  for (unsigned n = 0; n < 3; n++) {
+    unsigned slot = population.allocate();
+    Buffer::Word *c = population.chromosome(slot);
+    for (unsigned k = 0; k < size / Buffer::wordBytes; k++) {
+      c[k] = (n < 2) ? random() : 0;
+    }
+    population.countOnes(slot);
+    population.setEnergy(slot, 1.0);
+  }
+  return population;
+}
+
+static void BM_predation(benchmark::State &state) {
+  Parameters params = benchParameters();
+  Random random(1);
+  Population p = pairPopulation(state.range(0), random);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(predation(p, 0, 1, params, random));
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * state.range(0));
+}
+BENCHMARK(BM_predation)->Apply(chromosomeSizes);
+
+/* `2 * numPairs` random agents of `p`, paired at random */
+static std::vector<unsigned> randomPairs(Population &p, unsigned numPairs,
+    Random &random) {
+  std::vector<unsigned> pairs(2 * numPairs);
+  for (unsigned k = 0; k < 2 * numPairs; k++) {
+    pairs[k] = p.allocate();
+    Buffer::Word *c = p.chromosome(pairs[k]);
+    for (unsigned n = 0; n < p.sizeChromosome() / Buffer::wordBytes; n++) {
+      c[n] = random();
+    }
+    p.countOnes(pairs[k]);
+  }
+  std::shuffle(pairs.begin(), pairs.end(), random);
+  return pairs;
+}
+
+/* A feeding round's worth of encounters, one `predation` call per pair or
+ * in batches */
+static void BM_predationBatch(benchmark::State &state) {
+  const unsigned numPairs = 512;
+  Parameters params = benchParameters();
+  Random random(1);
+  Population p(state.range(0));
+  std::vector<unsigned> pairs = randomPairs(p, numPairs, random);
+
+  std::vector<PredationOutcome> outcomes(numPairs);
+  for (auto _ : state) {
+    if (state.range(1)) {
+      predation(p, pairs.data(), numPairs, params, random, outcomes.data());
+    } else {
+      for (unsigned k = 0; k < numPairs; k++) {
+        outcomes[k] = predation(p, pairs[2 * k], pairs[2 * k + 1], params,
+                                random);
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numPairs);
+}
+BENCHMARK(BM_predationBatch)
+->ArgNames({"bytes", "batched"})
+->ArgsProduct({{16, 64, 256, 1024}, {0, 1}});
+
+/* A mating round's worth of courtships, one `mate` call per pair or in
+ * batches */
+static void BM_mateBatch(benchmark::State &state) {
+  const unsigned numPairs = 512;
+  Parameters params = benchParameters();
+  Random random(1);
+  Population p(state.range(0));
+  std::vector<unsigned> pairs = randomPairs(p, numPairs, random);
+
+  std::vector<uint64_t> mask(numPairs / 64);
+  for (auto _ : state) {
+    if (state.range(1)) {
+      mate(p, pairs.data(), numPairs, params, random, mask.data());
+    } else {
+      for (unsigned k = 0; k < numPairs; k++) {
+        uint64_t bit = mate(p, pairs[2 * k], pairs[2 * k + 1], params,
+                            random);
+        mask[k / 64] ^= bit << (k % 64);
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * numPairs);
+}
+BENCHMARK(BM_mateBatch)
+->ArgNames({"bytes", "batched"})
+->ArgsProduct({{16, 64, 256, 1024}, {0, 1}});
+
+static void BM_crossover(benchmark::State &state) {
+  Parameters params = benchParameters();
+  Random random(1);
+  Population p = pairPopulation(state.range(0), random);
+
+  for (auto _ : state) {
+    crossover(p, 0, 1, 2, params, random);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_crossover)->Apply(chromosomeSizes);
+
+static void BM_mutate(benchmark::State &state) {
+  Parameters params = benchParameters();
+  Random random(1);
+  Population p = pairPopulation(state.range(0), random);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mutate(p, 2, params, random));
+  }
+}
+BENCHMARK(BM_mutate)->Apply(chromosomeSizes);
+
+static void BM_mate(benchmark::State &state) {
+  Parameters params = benchParameters();
+  Random random(1);
+  Population p = pairPopulation(state.range(0), random);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mate(p, 0, 1, params, random));
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * state.range(0));
+}
+BENCHMARK(BM_mate)->Apply(chromosomeSizes);
+
+/* One starvation round over a whole population.  The chromosomes play no
+ * part, so they are kept small */
+static void BM_starve(benchmark::State &state) {
+  Parameters params = benchParameters();
+  Random random(1);
+  unsigned numAgents = state.range(0);
+
+  Population p(16);
+  p.reserve(numAgents);
+  for (unsigned n = 0; n < numAgents; n++) {
+    p.allocate();
+  }
+
+  for (auto _ : state) {
+    for (unsigned slot = 0; slot < numAgents; slot++) {
+      p.setEnergy(slot, 1e9);
+      benchmark::DoNotOptimize(starve(p, slot, params, random));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * numAgents);
+}
+BENCHMARK(BM_starve)->Apply(populationSizes);
+
+BENCHMARK_MAIN();
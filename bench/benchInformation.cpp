@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+#include "information.h"
+#include "kernels.h"
+#include "rng.h"
+
+/* Chromosome sizes from 16 B to 64 KB */
+static void chromosomeSizes(benchmark::internal::Benchmark *b) {
+  b->ArgName("bytes")->RangeMultiplier(8)->Range(16, 64 << 10);
+}
+
+/* Buffer of `size` random bytes */
+static Buffer randomBuffer(unsigned size, uint64_t seed) {
+  Random random(seed);
+  Buffer buffer(size, 0x00);
+  for (unsigned k = 0; k < size; k++) {
+    buffer[k] = (char) random();
+  }
+  return buffer;
+}
+
+static void BM_hammingWeight(benchmark::State &state) {
+  Buffer a = randomBuffer(state.range(0), 1);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(hammingWeight(a));
+  }
+  state.SetBytesProcessed(state.iterations() * a.size());
+}
+BENCHMARK(BM_hammingWeight)->Apply(chromosomeSizes);
+
+static void BM_distance(benchmark::State &state) {
+  Buffer a = randomBuffer(state.range(0), 1);
+  Buffer b = randomBuffer(state.range(0), 2);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(distance(a, b));
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * a.size());
+}
+BENCHMARK(BM_distance)->Apply(chromosomeSizes);
+
+static void BM_shannonEntropy(benchmark::State &state) {
+  Buffer a = randomBuffer(state.range(0), 1);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(shannonEntropy(a));
+  }
+  state.SetBytesProcessed(state.iterations() * a.size());
+}
+BENCHMARK(BM_shannonEntropy)->Apply(chromosomeSizes);
+
+/* `distance` with each popcount kernel the CPU supports */
+static void BM_distanceKernel(benchmark::State &state) {
+  PopcountKernel kernel = (PopcountKernel) state.range(1);
+  if (!popcountKernelSupported(kernel)) {
+    state.SkipWithError("kernel not supported by this CPU");
+    return;
+  }
+
+  Buffer a = randomBuffer(state.range(0), 1);
+  Buffer b = randomBuffer(state.range(0), 2);
+  PopcountKernel previous = getPopcountKernel();
+  setPopcountKernel(kernel);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(distance(a, b));
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * a.size());
+  state.SetLabel(popcountKernelName(kernel));
+
+  setPopcountKernel(previous);
+}
+BENCHMARK(BM_distanceKernel)
+->ArgNames({"bytes", "kernel"})
+->ArgsProduct({
+  benchmark::CreateRange(16, 64 << 10, 8),
+  {POPCOUNT_TABLE, POPCOUNT_SCALAR, POPCOUNT_POPCNT, POPCOUNT_AVX2,
+   POPCOUNT_AVX512}
+});
+
+/* `distance` at the fixed lengths, with and without their own kernels */
+static void BM_distanceFixedLength(benchmark::State &state) {
+  Buffer a = randomBuffer(state.range(0), 1);
+  Buffer b = randomBuffer(state.range(0), 2);
+  bool previous = getFixedLengthKernels();
+  setFixedLengthKernels(state.range(1));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(distance(a, b));
+  }
+  state.SetBytesProcessed(state.iterations() * 2 * a.size());
+
+  setFixedLengthKernels(previous);
+}
+BENCHMARK(BM_distanceFixedLength)
+->ArgNames({"bytes", "fixed"})
+->ArgsProduct({{64, 256, 1024}, {0, 1}});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,24 @@
+#ifndef BENCHPARAMETERS_H
+#define BENCHPARAMETERS_H
+
+#include "parameters.h"
+
+/* Model parameters shared by the benchmarks: 1024 agents of 128 bytes */
+static inline Parameters benchParameters(void) {
+  Parameters params;
+  params.sizePopulation = 1024;
+  params.sizeChromosome = 128;
+  params.muNumMutations = 2.0;
+  params.muNumCrossovers = 1.5;
+  params.lambdaEnergy = 3.0;
+  params.sigmaPredation = 1.0;
+  params.lambdaPredation = 0.1;
+  params.lambdaScoreFeed = 1.0;
+  params.lambdaEntropyFeed = 1.0;
+  params.muEnergyStarve = 1.0;
+  params.muMating = 0.5;
+  return params;
+}
+
+
+#endif /* end of include guard: BENCHPARAMETERS_H */
@@ -0,0 +1,81 @@
+#include <stdexcept>
+#include "halo.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Lattice bands                                                              *
+ * -------------------------------------------------------------------------- */
+
+void latticeBand(unsigned height, unsigned size, unsigned rank,
+                 unsigned &firstRow, unsigned &numRows) {
+  if (size == 0 || size > height || rank >= size) {
+    throw std::invalid_argument("cannot split the lattice into these bands");
+  }
+
+  firstRow = (uint64_t) rank * height / size;
+  numRows = (uint64_t)(rank + 1) * height / size - firstRow;
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Halo exchange                                                              *
+ * -------------------------------------------------------------------------- */
+
+TransportHalo::TransportHalo(Transport &transport) :
+  m_transport(transport) { }
+
+void TransportHalo::exchange(Lattice &lattice) {
+  unsigned size = m_transport.size();
+  unsigned rank = m_transport.rank();
+  unsigned above = (rank + size - 1) % size;
+  unsigned below = (rank + 1) % size;
+  unsigned last = lattice.numRows();
+  unsigned sizeChromosome = lattice.getPopulation().sizeChromosome();
+
+  /* With two bands the island above is also the one below, and gets both
+   * rows in one message: the last row, then the first */
+  unsigned numPeers = above == below ? 1 : 2;
+  m_rows.resize(numPeers);
+  m_outgoing.resize(numPeers);
+  m_incoming.resize(numPeers);
+  for (unsigned n = 0; n < numPeers; n++) {
+    m_rows[n].clear(sizeChromosome);
+  }
+
+  if (numPeers == 1) {
+    lattice.packRow(last, m_rows[0]);
+    lattice.packRow(1, m_rows[0]);
+  } else {
+    lattice.packRow(1, m_rows[0]);
+    lattice.packRow(last, m_rows[1]);
+  }
+
+  for (unsigned n = 0; n < numPeers; n++) {
+    m_outgoing[n].peer = n == 0 ? above : below;
+    m_outgoing[n].data.swap(m_rows[n].data());
+    m_incoming[n].peer = n == 0 ? above : below;
+  }
+
+  m_transport.exchange(m_outgoing, m_incoming);
+
+  for (unsigned n = 0; n < numPeers; n++) {
+    m_outgoing[n].data.swap(m_rows[n].data());
+  }
+
+  /* The island above sends its last row, which sits above the band, and
+   * the island below its first row */
+  m_halo.data().swap(m_incoming[0].data);
+  m_halo.validate();
+  lattice.unpackRow(0, m_halo);
+  if (numPeers == 1) {
+    lattice.unpackRow(last + 1, m_halo, lattice.width());
+  }
+  m_halo.data().swap(m_incoming[0].data);
+
+  if (numPeers == 2) {
+    m_halo.data().swap(m_incoming[1].data);
+    m_halo.validate();
+    lattice.unpackRow(last + 1, m_halo);
+    m_halo.data().swap(m_incoming[1].data);
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef HALO_H
+#define HALO_H
+
+#include <vector>
+#include "lattice.h"
+#include "migrants.h"
+#include "transport.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Lattice bands                                                              *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Splits the `height` rows of a torus into `size` bands of nearly
+ *  equal height, in order.  Band `rank` starts at row `firstRow` and has
+ *  `numRows` rows.
+ *
+ * @note This function throws an exception when there are more bands than
+ *  rows.
+ */
+void latticeBand(unsigned height, unsigned size, unsigned rank,
+                 unsigned &firstRow, unsigned &numRows);
+
+
+/* -------------------------------------------------------------------------- *
+ * Halo exchange                                                              *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Halo exchange between the bands of one torus, where band `r` (see
+ *  `latticeBand`) is run by island `r` of a cluster.  Every exchange sends
+ *  the first row of the band to the island above and its last row to the
+ *  island below, as `MigrantBatch` messages, and receives both halo rows
+ *  at the same time.
+ */
+class TransportHalo : public HaloExchange {
+ private:
+  Transport &m_transport;
+
+  /* Reused by every exchange */
+  std::vector<MigrantBatch> m_rows;   //! Outgoing rows, one batch per peer
+  MigrantBatch m_halo;
+  std::vector<Message> m_outgoing;
+  std::vector<Message> m_incoming;
+
+ public:
+
+  /* `transport` connects the islands; must outlive the exchange */
+  explicit TransportHalo(Transport &transport);
+
+  /**
+   * @note This function throws an exception when another island cannot be
+   *  reached or sends a malformed row.
+   */
+  void exchange(Lattice &lattice);
+};
+
+
+#endif /* end of include guard: HALO_H */
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include "island.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Migration topologies                                                       *
+ * -------------------------------------------------------------------------- */
+
+void migrationPeers(MigrationTopology topology, unsigned rank, unsigned size,
+                    uint64_t seed, uint64_t generation,
+                    std::vector<unsigned> &destinations,
+                    std::vector<unsigned> &sources) {
+  destinations.clear();
+  sources.clear();
+  if (size < 2) {
+    return;
+  }
+
+  switch (topology) {
+  case TOPOLOGY_RING:
+    destinations.push_back((rank + 1) % size);
+    sources.push_back((rank + size - 1) % size);
+    break;
+
+  case TOPOLOGY_FULL:
+    for (unsigned peer = 0; peer < size; peer++) {
+      if (peer != rank) {
+        destinations.push_back(peer);
+        sources.push_back(peer);
+      }
+    }
+    break;
+
+  case TOPOLOGY_RANDOM: {
+    std::vector<unsigned> ring(size);
+    std::iota(ring.begin(), ring.end(), 0);
+    Random random(seed, generation);
+    std::shuffle(ring.begin(), ring.end(), random);
+
+    unsigned position = std::find(ring.begin(), ring.end(), rank) -
+                        ring.begin();
+    destinations.push_back(ring[(position + 1) % size]);
+    sources.push_back(ring[(position + size - 1) % size]);
+    break;
+  }
+
+  default:
+    throw std::invalid_argument("unknown migration topology");
+  }
+}
+
+const char *migrationTopologyName(MigrationTopology topology) {
+  switch (topology) {
+  case TOPOLOGY_RING:
+    return "ring";
+  case TOPOLOGY_FULL:
+    return "full";
+  case TOPOLOGY_RANDOM:
+    return "random";
+  default:
+    return "unknown";
+  }
+}
+
+uint64_t islandSeed(uint64_t seed, unsigned rank) {
+  Random random(seed, rank);
+  return random();
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Island class                                                               *
+ * -------------------------------------------------------------------------- */
+
+Island::Island(const Parameters &params, uint64_t seed, Transport &transport,
+               const MigrationPolicy &policy) :
+  m_ecosystem(params, islandSeed(seed, transport.rank())),
+  m_transport(transport), m_policy(policy), m_seed(seed),
+  m_numEmigrants(0), m_numImmigrants(0) {
+  if (policy.interval == 0) {
+    throw std::invalid_argument("the migration interval must be positive");
+  }
+
+  if (!(policy.rate >= 0 && policy.rate <= 1)) {
+    throw std::invalid_argument("the migration rate must be in [0, 1]");
+  }
+}
+
+void Island::run(unsigned numIterations, unsigned numThreads) {
+  for (unsigned i = 0; i < numIterations; i++) {
+    m_ecosystem.run(1, numThreads);
+    if (m_ecosystem.getGeneration() % m_policy.interval == 0) {
+      migrate();
+    }
+  }
+}
+
+void Island::migrate(void) {
+  migrationPeers(m_policy.topology, m_transport.rank(), m_transport.size(),
+                 m_seed, m_ecosystem.getGeneration(), m_destinations,
+                 m_sources);
+  if (m_destinations.empty()) {
+    return;
+  }
+
+  /* The emigrants are split as evenly as possible between destinations.
+   * Each batch is swapped into its message, so neither is copied */
+  unsigned sizeChromosome = m_ecosystem.getParameters().sizeChromosome;
+  unsigned numEmigrants = std::lround(m_policy.rate * m_ecosystem.size());
+  unsigned numDestinations = m_destinations.size();
+  m_emigrants.resize(numDestinations);
+  m_outgoing.resize(numDestinations);
+  for (unsigned n = 0; n < numDestinations; n++) {
+    unsigned count = numEmigrants / numDestinations +
+                     (n < numEmigrants % numDestinations);
+    m_emigrants[n].clear(sizeChromosome);
+    m_ecosystem.emigrate(count, m_emigrants[n], n);
+    m_numEmigrants += m_emigrants[n].size();
+
+    m_outgoing[n].peer = m_destinations[n];
+    m_outgoing[n].data.swap(m_emigrants[n].data());
+  }
+
+  m_incoming.resize(m_sources.size());
+  for (unsigned n = 0; n < m_sources.size(); n++) {
+    m_incoming[n].peer = m_sources[n];
+  }
+
+  m_transport.exchange(m_outgoing, m_incoming);
+
+  for (unsigned n = 0; n < numDestinations; n++) {
+    m_outgoing[n].data.swap(m_emigrants[n].data());
+  }
+
+  /* Immigrants join in the order of their sources, which keeps the run
+   * reproducible */
+  for (unsigned n = 0; n < m_incoming.size(); n++) {
+    m_immigrants.data().swap(m_incoming[n].data);
+    m_immigrants.validate();
+    m_ecosystem.immigrate(m_immigrants);
+    m_numImmigrants += m_immigrants.size();
+    m_immigrants.data().swap(m_incoming[n].data);
+  }
+}
+
+Ecosystem &Island::getEcosystem(void) {
+  return m_ecosystem;
+}
+
+const Ecosystem &Island::getEcosystem(void) const {
+  return m_ecosystem;
+}
+
+uint64_t Island::getNumEmigrants(void) const {
+  return m_numEmigrants;
+}
+
+uint64_t Island::getNumImmigrants(void) const {
+  return m_numImmigrants;
+}
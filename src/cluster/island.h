@@ -0,0 +1,117 @@
+#ifndef ISLAND_H
+#define ISLAND_H
+
+#include <cstdint>
+#include <vector>
+#include "ecosystem.h"
+#include "transport.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Island model                                                               *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Which islands exchange migrants.
+ *
+ *    Topology          Migrants of island `r` go to
+ *
+ *    TOPOLOGY_RING     Island `r + 1`, wrapping around
+ *    TOPOLOGY_FULL     Every other island, in equal shares
+ *    TOPOLOGY_RANDOM   The next island on a ring that is shuffled anew at
+ *                      every migration
+ */
+typedef enum {
+  TOPOLOGY_RING,
+  TOPOLOGY_FULL,
+  TOPOLOGY_RANDOM
+} MigrationTopology;
+
+/* When and where agents migrate */
+typedef struct {
+  MigrationTopology topology;
+  double rate;          //! Fraction of each island that leaves at a time
+  unsigned interval;    //! Generations between two migrations
+} MigrationPolicy;
+
+/**
+ * @brief Islands that island `rank` sends migrants to and receives them from
+ *  at the migration after `generation`.  Every island computes the same
+ *  pattern from the master seed, so no coordination is needed.
+ *
+ * @param destinations filled with the destinations, in increasing order
+ *  for fixed topologies
+ * @param sources filled with the sources, in the same kind of order
+ */
+void migrationPeers(MigrationTopology topology, unsigned rank, unsigned size,
+                    uint64_t seed, uint64_t generation,
+                    std::vector<unsigned> &destinations,
+                    std::vector<unsigned> &sources);
+
+/* Human readable name of a topology, e.g. "ring" */
+const char *migrationTopologyName(MigrationTopology topology);
+
+/**
+ * @brief Seed of the ecosystem of island `rank`, derived from the master
+ *  seed of the cluster
+ */
+uint64_t islandSeed(uint64_t seed, unsigned rank);
+
+/**
+ * @brief One island of a cluster: an ecosystem that runs on its own and
+ *  trades migrants with other islands every `interval` generations.  The
+ *  migrants are chosen at random and travel as `MigrantBatch` messages.
+ *  With the same seed, policy and number of islands, a cluster evolves
+ *  identically whatever the transport.
+ */
+class Island {
+ private:
+  Ecosystem m_ecosystem;
+  Transport &m_transport;
+  MigrationPolicy m_policy;
+  uint64_t m_seed;              //! Master seed of the cluster
+  uint64_t m_numEmigrants;      //! Agents sent so far
+  uint64_t m_numImmigrants;     //! Agents received so far
+
+  /* Reused by every migration */
+  std::vector<unsigned> m_destinations;
+  std::vector<unsigned> m_sources;
+  std::vector<MigrantBatch> m_emigrants;   //! One batch per destination
+  MigrantBatch m_immigrants;
+  std::vector<Message> m_outgoing;
+  std::vector<Message> m_incoming;
+
+  void migrate(void);
+
+ public:
+
+  /**
+   * @brief Creates island `transport.rank()` with `sizePopulation` blank
+   *  agents
+   *
+   * @param seed master seed of the cluster
+   * @param transport connects the islands; must outlive the island
+   */
+  Island(const Parameters &params, uint64_t seed, Transport &transport,
+         const MigrationPolicy &policy);
+
+  /**
+   * @brief Runs `numIterations` generations, migrating whenever the
+   *  generation is a multiple of the interval.  Every island of the cluster
+   *  must run the same generations.
+   *
+   * @note This function throws an exception when another island cannot be
+   *  reached.
+   */
+  void run(unsigned numIterations, unsigned numThreads = 1);
+
+  /* The local ecosystem, e.g. to resume it from a checkpoint */
+  Ecosystem &getEcosystem(void);
+  const Ecosystem &getEcosystem(void) const;
+
+  uint64_t getNumEmigrants(void) const;
+  uint64_t getNumImmigrants(void) const;
+};
+
+
+#endif /* end of include guard: ISLAND_H */
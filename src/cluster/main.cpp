@@ -0,0 +1,310 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include "halo.h"
+#include "island.h"
+#include "options.h"
+
+namespace po = boost::program_options;
+
+
+/* -------------------------------------------------------------------------- *
+ * Command line                                                               *
+ * -------------------------------------------------------------------------- */
+
+/* Settings of a cluster run that are not model parameters */
+typedef struct {
+  unsigned numIterations;   //! Number of generations to run
+  unsigned numThreads;      //! Number of threads per island
+  uint64_t seed;            //! Master seed of the cluster
+  std::string transport;    //! local, unix or tcp
+  unsigned numIslands;      //! Number of islands
+  unsigned rank;            //! Island run by this process (unix and tcp)
+  std::string address;      //! Socket directory, or host:port list
+  std::string topology;     //! Migration topology
+  double rate;              //! Fraction of each island that migrates
+  unsigned interval;        //! Generations between two migrations
+  std::string checkpoint;   //! Prefix of the final checkpoints
+  std::string pairing;      //! Pairing engine of every island
+  unsigned latticeWidth;    //! Columns of the torus, 0 for islands
+  unsigned latticeHeight;   //! Rows of the torus
+} Settings;
+
+static po::options_description clusterOptions(Settings &settings) {
+  po::options_description options("Cluster");
+  options.add_options()
+  ("iterations,n", po::value(&settings.numIterations)->default_value(1000),
+   "number of generations to run")
+  ("threads,t", po::value(&settings.numThreads)->default_value(1),
+   "number of threads per island")
+  ("seed,s", po::value(&settings.seed)->default_value(0),
+   "master seed of the cluster")
+  ("transport", po::value(&settings.transport)->default_value("local"),
+   "how islands talk: `local` forks every island from this process, "
+   "`unix` and `tcp` run one island per process")
+  ("islands,N", po::value(&settings.numIslands)->default_value(4),
+   "number of islands (local and unix)")
+  ("rank,r", po::value(&settings.rank)->default_value(0),
+   "island run by this process (unix and tcp)")
+  ("address", po::value(&settings.address),
+   "directory of the Unix sockets, or comma-separated host:port of every "
+   "island for tcp")
+  ("topology", po::value(&settings.topology)->default_value("ring"),
+   "migration topology: ring, full or random")
+  ("migrationRate", po::value(&settings.rate)->default_value(0.01),
+   "fraction of each island that leaves at every migration")
+  ("migrationInterval", po::value(&settings.interval)->default_value(10),
+   "generations between two migrations")
+  ("pairing", po::value(&settings.pairing)->default_value("shuffle"),
+   "pairing engine: shuffle or permutation")
+  ("latticeWidth", po::value(&settings.latticeWidth)->default_value(0),
+   "instead of islands, run one lattice (torus) of this many columns, "
+   "split into bands of rows, one per process.  Migration options are "
+   "ignored.")
+  ("latticeHeight", po::value(&settings.latticeHeight)->default_value(0),
+   "rows of the lattice")
+  ("checkpoint,k", po::value(&settings.checkpoint),
+   "write island `r` to the flat checkpoint `<checkpoint>.<r>` when the "
+   "run is over");
+  return options;
+}
+
+static MigrationTopology parseTopology(const std::string &name) {
+  const MigrationTopology topologies[] = {
+    TOPOLOGY_RING, TOPOLOGY_FULL, TOPOLOGY_RANDOM
+  };
+
+  for (MigrationTopology topology : topologies) {
+    if (name == migrationTopologyName(topology)) {
+      return topology;
+    }
+  }
+  throw std::invalid_argument("unknown topology " + name);
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Driver                                                                     *
+ * -------------------------------------------------------------------------- */
+
+static void runIsland(const Settings &settings, const Parameters &params,
+                      Transport &transport) {
+  MigrationPolicy policy;
+  policy.topology = parseTopology(settings.topology);
+  policy.rate = settings.rate;
+  policy.interval = settings.interval;
+
+  Island island(params, settings.seed, transport, policy);
+  island.getEcosystem().setPairingEngine(
+    createPairingEngine(settings.pairing));
+
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  island.run(settings.numIterations, settings.numThreads);
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  if (!settings.checkpoint.empty()) {
+    island.getEcosystem().saveCheckpoint(settings.checkpoint + "." +
+                                         std::to_string(transport.rank()));
+  }
+
+  /* One write per island, so lines of forked islands do not interleave */
+  const Ecosystem &ecosystem = island.getEcosystem();
+  std::ostringstream oss;
+  oss << "island " << transport.rank()
+      << "  agents " << ecosystem.size()
+      << "  meanEntropy " << ecosystem.meanEntropy()
+      << "  emigrants " << island.getNumEmigrants()
+      << "  immigrants " << island.getNumImmigrants()
+      << "  generations/sec " << settings.numIterations / elapsed.count()
+      << std::endl;
+  std::cout << oss.str() << std::flush;
+}
+
+/* Runs band `rank` of a lattice, and trades halos with the other bands */
+static void runBand(const Settings &settings, const Parameters &params,
+                    Transport &transport) {
+  unsigned firstRow;
+  unsigned numRows;
+  latticeBand(settings.latticeHeight, transport.size(), transport.rank(),
+              firstRow, numRows);
+
+  Lattice lattice(params, settings.latticeWidth, settings.latticeHeight,
+                  settings.seed, firstRow, numRows);
+  lattice.setHaloExchange(std::unique_ptr<HaloExchange>(
+                            new TransportHalo(transport)));
+
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  lattice.run(settings.numIterations, settings.numThreads);
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  std::ostringstream oss;
+  oss << "band " << transport.rank()
+      << "  rows " << firstRow << "-" << firstRow + numRows - 1
+      << "  agents " << lattice.size()
+      << "  meanEntropy " << lattice.meanEntropy()
+      << "  generations/sec " << settings.numIterations / elapsed.count()
+      << std::endl;
+  std::cout << oss.str() << std::flush;
+}
+
+static void runRank(const Settings &settings, const Parameters &params,
+                    Transport &transport) {
+  if (settings.latticeWidth > 0) {
+    runBand(settings, params, transport);
+  } else {
+    runIsland(settings, params, transport);
+  }
+}
+
+/* Forks one process per island, connected by socket pairs */
+static int runLocal(const Settings &settings, const Parameters &params) {
+  std::vector<std::vector<int>> mesh = socketMesh(settings.numIslands);
+  std::vector<pid_t> children;
+
+  for (unsigned rank = 0; rank < settings.numIslands; rank++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      throw std::runtime_error("cannot fork island");
+    }
+
+    if (pid == 0) {
+      int status = 0;
+      try {
+        std::unique_ptr<SocketTransport> transport = meshTransport(mesh, rank);
+        runRank(settings, params, *transport);
+      }
+
+      catch (const std::exception &e) {
+        std::cerr << "island " << rank << ": " << e.what() << std::endl;
+        status = 1;
+      }
+      std::cout.flush();
+      _exit(status);
+    }
+
+    children.push_back(pid);
+  }
+
+  /* The parent keeps no end of the mesh, so a failed island closes its
+   * sockets and the others fail instead of waiting forever */
+  for (unsigned a = 0; a < mesh.size(); a++) {
+    for (unsigned b = 0; b < mesh[a].size(); b++) {
+      if (mesh[a][b] >= 0) {
+        close(mesh[a][b]);
+      }
+    }
+  }
+
+  int result = 0;
+  for (unsigned n = 0; n < children.size(); n++) {
+    int status;
+    if (waitpid(children[n], &status, 0) < 0 || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      result = 1;
+    }
+  }
+  return result;
+}
+
+static int cluster(const Settings &settings, const Parameters &params) {
+  if (settings.transport == "local") {
+    return runLocal(settings, params);
+  }
+
+  std::unique_ptr<SocketTransport> transport;
+  if (settings.transport == "unix") {
+    transport = SocketTransport::connectUnix(settings.address, settings.rank,
+                settings.numIslands);
+  }
+
+  else if (settings.transport == "tcp") {
+    std::vector<std::string> addresses;
+    boost::split(addresses, settings.address, boost::is_any_of(","));
+    transport = SocketTransport::connectTcp(addresses, settings.rank);
+  }
+
+  else {
+    throw std::invalid_argument("unknown transport " + settings.transport);
+  }
+
+  runRank(settings, params, *transport);
+  return 0;
+}
+
+int main(int argc, const char *argv[]) {
+  Parameters params;
+  Settings settings;
+  std::string config;
+
+  po::options_description general("General");
+  general.add_options()
+  ("help,h", "print this message")
+  ("config,c", po::value(&config),
+   "read options from this file (`name = value` lines).  The command line "
+   "takes precedence.");
+
+  po::options_description fileOptions;
+  fileOptions.add(clusterOptions(settings)).add(modelOptions(params));
+
+  po::options_description allOptions("Usage: island [options]");
+  allOptions.add(general).add(fileOptions);
+
+  try {
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, allOptions), vm);
+
+    if (vm.count("help")) {
+      std::cout << allOptions << std::endl;
+      return 0;
+    }
+
+    if (vm.count("config")) {
+      std::ifstream ifs(vm["config"].as<std::string>());
+      if (!ifs) {
+        throw std::runtime_error("cannot open " +
+                                 vm["config"].as<std::string>());
+      }
+      po::store(po::parse_config_file(ifs, fileOptions), vm);
+    }
+    po::notify(vm);
+
+    checkParameters(params);
+    parseTopology(settings.topology);
+    if (settings.numThreads == 0 || settings.numIslands == 0 ||
+        settings.interval == 0) {
+      throw std::invalid_argument("threads, islands and migrationInterval "
+                                  "must be positive");
+    }
+
+    if ((settings.latticeWidth > 0) != (settings.latticeHeight > 0)) {
+      throw std::invalid_argument("a lattice needs both a width and a "
+                                  "height");
+    }
+
+    if (settings.latticeWidth > 0 && !settings.checkpoint.empty()) {
+      throw std::invalid_argument("lattices cannot be checkpointed");
+    }
+
+    if (settings.transport != "local" && settings.address.empty()) {
+      throw std::invalid_argument("unix and tcp transports need an address");
+    }
+
+    return cluster(settings, params);
+  }
+
+  catch (const std::exception &e) {
+    std::cerr << "island: " << e.what() << std::endl;
+    return 1;
+  }
+}
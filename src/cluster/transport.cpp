@@ -0,0 +1,457 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "transport.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Helper functions                                                           *
+ * -------------------------------------------------------------------------- */
+
+static std::runtime_error systemError(const std::string &what) {
+  return std::runtime_error(what + ": " + strerror(errno));
+}
+
+static void setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    throw systemError("cannot configure socket");
+  }
+}
+
+/* Blocking helpers, only used while the cluster is being connected */
+static void writeAll(int fd, const void *data, size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw systemError("cannot send handshake");
+    }
+    bytes += n;
+    size -= n;
+  }
+}
+
+static void readAll(int fd, void *data, size_t size) {
+  char *bytes = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t n = recv(fd, bytes, size, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      throw std::runtime_error("cannot receive handshake");
+    }
+    bytes += n;
+    size -= n;
+  }
+}
+
+/**
+ * @brief Connects a full mesh.  Every island listens on `listener`, connects
+ *  to the islands below it with `connectTo` (which retries until they
+ *  listen) and accepts the islands above it.  Each connection starts with
+ *  the rank of the island that connected.
+ */
+template <typename Connect>
+static std::unique_ptr<SocketTransport> connectMesh(int listener,
+    unsigned rank, unsigned size, Connect connectTo) {
+  std::vector<int> sockets(size, -1);
+
+  try {
+    for (unsigned peer = 0; peer < rank; peer++) {
+      sockets[peer] = connectTo(peer);
+      uint32_t handshake = rank;
+      writeAll(sockets[peer], &handshake, sizeof(handshake));
+    }
+
+    for (unsigned n = rank + 1; n < size; n++) {
+      int fd = accept(listener, NULL, NULL);
+      if (fd < 0) {
+        throw systemError("cannot accept island");
+      }
+
+      uint32_t peer;
+      readAll(fd, &peer, sizeof(peer));
+      if (peer <= rank || peer >= size || sockets[peer] >= 0) {
+        close(fd);
+        throw std::runtime_error("unexpected island " +
+                                 std::to_string(peer));
+      }
+      sockets[peer] = fd;
+    }
+  }
+
+  catch (...) {
+    for (unsigned peer = 0; peer < size; peer++) {
+      if (sockets[peer] >= 0) {
+        close(sockets[peer]);
+      }
+    }
+    close(listener);
+    throw;
+  }
+
+  close(listener);
+  return std::unique_ptr<SocketTransport>(new SocketTransport(rank, sockets));
+}
+
+/* Calls `attempt` until it returns a socket or `timeout` seconds pass */
+template <typename Attempt>
+static int retry(const std::string &address, unsigned timeout,
+                 Attempt attempt) {
+  std::chrono::steady_clock::time_point deadline =
+    std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+
+  while (true) {
+    int fd = attempt();
+    if (fd >= 0) {
+      return fd;
+    }
+
+    if (std::chrono::steady_clock::now() > deadline) {
+      throw systemError("cannot connect to " + address);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+}
+
+static sockaddr_un unixAddress(const std::string &directory, unsigned rank) {
+  std::string path = directory + "/island-" + std::to_string(rank) + ".sock";
+
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::invalid_argument("socket path too long: " + path);
+  }
+  strcpy(address.sun_path, path.c_str());
+  return address;
+}
+
+/* Splits `host:port` */
+static void splitAddress(const std::string &address, std::string &host,
+                         std::string &port) {
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos) {
+    throw std::invalid_argument("expected host:port, got " + address);
+  }
+  host = address.substr(0, colon);
+  port = address.substr(colon + 1);
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * SocketTransport class                                                      *
+ * -------------------------------------------------------------------------- */
+
+SocketTransport::SocketTransport(unsigned rank,
+                                 const std::vector<int> &sockets) :
+  m_rank(rank), m_sockets(sockets) {
+  if (rank >= sockets.size()) {
+    throw std::invalid_argument("rank out of range");
+  }
+
+  /* Migrants are sent in bursts, so TCP should not wait to fill segments.
+   * This fails harmlessly on other sockets */
+  int noDelay = 1;
+  for (unsigned peer = 0; peer < m_sockets.size(); peer++) {
+    if (peer != rank) {
+      setNonBlocking(m_sockets[peer]);
+      setsockopt(m_sockets[peer], IPPROTO_TCP, TCP_NODELAY, &noDelay,
+                 sizeof(noDelay));
+    }
+  }
+}
+
+SocketTransport::~SocketTransport() {
+  for (unsigned peer = 0; peer < m_sockets.size(); peer++) {
+    if (m_sockets[peer] >= 0) {
+      close(m_sockets[peer]);
+    }
+  }
+}
+
+unsigned SocketTransport::rank(void) const {
+  return m_rank;
+}
+
+unsigned SocketTransport::size(void) const {
+  return m_sockets.size();
+}
+
+void SocketTransport::exchange(const std::vector<Message> &outgoing,
+                               std::vector<Message> &incoming) {
+
+  /* Progress of the transfer with each peer.  Every message is preceded by
+   * its length as a 64-bit integer */
+  typedef struct {
+    const Message *send;
+    uint64_t sendHeader;
+    uint64_t sent;        //! Bytes sent, header included
+    Message *receive;
+    uint64_t receiveHeader;
+    uint64_t received;    //! Bytes received, header included
+  } Transfer;
+
+  const uint64_t headerSize = sizeof(uint64_t);
+  const Transfer idle = {NULL, 0, 0, NULL, 0, 0};
+  std::vector<Transfer> transfers(size(), idle);
+
+  for (unsigned n = 0; n < outgoing.size(); n++) {
+    unsigned peer = outgoing[n].peer;
+    if (peer >= size() || peer == m_rank || transfers[peer].send) {
+      throw std::invalid_argument("bad outgoing peer");
+    }
+    transfers[peer].send = &outgoing[n];
+    transfers[peer].sendHeader = outgoing[n].data.size();
+  }
+
+  for (unsigned n = 0; n < incoming.size(); n++) {
+    unsigned peer = incoming[n].peer;
+    if (peer >= size() || peer == m_rank || transfers[peer].receive) {
+      throw std::invalid_argument("bad incoming peer");
+    }
+    transfers[peer].receive = &incoming[n];
+    incoming[n].data.clear();
+  }
+
+  std::vector<pollfd> fds;
+  std::vector<unsigned> peers;
+  while (true) {
+    fds.clear();
+    peers.clear();
+    for (unsigned peer = 0; peer < size(); peer++) {
+      Transfer &t = transfers[peer];
+      short events = 0;
+      if (t.send && t.sent < headerSize + t.sendHeader) {
+        events |= POLLOUT;
+      }
+      if (t.receive && (t.received < headerSize ||
+                        t.received < headerSize + t.receiveHeader)) {
+        events |= POLLIN;
+      }
+      if (events) {
+        pollfd fd = {m_sockets[peer], events, 0};
+        fds.push_back(fd);
+        peers.push_back(peer);
+      }
+    }
+
+    if (fds.empty()) {
+      break;
+    }
+
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw systemError("cannot poll islands");
+    }
+
+    for (unsigned n = 0; n < fds.size(); n++) {
+      Transfer &t = transfers[peers[n]];
+      int fd = fds[n].fd;
+      std::string peer = "island " + std::to_string(peers[n]);
+
+      if ((fds[n].revents & (POLLOUT | POLLERR | POLLHUP)) &&
+          (fds[n].events & POLLOUT)) {
+        const char *data;
+        size_t count;
+        if (t.sent < headerSize) {
+          data = reinterpret_cast<const char *>(&t.sendHeader) + t.sent;
+          count = headerSize - t.sent;
+        } else {
+          data = t.send->data.data() + (t.sent - headerSize);
+          count = t.sendHeader - (t.sent - headerSize);
+        }
+
+        ssize_t sent = send(fd, data, count, MSG_NOSIGNAL);
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+            errno != EINTR) {
+          throw systemError("cannot send to " + peer);
+        }
+        if (sent > 0) {
+          t.sent += sent;
+        }
+      }
+
+      if ((fds[n].revents & (POLLIN | POLLERR | POLLHUP)) &&
+          (fds[n].events & POLLIN)) {
+        char *data;
+        size_t count;
+        if (t.received < headerSize) {
+          data = reinterpret_cast<char *>(&t.receiveHeader) + t.received;
+          count = headerSize - t.received;
+        } else {
+          data = &t.receive->data[t.received - headerSize];
+          count = t.receiveHeader - (t.received - headerSize);
+        }
+
+        ssize_t received = recv(fd, data, count, 0);
+        if (received == 0) {
+          throw std::runtime_error(peer + " closed the connection");
+        }
+        if (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+            errno != EINTR) {
+          throw systemError("cannot receive from " + peer);
+        }
+        if (received > 0) {
+          t.received += received;
+          if (t.received == headerSize) {
+            t.receive->data.resize(t.receiveHeader);
+          }
+        }
+      }
+    }
+  }
+}
+
+std::unique_ptr<SocketTransport> SocketTransport::connectUnix(
+  const std::string &directory, unsigned rank, unsigned size,
+  unsigned timeout) {
+  if (rank >= size) {
+    throw std::invalid_argument("rank out of range");
+  }
+
+  sockaddr_un address = unixAddress(directory, rank);
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(address.sun_path);
+  if (listener < 0 ||
+      bind(listener, (sockaddr *) &address, sizeof(address)) < 0 ||
+      listen(listener, size) < 0) {
+    if (listener >= 0) {
+      close(listener);
+    }
+    throw systemError(std::string("cannot listen on ") + address.sun_path);
+  }
+
+  std::unique_ptr<SocketTransport> transport = connectMesh(listener, rank,
+  size, [&](unsigned peer) {
+    sockaddr_un peerAddress = unixAddress(directory, peer);
+    return retry(peerAddress.sun_path, timeout, [&]() {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd >= 0 && connect(fd, (sockaddr *) &peerAddress,
+                             sizeof(peerAddress)) < 0) {
+        close(fd);
+        fd = -1;
+      }
+      return fd;
+    });
+  });
+
+  /* Every connection is made, so the name is no longer needed */
+  unlink(address.sun_path);
+  return transport;
+}
+
+std::unique_ptr<SocketTransport> SocketTransport::connectTcp(
+  const std::vector<std::string> &addresses, unsigned rank,
+  unsigned timeout) {
+  unsigned size = addresses.size();
+  if (rank >= size) {
+    throw std::invalid_argument("rank out of range");
+  }
+
+  std::string host;
+  std::string port;
+  splitAddress(addresses[rank], host, port);
+
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(std::stoi(port));
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  if (listener < 0 ||
+      setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                 sizeof(reuse)) < 0 ||
+      bind(listener, (sockaddr *) &address, sizeof(address)) < 0 ||
+      listen(listener, size) < 0) {
+    if (listener >= 0) {
+      close(listener);
+    }
+    throw systemError("cannot listen on port " + port);
+  }
+
+  return connectMesh(listener, rank, size, [&](unsigned peer) {
+    std::string peerHost;
+    std::string peerPort;
+    splitAddress(addresses[peer], peerHost, peerPort);
+
+    return retry(addresses[peer], timeout, [&]() {
+      addrinfo hints;
+      memset(&hints, 0, sizeof(hints));
+      hints.ai_family = AF_INET;
+      hints.ai_socktype = SOCK_STREAM;
+
+      addrinfo *info;
+      if (getaddrinfo(peerHost.c_str(), peerPort.c_str(), &hints,
+                      &info) != 0) {
+        return -1;
+      }
+
+      int fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+      if (fd >= 0 && connect(fd, info->ai_addr, info->ai_addrlen) < 0) {
+        close(fd);
+        fd = -1;
+      }
+      freeaddrinfo(info);
+      return fd;
+    });
+  });
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Local mesh                                                                 *
+ * -------------------------------------------------------------------------- */
+
+std::vector<std::vector<int>> socketMesh(unsigned size) {
+  std::vector<std::vector<int>> mesh(size, std::vector<int>(size, -1));
+
+  for (unsigned a = 0; a < size; a++) {
+    for (unsigned b = a + 1; b < size; b++) {
+      int pair[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) {
+        throw systemError("cannot create socket pair");
+      }
+      mesh[a][b] = pair[0];
+      mesh[b][a] = pair[1];
+    }
+  }
+
+  return mesh;
+}
+
+std::unique_ptr<SocketTransport> meshTransport(
+  std::vector<std::vector<int>> &mesh, unsigned rank) {
+  for (unsigned a = 0; a < mesh.size(); a++) {
+    for (unsigned b = 0; b < mesh[a].size(); b++) {
+      if (a != rank && mesh[a][b] >= 0) {
+        close(mesh[a][b]);
+        mesh[a][b] = -1;
+      }
+    }
+  }
+
+  std::unique_ptr<SocketTransport> transport(
+    new SocketTransport(rank, mesh[rank]));
+  mesh[rank].assign(mesh.size(), -1);
+  return transport;
+}
@@ -0,0 +1,117 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/* -------------------------------------------------------------------------- *
+ * Transports                                                                 *
+ * -------------------------------------------------------------------------- */
+
+/* A message to or from another island */
+typedef struct {
+  unsigned peer;        //! Rank of the other island
+  std::string data;
+} Message;
+
+/**
+ * @brief Connects the `size()` islands of a cluster, which are numbered
+ *  `0, ..., size() - 1`.  Islands only talk to each other through
+ *  `exchange`, so a transport can sit on anything that moves bytes between
+ *  processes.
+ */
+class Transport {
+ public:
+  virtual ~Transport() { }
+
+  /* Number of this island, and of islands in the cluster */
+  virtual unsigned rank(void) const = 0;
+  virtual unsigned size(void) const = 0;
+
+  /**
+   * @brief Sends every outgoing message and receives one message from the
+   *  peer of every incoming one, all at the same time, so two islands can
+   *  send each other large messages without deadlocking.  The peers must
+   *  call `exchange` with the matching messages.
+   *
+   * @param outgoing at most one message per peer
+   * @param incoming at most one message per peer.  Only the peers are read;
+   *  the data is filled in.
+   *
+   * @note This function throws an exception when a peer cannot be reached.
+   */
+  virtual void exchange(const std::vector<Message> &outgoing,
+                        std::vector<Message> &incoming) = 0;
+};
+
+/**
+ * @brief Transport over one stream socket per pair of islands.  Messages are
+ *  framed by their length.  The sockets can be Unix domain sockets, TCP
+ *  connections, or socket pairs shared by forked processes on one machine.
+ */
+class SocketTransport : public Transport {
+ private:
+  unsigned m_rank;
+  std::vector<int> m_sockets;   //! Socket of each peer, -1 for this island
+
+ public:
+
+  /**
+   * @brief Takes over connected sockets
+   *
+   * @param rank
+   * @param sockets socket connected to each island, -1 for `rank`
+   */
+  SocketTransport(unsigned rank, const std::vector<int> &sockets);
+  ~SocketTransport();
+
+  SocketTransport(const SocketTransport &) = delete;
+  SocketTransport &operator= (const SocketTransport &) = delete;
+
+  unsigned rank(void) const;
+  unsigned size(void) const;
+  void exchange(const std::vector<Message> &outgoing,
+                std::vector<Message> &incoming);
+
+  /**
+   * @brief Connects the islands through Unix domain sockets named
+   *  `<directory>/island-<rank>.sock`.  Every island must call this with the
+   *  same directory and size, and waits up to `timeout` seconds for the
+   *  others.
+   *
+   * @note This function throws an exception when the islands cannot connect.
+   */
+  static std::unique_ptr<SocketTransport> connectUnix(
+    const std::string &directory, unsigned rank, unsigned size,
+    unsigned timeout = 30);
+
+  /**
+   * @brief Connects the islands over TCP.  Island `k` listens on the port of
+   *  `addresses[k]`, a `host:port` string.
+   *
+   * @note This function throws an exception when the islands cannot connect.
+   */
+  static std::unique_ptr<SocketTransport> connectTcp(
+    const std::vector<std::string> &addresses, unsigned rank,
+    unsigned timeout = 30);
+};
+
+/**
+ * @brief Creates a socket pair for every pair of `size` islands, to be
+ *  shared by processes forked from this one (or threads of this process).
+ *  `mesh[a][b]` is the end island `a` uses to talk to island `b`.
+ */
+std::vector<std::vector<int>> socketMesh(unsigned size);
+
+/**
+ * @brief Builds the transport of island `rank` from a mesh, and closes the
+ *  ends of the mesh that belong to the other islands.  A forked process
+ *  calls this once, for its own rank.
+ */
+std::unique_ptr<SocketTransport> meshTransport(
+  std::vector<std::vector<int>> &mesh, unsigned rank);
+
+
+#endif /* end of include guard: TRANSPORT_H */
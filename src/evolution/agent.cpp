@@ -1,10 +1,14 @@
 #include <cmath>
 #include <cassert>
-#include <time.h>
+#include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <stdexcept>
 #include <gsl/gsl_rng.h>
 #include <gsl/gsl_randist.h>
 #include "agent.h"
+#include "kernels.h"
+#include "population.h"
 
 
 /* -------------------------------------------------------------------------- *
@@ -14,19 +18,25 @@
 Agent::Agent(unsigned size, char c, double energy) {
   m_chromosome = Buffer(size, c);
   m_energy = energy;
+  m_numOnes = size * __builtin_popcount((unsigned char) c);
+  m_numOnesValid = true;
 }
 
 Agent::Agent(const Buffer &chromosome, double energy) {
   m_chromosome = chromosome;
   m_energy = energy;
+  m_numOnesValid = false;
 }
 
 Agent::Agent(const Agent &agent) {
   m_chromosome = agent.m_chromosome;
   m_energy = agent.m_energy;
+  m_numOnes = agent.m_numOnes;
+  m_numOnesValid = agent.m_numOnesValid;
 }
 
 Buffer &Agent::getChromosome(void) {
+  m_numOnesValid = false;
   return m_chromosome;
 }
 
@@ -42,7 +52,25 @@ void Agent::setEnergy(double energy) {
   m_energy = energy;
 }
 
+unsigned Agent::getNumOnes(void) const {
+  if (!m_numOnesValid) {
+    m_numOnes = hammingWeight(m_chromosome);
+    m_numOnesValid = true;
+  }
+  return m_numOnes;
+}
+
+void Agent::setNumOnes(unsigned numOnes) {
+  m_numOnes = numOnes;
+  m_numOnesValid = true;
+}
+
+double Agent::getEntropy(void) const {
+  return shannonEntropy(getNumOnes(), 8 * m_chromosome.size());
+}
+
 char &Agent::operator[](unsigned index) {
+  m_numOnesValid = false;
   return m_chromosome[index];
 }
 
@@ -50,100 +78,327 @@ const char &Agent::operator[](unsigned index) const {
   return m_chromosome[index];
 }
 
-unsigned mutate(Agent &agent, const Parameters &params) {
-  const gsl_rng_type *T = gsl_rng_default;
-  gsl_rng *rng = gsl_rng_alloc(T);
-  gsl_rng_set(rng, time(NULL));
+/* Change in the Hamming weight of `word` when `mask` is XOR-ed into it */
+static inline int flipDelta(Buffer::Word word, Buffer::Word mask) {
+  return __builtin_popcountll(mask) - 2 * __builtin_popcountll(word & mask);
+}
 
-  Buffer &chromosome = agent.getChromosome();
-  unsigned size = chromosome.size();
+/**
+ * @brief Flips Poisson(`muNumMutations`) uniformly chosen bits of a
+ *  `size`-byte chromosome, one random draw per flip.  Each flip adds +1 or
+ *  -1 to `deltaOnes`.
+ *
+ * @return number of flips
+ */
+static unsigned mutatePoisson(Buffer::Word *chromosome, unsigned size,
+                              const Parameters &params, Random &random,
+                              int &deltaOnes) {
+  gsl_rng *rng = random.get();
   unsigned numMutations = gsl_ran_poisson(rng, params.muNumMutations);
 
   for (unsigned k = 0; k < numMutations; k++) {
-    unsigned index = gsl_rng_uniform_int(rng, size);
-    chromosome.flipBit(index);
+    unsigned index = gsl_rng_uniform_int(rng, 8 * size);
+    Buffer::Word &word = chromosome[index / Buffer::wordBits];
+    Buffer::Word bit = Buffer::Word(1) << (index % Buffer::wordBits);
+
+    deltaOnes += (word & bit) ? -1 : 1;
+    word ^= bit;
   }
 
-  gsl_rng_free(rng);
   return numMutations;
 }
 
 /**
- * @brief Helper class to switch (toggle) between parent chromosomes
+ * @brief Flips every bit independently with probability `p`, jumping from
+ *  one flip to the next with geometrically distributed gaps.  The flips
+ *  that land in the same word are collected in a mask and applied with a
+ *  single XOR.
+ *
+ * @return number of flips
  */
-class CrossoverMediator {
- private:
-  std::vector<const Buffer *> m_buffers;
-  unsigned m_active;
-
- public:
-  CrossoverMediator(const Buffer &a, const Buffer &b, unsigned active);
-  const Buffer &cross(void);
-};
+static unsigned mutateGeometric(Buffer::Word *chromosome, unsigned size,
+                                double p, Random &random, int &deltaOnes) {
+  gsl_rng *rng = random.get();
+  const uint64_t numBits = 8 * (uint64_t) size;
+  const double scale = 1.0 / log1p(-p);
+
+  unsigned numMutations = 0;
+  unsigned word = 0;
+  Buffer::Word mask = 0;
+
+  /* The number of untouched bits before the next flip is
+   * floor(log(U) / log(1 - p)) */
+  double gap = log(gsl_rng_uniform_pos(rng)) * scale;
+  uint64_t index = 0;
+  while (gap < numBits - index) {
+    index += gap;
+    if (index / Buffer::wordBits != word) {
+      deltaOnes += flipDelta(chromosome[word], mask);
+      chromosome[word] ^= mask;
+      word = index / Buffer::wordBits;
+      mask = 0;
+    }
+
+    mask |= Buffer::Word(1) << (index % Buffer::wordBits);
+    numMutations += 1;
+    index += 1;
+    gap = log(gsl_rng_uniform_pos(rng)) * scale;
+  }
 
-CrossoverMediator::CrossoverMediator(const Buffer &a, const Buffer &b,
-                                     unsigned active) {
-  m_buffers.push_back(&a);
-  m_buffers.push_back(&b);
-  m_active = active;
+  deltaOnes += flipDelta(chromosome[word], mask);
+  chromosome[word] ^= mask;
+  return numMutations;
 }
 
-const Buffer &CrossoverMediator::cross(void) {
-  const Buffer *active = NULL;
-  m_active = (m_active + 1) % 2;
-  active = m_buffers[m_active];
-  return *active;
+/* Bits of precision of the probability used by `mutateMask` */
+static const unsigned maskPrecision = 16;
+
+/**
+ * @brief Flips every bit independently with probability `p`, building a
+ *  random Bernoulli(`p`) mask a whole word at a time.  `p` is rounded to
+ *  `q / 2^16`.  Going through the bits of `q` from least to most
+ *  significant, the mask is OR-ed with a fresh random word for every one
+ *  and AND-ed for every zero, which leaves each bit set with probability
+ *  exactly `q / 2^16`.
+ *
+ * @return number of flips
+ */
+static unsigned mutateMask(Buffer::Word *chromosome, unsigned size,
+                           double p, Random &random, int &deltaOnes) {
+  const unsigned q = std::min<double>(p * (1u << maskPrecision) + 0.5,
+                                      (1u << maskPrecision) - 1);
+  if (q == 0) {
+    return 0;
+  }
+
+  const unsigned lowest = __builtin_ctz(q);
+  const unsigned numWords = (size + Buffer::wordBytes - 1) /
+                            Buffer::wordBytes;
+  const unsigned used = size % Buffer::wordBytes;
+
+  unsigned numMutations = 0;
+  for (unsigned k = 0; k < numWords; k++) {
+    Buffer::Word mask = random();
+    for (unsigned j = lowest + 1; j < maskPrecision; j++) {
+      if ((q >> j) & 1) {
+        mask |= random();
+      } else {
+        mask &= random();
+      }
+    }
+
+    /* Leave the padding alone */
+    if (k == numWords - 1 && used != 0) {
+      mask &= (Buffer::Word(1) << (8 * used)) - 1;
+    }
+
+    deltaOnes += flipDelta(chromosome[k], mask);
+    chromosome[k] ^= mask;
+    numMutations += __builtin_popcountll(mask);
+  }
+
+  return numMutations;
 }
 
-Agent crossover(const Agent &father, const Agent &mother,
-                const Parameters &params) {
-  const gsl_rng_type *T = gsl_rng_default;
-  gsl_rng *rng = gsl_rng_alloc(T);
-  gsl_rng_set(rng, time(NULL));
+/* Engine used by `mutate`.  Atomic, since the threads of a running
+ * generation read it on every call and it can be set at any time */
+static std::atomic<MutationEngine> mutationEngine(MUTATION_AUTO);
 
-  /* Get parent chromosomes */
-  const Buffer &a = father.getChromosomeConst();
-  const Buffer &b = mother.getChromosomeConst();
-  unsigned size = a.size();
+void setMutationEngine(MutationEngine engine) {
+  mutationEngine.store(engine);
+}
 
-  /* Get sorted list of cross indices */
-  unsigned numCross = gsl_ran_poisson(rng, params.muNumCrossovers);
-  std::vector<unsigned> indices;
-  unsigned index, nextIndex;
-  unsigned j, k;
+MutationEngine getMutationEngine(void) {
+  return mutationEngine.load();
+}
 
-  for (k = 0; k < numCross; k++) {
-    index = gsl_rng_uniform_int(rng, size);
-    indices.push_back(index);
+MutationEngine selectMutationEngine(double muNumMutations,
+                                    unsigned sizeChromosome) {
+  double p = muNumMutations / (8.0 * sizeChromosome);
+
+  if (muNumMutations < 8) {
+    return MUTATION_POISSON;
   }
-  std::sort(indices.begin(), indices.end());
 
-  /* Apply crosses */
-  CrossoverMediator mediator(a, b, gsl_rng_uniform_int(rng, 2));
-  const Buffer &active = mediator.cross();
-  Buffer chromosomeChild(active);
+  else if (p < 1.0 / 16) {
+    return MUTATION_GEOMETRIC;
+  }
 
-  for (k = 0; k < numCross; k++) {
-    index = indices[k];
-    if (k == numCross - 1) {
-      nextIndex = chromosomeChild.size();
-    }
+  else {
+    return MUTATION_MASK;
+  }
+}
 
-    else {
-      nextIndex = indices[k + 1];
-    }
+/**
+ * @brief Mutates a `size`-byte chromosome with the selected engine and adds
+ *  the change in its Hamming weight to `deltaOnes`
+ *
+ * @return number of flips
+ */
+static unsigned mutateWords(Buffer::Word *chromosome, unsigned size,
+                            const Parameters &params, Random &random,
+                            int &deltaOnes) {
+  MutationEngine engine = mutationEngine.load(std::memory_order_relaxed);
+  if (engine == MUTATION_AUTO) {
+    engine = selectMutationEngine(params.muNumMutations, size);
+  }
 
-    const Buffer &active = mediator.cross();
-    for (j = index; j < nextIndex; j++) {
-      chromosomeChild[j] = active[j];
-    }
+  /* Per-bit flip probability of the Bernoulli engines */
+  double p = std::min(params.muNumMutations / (8.0 * size), 0.5);
+  if (engine != MUTATION_POISSON && p <= 0) {
+    return 0;
+  }
+
+  switch (engine) {
+  case MUTATION_GEOMETRIC:
+    return mutateGeometric(chromosome, size, p, random, deltaOnes);
+  case MUTATION_MASK:
+    return mutateMask(chromosome, size, p, random, deltaOnes);
+  default:
+    return mutatePoisson(chromosome, size, params, random, deltaOnes);
+  }
+}
+
+unsigned mutate(Agent &agent, const Parameters &params, Random &random) {
+  int numOnes = agent.getNumOnes();
+  Buffer &chromosome = agent.getChromosome();
+  unsigned numMutations = mutateWords(chromosome.words(), chromosome.size(),
+                                      params, random, numOnes);
+  agent.setNumOnes(numOnes);
+  return numMutations;
+}
+
+unsigned mutate(Population &population, unsigned slot,
+                const Parameters &params, Random &random) {
+  int numOnes = population.getNumOnes(slot);
+  unsigned numMutations = mutateWords(population.chromosome(slot),
+                                      population.sizeChromosome(), params,
+                                      random, numOnes);
+  population.setNumOnes(slot, numOnes);
+  return numMutations;
+}
+
+/* Mask of the bytes `[from, to)` of a word, with `0 <= from < to <= 8` */
+static inline Buffer::Word byteMask(unsigned from, unsigned to) {
+  Buffer::Word high = (to == Buffer::wordBytes) ? ~Buffer::Word(0) :
+                      (Buffer::Word(1) << (8 * to)) - 1;
+  Buffer::Word low = (Buffer::Word(1) << (8 * from)) - 1;
+  return high & ~low;
+}
+
+/* Blends the bytes of `source` selected by `mask` into `dest`, and returns
+ * how many ones they hold */
+static inline unsigned blendWord(Buffer::Word &dest, Buffer::Word source,
+                                 Buffer::Word mask) {
+  dest = (dest & ~mask) | (source & mask);
+  return __builtin_popcountll(source & mask);
+}
+
+/**
+ * @brief Copies the bytes `[from, to)` of `source` into `dest`.  Whole words
+ *  are copied with `memcpy`; the partial words at either end are blended in
+ *  with a byte mask.
+ *
+ * @return Hamming weight of the copied segment
+ */
+static unsigned copySegment(Buffer::Word *dest, const Buffer::Word *source,
+                            unsigned from, unsigned to) {
+  if (from >= to) {
+    return 0;
+  }
+
+  unsigned first = from / Buffer::wordBytes;
+  unsigned last = to / Buffer::wordBytes;
+  unsigned head = from % Buffer::wordBytes;
+  unsigned tail = to % Buffer::wordBytes;
+
+  /* Segment within a single word */
+  if (first == last) {
+    return blendWord(dest[first], source[first], byteMask(head, tail));
+  }
+
+  unsigned numOnes = 0;
+  if (head != 0) {
+    numOnes += blendWord(dest[first], source[first],
+                         byteMask(head, Buffer::wordBytes));
+    first += 1;
+  }
+
+  memcpy(dest + first, source + first,
+         (last - first) * Buffer::wordBytes);
+  numOnes += popcountWords(source + first, last - first);
+
+  if (tail != 0) {
+    numOnes += blendWord(dest[last], source[last], byteMask(0, tail));
+  }
+
+  return numOnes;
+}
+
+/**
+ * @brief Writes the crossover of the chromosomes `a` and `b` (`numWords`
+ *  words each, of which the first `size` bytes are used) into `child`.
+ *
+ *  The sorted cross indices are drawn one after the other as uniform order
+ *  statistics (the next of the `m` remaining points lies at
+ *  `x + (1 - x) (1 - U^(1/m))`), so they need neither storage nor sorting.
+ *  Nothing is allocated.
+ *
+ * @return Hamming weight of the child
+ */
+static unsigned crossoverWords(const Buffer::Word *a, const Buffer::Word *b,
+                           Buffer::Word *child, unsigned size,
+                           unsigned numWords, const Parameters &params,
+                           Random &random) {
+  gsl_rng *rng = random.get();
+  unsigned numCross = gsl_ran_poisson(rng, params.muNumCrossovers);
+
+  /* Toggle between the parents at every cross index */
+  const Buffer::Word *parents[2] = {a, b};
+  unsigned active = gsl_rng_uniform_int(rng, 2);
+
+  double x = 0;
+  unsigned from = 0;
+  unsigned numOnes = 0;
+  for (unsigned k = 0; k < numCross; k++) {
+    x += (1 - x) * (1 - pow(gsl_rng_uniform_pos(rng), 1.0 / (numCross - k)));
+    unsigned index = std::min<unsigned>(x * size, size - 1);
+
+    numOnes += copySegment(child, parents[active], from, index);
+    active = (active + 1) % 2;
+    from = index;
   }
 
-  gsl_rng_free(rng);
-  Agent child(chromosomeChild, params.lambdaEnergy);
+  /* Last segment, including the (zero) padding */
+  numOnes += copySegment(child, parents[active], from,
+                         numWords * Buffer::wordBytes);
+  return numOnes;
+}
+
+Agent crossover(const Agent &father, const Agent &mother,
+                const Parameters &params, Random &random) {
+  const Buffer &a = father.getChromosomeConst();
+  const Buffer &b = mother.getChromosomeConst();
+
+  Agent child(a.size(), 0x00, params.lambdaEnergy);
+  unsigned numOnes = crossoverWords(a.words(), b.words(),
+                                    child.getChromosome().words(), a.size(),
+                                    a.numWords(), params, random);
+  child.setNumOnes(numOnes);
   return child;
 }
 
+void crossover(Population &population, unsigned father, unsigned mother,
+               unsigned child, const Parameters &params, Random &random) {
+  unsigned numOnes = crossoverWords(population.chromosome(father),
+                                    population.chromosome(mother),
+                                    population.chromosome(child),
+                                    population.sizeChromosome(),
+                                    population.stride(), params, random);
+  population.setNumOnes(child, numOnes);
+  population.setEnergy(child, params.lambdaEnergy);
+}
+
 /* Rock paper sissors game ... */
 static const int selectionScores[4][4] = {
   { 0, 1, 0, -1},
@@ -153,9 +408,9 @@ static const int selectionScores[4][4] = {
 };
 
 /* Used to look up indices in the selection score table */
-u_int8_t getTwoBits(const Buffer &buffer, unsigned index) {
+static u_int8_t getTwoBits(const Buffer &buffer, unsigned index) {
   unsigned offset =  index / 4;
-  unsigned k = index % 4;
+  unsigned k = 2 * (index % 4);
 
   /* Get the bits */
   char b = buffer[offset];
@@ -163,12 +418,7 @@ u_int8_t getTwoBits(const Buffer &buffer, unsigned index) {
   return bits;
 }
 
-PredationOutcome predation(const Agent &first, const Agent &second,
-                           const Parameters &params) {
-
-  const Buffer &a = first.getChromosomeConst();
-  const Buffer &b = second.getChromosomeConst();
-
+int predationScoreReference(const Buffer &a, const Buffer &b) {
   /* Read buffers in two-bit chunks and compute score */
   int score = 0;
   for (unsigned k = 0; k < a.size() * 4; k++) {
@@ -176,17 +426,28 @@ PredationOutcome predation(const Agent &first, const Agent &second,
     u_int8_t bBits = getTwoBits(b, k);
     score += selectionScores[aBits][bBits];
   }
+  return score;
+}
 
-  /* Draw a random number */
-  const gsl_rng_type *T = gsl_rng_default;
-  gsl_rng *rng = gsl_rng_alloc(T);
-  gsl_rng_set(rng, time(NULL));
+int predationScore(const Buffer &a, const Buffer &b) {
+  if (a.size() != b.size()) {
+    throw std::invalid_argument("predation between unequally sized buffers");
+  }
 
-  double S = params.sigmaPredation * sqrt(a.size() * 4);
-  double L = params.lambdaPredation * sqrt(a.size() * 4);
-  double p = gsl_ran_gaussian(rng, S);
+  return predationScoreWords(a.words(), b.words(), a.numWords());
+}
 
-  gsl_rng_free(rng);
+/**
+ * @brief Draws the outcome of an encounter with score `score` between two
+ *  chromosomes of `size` bytes
+ */
+static PredationOutcome resolvePredation(int score, unsigned size,
+    const Parameters &params, Random &random) {
+
+  /* Draw a random number */
+  double S = params.sigmaPredation * sqrt(size * 4);
+  double L = params.lambdaPredation * sqrt(size * 4);
+  double p = gsl_ran_gaussian(random.get(), S);
 
   /* Assign outcome */
   if ((p < score) && (L < score)) {
@@ -202,44 +463,127 @@ PredationOutcome predation(const Agent &first, const Agent &second,
   }
 }
 
+PredationOutcome predation(const Agent &first, const Agent &second,
+                           const Parameters &params, Random &random) {
+  const Buffer &a = first.getChromosomeConst();
+  const Buffer &b = second.getChromosomeConst();
+  int score = predationScore(a, b);
+
+  return resolvePredation(score, a.size(), params, random);
+}
+
+PredationOutcome predation(const Population &population, unsigned first,
+                           unsigned second, const Parameters &params,
+                           Random &random) {
+  int score = predationScoreWords(population.chromosome(first),
+                                  population.chromosome(second),
+                                  population.stride());
+
+  return resolvePredation(score, population.sizeChromosome(), params,
+                          random);
+}
+
+void predation(const Population &population, const unsigned *pairs,
+               unsigned numPairs, const Parameters &params, Random &random,
+               PredationOutcome *outcomes) {
+  const double S = params.sigmaPredation * sqrt(population.sizeChromosome() *
+                   4);
+  const double L = params.lambdaPredation * sqrt(population.sizeChromosome() *
+                   4);
+  unsigned numWords = population.stride();
+
+  double score[pairBlock];
+  double p[pairBlock];
+
+  for (unsigned first = 0; first < numPairs; first += pairBlock) {
+    unsigned count = std::min(pairBlock, numPairs - first);
+    const unsigned *block = pairs + 2 * first;
+
+    for (unsigned k = 0; k < count; k++) {
+      score[k] = predationScoreWords(population.chromosome(block[2 * k]),
+                                     population.chromosome(block[2 * k + 1]),
+                                     numWords);
+    }
+
+    random.gaussians(S, p, count);
+
+    /* Same decision as `resolvePredation`, as selects */
+    for (unsigned k = 0; k < count; k++) {
+      bool firstWins = (p[k] < score[k]) & (L < score[k]);
+      bool secondWins = (p[k] < - score[k]) & (L < - score[k]);
+      outcomes[first + k] = (PredationOutcome)(firstWins ?
+                            PREDATION_FIRST_SURVIVES : secondWins ?
+                            PREDATION_SECOND_SURVIVES : PREDATION_BOTH_SURVIVE);
+    }
+  }
+}
+
+/* Energy gained from eating prey with entropy `entropy` */
+static double feedingEnergy(double entropy, const Parameters &params) {
+  return params.lambdaScoreFeed * entropy + 1.0;
+}
+
 void feed(Agent &predator, Agent &prey, const Parameters &params) {
-  const Buffer &c = prey.getChromosomeConst();
-  double entropy = shannonEntropy(c);
+  double entropy = prey.getEntropy();
   double energy = predator.getEnergy();
 
-  energy += params.lambdaScoreFeed * entropy + 1.0;
+  energy += feedingEnergy(entropy, params);
   predator.setEnergy(energy);
 }
 
-int starve(Agent &agent, const Parameters &params) {
-  /* Draw a random number */
-  const gsl_rng_type *T = gsl_rng_default;
-  gsl_rng *rng = gsl_rng_alloc(T);
-  gsl_rng_set(rng, time(NULL));
+void feed(Population &population, unsigned predator, unsigned prey,
+          const Parameters &params) {
+  double entropy = population.getEntropy(prey);
+  double energy = population.getEnergy(predator);
+
+  energy += feedingEnergy(entropy, params);
+  population.setEnergy(predator, energy);
+}
 
-  unsigned p = gsl_ran_poisson(rng, params.muEnergyStarve);
-  gsl_rng_free(rng);
+/**
+ * @brief Applies a starvation draw to `energy`
+ *
+ * @return outcome, as in `starve`
+ */
+static int starveEnergy(double &energy, const Parameters &params,
+                        Random &random) {
+  /* Draw a random number */
+  unsigned p = gsl_ran_poisson(random.get(), params.muEnergyStarve);
 
   /* Check outcome */
-  double e = agent.getEnergy();
-  if (p < e) {
-    agent.setEnergy(e - p);
+  if (p < energy) {
+    energy -= p;
     return 0;
   }
 
   else {
-    agent.setEnergy(0);
+    energy = 0;
     return 1;
   }
 }
 
-int mate(const Agent &a, const Agent &b, const Parameters &params) {
-  const Buffer &ca = a.getChromosomeConst();
-  const Buffer &cb = b.getChromosomeConst();
+int starve(Agent &agent, const Parameters &params, Random &random) {
+  double e = agent.getEnergy();
+  int outcome = starveEnergy(e, params, random);
+  agent.setEnergy(e);
+  return outcome;
+}
 
-  /* Hamming distance divided by chromosome size */
-  double d = distance(ca, cb);
-  d = d / ca.size();
+int starve(Population &population, unsigned slot, const Parameters &params,
+           Random &random) {
+  double e = population.getEnergy(slot);
+  int outcome = starveEnergy(e, params, random);
+  population.setEnergy(slot, e);
+  return outcome;
+}
+
+/**
+ * @brief Courtship between two agents whose chromosomes differ in `d` bits
+ *  per byte
+ *
+ * @return outcome, as in `mate`
+ */
+static int courtship(double d, const Parameters &params, Random &random) {
 
   /* Choose a random Beta-distributed number.  We are using a beta-distribution
    * where the mode is pinned to be exactly zero, e.g.
@@ -251,11 +595,7 @@ int mate(const Agent &a, const Agent &b, const Parameters &params) {
   double mu = params.muMating;
   double beta = (1.0 / mu) - 1.0;
 
-  const gsl_rng_type *T = gsl_rng_default;
-  gsl_rng *rng = gsl_rng_alloc(T);
-  gsl_rng_set(rng, time(NULL));
-  double p = gsl_ran_beta(rng, 1, beta);
-  gsl_rng_free(rng);
+  double p = gsl_ran_beta(random.get(), 1, beta);
 
   if (d < p) {
     return 1;
@@ -266,3 +606,56 @@ int mate(const Agent &a, const Agent &b, const Parameters &params) {
   }
 }
 
+int mate(const Agent &a, const Agent &b, const Parameters &params,
+         Random &random) {
+  const Buffer &ca = a.getChromosomeConst();
+  const Buffer &cb = b.getChromosomeConst();
+
+  /* Hamming distance divided by chromosome size */
+  double d = distance(ca, cb);
+  d = d / ca.size();
+
+  return courtship(d, params, random);
+}
+
+int mate(const Population &population, unsigned a, unsigned b,
+         const Parameters &params, Random &random) {
+
+  /* Hamming distance divided by chromosome size */
+  double d = popcountXorWords(population.chromosome(a),
+                              population.chromosome(b), population.stride());
+  d = d / population.sizeChromosome();
+
+  return courtship(d, params, random);
+}
+
+void mate(const Population &population, const unsigned *pairs,
+          unsigned numPairs, const Parameters &params, Random &random,
+          uint64_t *mask) {
+  const double beta = (1.0 / params.muMating) - 1.0;
+  const double exponent = 1.0 / beta;
+  const double size = population.sizeChromosome();
+  unsigned numWords = population.stride();
+
+  double d[pairBlock];
+  double u[pairBlock];
+  std::fill(mask, mask + (numPairs + 63) / 64, 0);
+
+  for (unsigned first = 0; first < numPairs; first += pairBlock) {
+    unsigned count = std::min(pairBlock, numPairs - first);
+    const unsigned *block = pairs + 2 * first;
+
+    for (unsigned k = 0; k < count; k++) {
+      d[k] = popcountXorWords(population.chromosome(block[2 * k]),
+                              population.chromosome(block[2 * k + 1]),
+                              numWords) / size;
+    }
+
+    random.uniforms(u, count);
+
+    for (unsigned k = 0; k < count; k++) {
+      double p = 1.0 - pow(u[k], exponent);
+      mask[(first + k) / 64] |= (uint64_t)(d[k] < p) << ((first + k) % 64);
+    }
+  }
+}
@@ -3,6 +3,7 @@
 
 #include "information.h"
 #include "parameters.h"
+#include "rng.h"
 
 
 /* -------------------------------------------------------------------------- *
@@ -18,6 +19,11 @@ class Agent {
   Buffer m_chromosome;  //! Chromosome
   double m_energy;      //! Energy of the agent
 
+  /* Cached Hamming weight of the chromosome.  It is invalidated whenever the
+   * chromosome is handed out for writing and recounted on demand */
+  mutable unsigned m_numOnes;
+  mutable bool m_numOnesValid;
+
   friend class boost::serialization::access;
 
   /* Serialization */
@@ -25,6 +31,9 @@ class Agent {
   void serialize(Archive &ar, const unsigned int version) {
     ar &m_chromosome;
     ar &m_energy;
+    if (Archive::is_loading::value) {
+      m_numOnesValid = false;
+    }
   }
 
  public:
@@ -49,14 +58,36 @@ class Agent {
   /* Copy constructor */
   Agent(const Agent &agent);
 
-  /* Array-like access to the chromosome bytes */
+  /* Array-like access to the chromosome bytes.  The non-const versions
+   * invalidate the cached Hamming weight */
   char &operator[](unsigned index);
   const char &operator[](unsigned index) const;
 
-  /* Getter for the chromosome */
+  /* Getter for the chromosome.  The non-const version invalidates the cached
+   * Hamming weight */
   Buffer &getChromosome(void);
   const Buffer &getChromosomeConst(void) const;
 
+  /**
+   * @brief Hamming weight of the chromosome.  O(1) unless the chromosome was
+   *  modified through `getChromosome` or `operator[]` since the weight was
+   *  last known, in which case it is recounted once.
+   *
+   * @note Recounting writes to the cache, so concurrent readers of the same
+   *  agent must make sure the weight is known beforehand.
+   */
+  unsigned getNumOnes(void) const;
+
+  /**
+   * @brief Tells the agent the Hamming weight of its chromosome, for callers
+   *  that have modified the chromosome and kept track of the change (e.g.
+   *  `mutate` and `crossover`)
+   */
+  void setNumOnes(unsigned numOnes);
+
+  /* Shannon entropy of the chromosome, from the cached Hamming weight */
+  double getEntropy(void) const;
+
   /* Getter and setter for the energy */
   double getEnergy(void) const;
   void setEnergy(double energy);
@@ -66,6 +97,54 @@ class Agent {
 BOOST_CLASS_VERSION(Agent, 0)
 
 
+/* Each operation below also has an overload that works on agents stored in
+ * the slots of a `Population` */
+class Population;
+
+
+/**
+ * @brief Algorithms used by `mutate`.  `MUTATION_AUTO` (the default) picks
+ *  one from `muNumMutations` and the chromosome size with
+ *  `selectMutationEngine`.
+ *
+ *    Engine              Algorithm
+ *
+ *    MUTATION_POISSON    Poisson(`muNumMutations`) flips at uniformly drawn
+ *                        positions, one random draw per flip
+ *    MUTATION_GEOMETRIC  Every bit flips with probability `p`, jumping
+ *                        between flips with geometric gaps
+ *    MUTATION_MASK       Every bit flips with probability `p`, using random
+ *                        masks built a word at a time
+ *
+ *  For the last two `p = muNumMutations / n` (at most 1/2), where `n` is the
+ *  number of bits, so the number of flips is Binomial(n, p), which is close
+ *  to Poisson(`muNumMutations`) when `p` is small.
+ */
+typedef enum {
+  MUTATION_AUTO,
+  MUTATION_POISSON,
+  MUTATION_GEOMETRIC,
+  MUTATION_MASK
+} MutationEngine;
+
+/* Forces the engine used by `mutate` for the whole process */
+void setMutationEngine(MutationEngine engine);
+MutationEngine getMutationEngine(void);
+
+/**
+ * @brief The engine `MUTATION_AUTO` uses.  Few flips are cheapest one at a
+ *  time (`MUTATION_POISSON`), many flips are cheaper with geometric skips,
+ *  and when more than one bit in sixteen flips it is cheaper to generate
+ *  whole masks.
+ *
+ * @param muNumMutations
+ * @param sizeChromosome chromosome size in bytes
+ *
+ * @return engine, never `MUTATION_AUTO`
+ */
+MutationEngine selectMutationEngine(double muNumMutations,
+                                    unsigned sizeChromosome);
+
 /**
  * @brief Performs `n` mutations (bit flips) to the chromosome.  `n` is a
  *  random integer drawn from a Poisson distribution with mean value
@@ -75,27 +154,53 @@ BOOST_CLASS_VERSION(Agent, 0)
  *  the next flip inverts a previous flip, resulting in no net change to
  *  the chromosome.
  *
+ * @note At high mutation rates the Bernoulli engines (see `MutationEngine`)
+ *  are used instead.  They never flip a bit twice.
+ *
+ * @note The cached Hamming weight of the agent is updated along with the
+ *  flips, one word at a time, rather than recounted.
+ *
  * @param agent
  * @param params
+ * @param random random number stream
  *
  * @return numMutations (`n`)
  */
-unsigned mutate(Agent &agent, const Parameters &params);
+unsigned mutate(Agent &agent, const Parameters &params, Random &random);
+unsigned mutate(Population &population, unsigned slot,
+                const Parameters &params, Random &random);
 
 /**
  * @brief Performs `n` crossovers between two parent chromosomes to create a
  *  child chromosome.  `n` is a random integer drawn from a Poisson
  *  distribution with mean value `muNumCrossovers`.  The crossover locations
- *  are drawn from a uniform distribution.
+ *  are drawn from a uniform distribution over the bytes of the chromosome.
  *
  * @param father
  * @param mother
  * @param params
+ * @param random random number stream
  *
  * @return child agent
  */
 Agent crossover(const Agent &father, const Agent &mother,
-                const Parameters &params);
+                const Parameters &params, Random &random);
+
+/**
+ * @brief Same as above, but writes the child straight into the preallocated
+ *  slot `child` of the population, and gives it `lambdaEnergy`.  Segments
+ *  are copied a word at a time and nothing is allocated.  Either way the
+ *  child's Hamming weight is summed up from the segments as they are copied.
+ *
+ * @param population
+ * @param father
+ * @param mother
+ * @param child slot receiving the child.  Must differ from the parents.
+ * @param params
+ * @param random random number stream
+ */
+void crossover(Population &population, unsigned father, unsigned mother,
+               unsigned child, const Parameters &params, Random &random);
 
 typedef enum {
   PREDATION_BOTH_SURVIVE,
@@ -103,6 +208,28 @@ typedef enum {
   PREDATION_SECOND_SURVIVES
 } PredationOutcome;
 
+/**
+ * @brief Computes the score function `K(a, b)` used by `predation` (see
+ *  below).  The two-bit cells are resolved a whole word at a time with
+ *  bit-sliced boolean algebra, so this is much faster than looking up each
+ *  cell in the score table.
+ *
+ * @note This function throws an exception when the chromosomes are unequally
+ *  sized.
+ *
+ * @param a chromosome of individual `a`
+ * @param b chromosome of individual `b`
+ *
+ * @return score
+ */
+int predationScore(const Buffer &a, const Buffer &b);
+
+/**
+ * @brief Slow, cell-by-cell version of `predationScore` using the look-up
+ *  table directly.  Only meant for testing.
+ */
+int predationScoreReference(const Buffer &a, const Buffer &b);
+
 /**
  * @brief Performs a `predation` operation between two individuals.  There are
  *  three possible return values ...
@@ -159,21 +286,50 @@ typedef enum {
  *
  * @param a chromosome of individual `a`
  * @param b chromosome of individual `b`
+ * @param params
+ * @param random random number stream
  *
  * @return reference to the winning chromosome
  */
 PredationOutcome predation(const Agent &a, const Agent &b,
-                           const Parameters &params);
+                           const Parameters &params, Random &random);
+PredationOutcome predation(const Population &population, unsigned a,
+                           unsigned b, const Parameters &params,
+                           Random &random);
+
+/**
+ * @brief Batched `predation` between the slots `pairs[2k]` and
+ *  `pairs[2k + 1]` of `population`, for `k < numPairs`.  Outcome `k` is
+ *  written to `outcomes[k]` and nothing else is changed, so the caller can
+ *  apply the outcomes in a second pass.
+ *
+ *  The pairs are resolved `pairBlock` at a time: the scores of the whole
+ *  block are computed first, then its Gaussians are drawn in bulk with
+ *  `Random::gaussians`, then the outcomes are decided in one branch-free
+ *  loop.  The outcomes follow the same law as those of
+ *  `predation`, but the random stream is consumed differently, so the two
+ *  do not draw the same outcomes.
+ */
+void predation(const Population &population, const unsigned *pairs,
+               unsigned numPairs, const Parameters &params, Random &random,
+               PredationOutcome *outcomes);
+
+/* Pairs resolved at a time by the batched `predation` and `mate`, on the
+ * stack */
+static const unsigned pairBlock = 256;
 
 /**
  * @brief Feed the `prey` to the `predator`, increasing the energy of the
- *  predator
+ *  predator.  The energy gained depends on the entropy of the prey, which
+ *  is read from its cached Hamming weight.
  *
  * @param predator
  * @param prey
  * @param params
  */
 void feed(Agent &predator, Agent &prey, const Parameters &params);
+void feed(Population &population, unsigned predator, unsigned prey,
+          const Parameters &params);
 
 /**
  * @brief Starve the `agent` to apply a selection pressure related to feeding.
@@ -191,10 +347,13 @@ void feed(Agent &predator, Agent &prey, const Parameters &params);
  *
  * @param agent
  * @param params
+ * @param random random number stream
  *
  * @return outcome
  */
-int starve(Agent &agent, const Parameters &params);
+int starve(Agent &agent, const Parameters &params, Random &random);
+int starve(Population &population, unsigned slot, const Parameters &params,
+           Random &random);
 
 /**
  * @brief Attempts to mate two individuals, applying a selection pressure
@@ -209,9 +368,29 @@ int starve(Agent &agent, const Parameters &params);
  * @param a
  * @param b
  * @param params
+ * @param random random number stream
  *
  * @return
  */
-int mate(const Agent &a, const Agent &b, const Parameters &params);
+int mate(const Agent &a, const Agent &b, const Parameters &params,
+         Random &random);
+int mate(const Population &population, unsigned a, unsigned b,
+         const Parameters &params, Random &random);
+
+/**
+ * @brief Batched `mate` between the slots `pairs[2k]` and `pairs[2k + 1]` of
+ *  `population`, for `k < numPairs`.  Bit `k % 64` of `mask[k / 64]` is set
+ *  when pair `k` mates, so `mask` needs `(numPairs + 63) / 64` words.
+ *
+ *  The pairs are resolved `pairBlock` at a time: the distances of the
+ *  whole block first, then its uniforms in bulk with `Random::uniforms`,
+ *  then the decisions.  With `alpha = 1` the Beta draw of the courtship has
+ *  the closed form `1 - U^(1 / beta)`, so no GSL sampler is involved.  The
+ *  decisions follow the same law as those of `mate`, but the two do not
+ *  consume the random stream alike.
+ */
+void mate(const Population &population, const unsigned *pairs,
+          unsigned numPairs, const Parameters &params, Random &random,
+          uint64_t *mask);
 
 #endif /* end of include guard: EVOLUTION_H */
@@ -0,0 +1,655 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+#include "checkpoint.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Flat checkpoints                                                           *
+ * -------------------------------------------------------------------------- */
+
+static_assert(sizeof(unsigned) == sizeof(uint32_t),
+              "the Hamming weights are stored as 32-bit integers");
+
+static const char checkpointMagic[8] = {'E', 'V', 'O', 'L', 'C', 'K', 'P', 'T'};
+
+/* First two bytes of a gzip stream */
+static const unsigned char gzipMagic[2] = {0x1f, 0x8b};
+
+static uint64_t alignUp(uint64_t n, uint64_t alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+/* Header of a checkpoint of `numAgents` agents of `sizeChromosome` bytes */
+static CheckpointHeader makeHeader(const Parameters &params, uint64_t seed,
+                                   uint64_t generation,
+                                   unsigned sizeChromosome,
+                                   uint64_t numAgents) {
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+  header.version = checkpointVersion;
+  header.headerSize = sizeof(CheckpointHeader);
+  header.seed = seed;
+  header.generation = generation;
+
+  header.numAgents = numAgents;
+  header.sizeChromosome = sizeChromosome;
+  header.stride = Buffer::paddedNumWords(sizeChromosome);
+  header.energyOffset = alignUp(sizeof(header), checkpointAlignment);
+  header.numOnesOffset = alignUp(header.energyOffset +
+                                 numAgents * sizeof(double),
+                                 checkpointAlignment);
+  header.slabOffset = alignUp(header.numOnesOffset +
+                              numAgents * sizeof(uint32_t),
+                              checkpointAlignment);
+  header.fileSize = header.slabOffset +
+                    numAgents * header.stride * Buffer::wordBytes;
+
+  header.sizePopulation = params.sizePopulation;
+  header.muNumMutations = params.muNumMutations;
+  header.muNumCrossovers = params.muNumCrossovers;
+  header.lambdaEnergy = params.lambdaEnergy;
+  header.sigmaPredation = params.sigmaPredation;
+  header.lambdaPredation = params.lambdaPredation;
+  header.lambdaScoreFeed = params.lambdaScoreFeed;
+  header.lambdaEntropyFeed = params.lambdaEntropyFeed;
+  header.muEnergyStarve = params.muEnergyStarve;
+  header.muMating = params.muMating;
+  return header;
+}
+
+/* Parameters stored in `header` */
+static Parameters headerParameters(const CheckpointHeader &header) {
+  Parameters params;
+  params.sizePopulation = header.sizePopulation;
+  params.sizeChromosome = header.sizeChromosome;
+  params.muNumMutations = header.muNumMutations;
+  params.muNumCrossovers = header.muNumCrossovers;
+  params.lambdaEnergy = header.lambdaEnergy;
+  params.sigmaPredation = header.sigmaPredation;
+  params.lambdaPredation = header.lambdaPredation;
+  params.lambdaScoreFeed = header.lambdaScoreFeed;
+  params.lambdaEntropyFeed = header.lambdaEntropyFeed;
+  params.muEnergyStarve = header.muEnergyStarve;
+  params.muMating = header.muMating;
+  return params;
+}
+
+/**
+ * @brief A checkpoint being written.  The data goes to a temporary file next
+ *  to `path`, optionally through gzip, which `commit` syncs to disk and
+ *  renames over `path`.  Readers therefore see either the old or the new
+ *  checkpoint, never a partial one.  An uncommitted file is deleted.
+ *
+ *  Small writes, such as the fields of agents gathered one at a time, are
+ *  staged in a buffer, so the file gets a few large writes.  Writes at least
+ *  as large as the buffer go straight to the file.
+ */
+class CheckpointFile {
+ private:
+  static const size_t bufferSize = 1 << 20;
+
+  std::string m_path;
+  std::string m_temporary;
+  int m_fd;
+#ifdef HAVE_LIBZ
+  gzFile m_gz;
+#endif
+  uint64_t m_position;
+  std::vector<char> m_buffer;
+  size_t m_buffered;          //! Bytes staged in `m_buffer`
+
+  void close(void) {
+#ifdef HAVE_LIBZ
+    if (m_gz != NULL) {
+      gzclose(m_gz);
+      m_gz = NULL;
+    }
+#endif
+    if (m_fd >= 0) {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+ public:
+  CheckpointFile(const std::string &path, bool compress) :
+    m_path(path), m_temporary(path + ".tmp"), m_position(0),
+    m_buffer(bufferSize), m_buffered(0) {
+#ifdef HAVE_LIBZ
+    m_gz = NULL;
+#else
+    if (compress) {
+      throw std::invalid_argument("compressed checkpoints need zlib");
+    }
+#endif
+
+    m_fd = open(m_temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0) {
+      throw std::runtime_error("cannot open " + m_temporary);
+    }
+
+#ifdef HAVE_LIBZ
+    /* zlib gets its own descriptor, so the file can be synced after the
+     * gzip stream is closed */
+    if (compress) {
+      int fd = dup(m_fd);
+      m_gz = (fd < 0) ? NULL : gzdopen(fd, "wb1");
+      if (m_gz == NULL) {
+        if (fd >= 0) {
+          ::close(fd);
+        }
+        close();
+        unlink(m_temporary.c_str());
+        throw std::runtime_error("cannot compress " + m_temporary);
+      }
+    }
+#endif
+  }
+
+  CheckpointFile(const CheckpointFile &) = delete;
+  CheckpointFile &operator= (const CheckpointFile &) = delete;
+
+  ~CheckpointFile() {
+    if (m_fd >= 0) {
+      close();
+      unlink(m_temporary.c_str());
+    }
+  }
+
+  void write(const void *data, uint64_t size) {
+    m_position += size;
+    if (m_buffered + size > bufferSize) {
+      flush();
+    }
+
+    if (size >= bufferSize) {
+      writeThrough(data, size);
+    } else {
+      memcpy(&m_buffer[m_buffered], data, size);
+      m_buffered += size;
+    }
+  }
+
+  /* Writes the staged bytes */
+  void flush(void) {
+    writeThrough(m_buffer.data(), m_buffered);
+    m_buffered = 0;
+  }
+
+  void writeThrough(const void *data, uint64_t size) {
+    const char *bytes = static_cast<const char *>(data);
+
+    while (size > 0) {
+      unsigned n = std::min<uint64_t>(size, 1 << 30);
+#ifdef HAVE_LIBZ
+      if (m_gz != NULL) {
+        if (gzwrite(m_gz, bytes, n) != (int) n) {
+          throw std::runtime_error("cannot write " + m_temporary);
+        }
+        bytes += n;
+        size -= n;
+        continue;
+      }
+#endif
+      ssize_t written = ::write(m_fd, bytes, n);
+      if (written <= 0) {
+        throw std::runtime_error("cannot write " + m_temporary);
+      }
+      bytes += written;
+      size -= written;
+    }
+  }
+
+  /* Writes zeros up to `offset` */
+  void padTo(uint64_t offset) {
+    static const char zeros[4096] = {0};
+    while (m_position < offset) {
+      write(zeros, std::min<uint64_t>(offset - m_position, sizeof(zeros)));
+    }
+  }
+
+  void commit(void) {
+    flush();
+#ifdef HAVE_LIBZ
+    if (m_gz != NULL) {
+      int status = gzclose(m_gz);
+      m_gz = NULL;
+      if (status != Z_OK) {
+        throw std::runtime_error("cannot write " + m_temporary);
+      }
+    }
+#endif
+    if (fsync(m_fd) != 0) {
+      throw std::runtime_error("cannot sync " + m_temporary);
+    }
+    close();
+
+    if (rename(m_temporary.c_str(), m_path.c_str()) != 0) {
+      unlink(m_temporary.c_str());
+      throw std::runtime_error("cannot rename " + m_temporary);
+    }
+
+    /* Make the rename itself durable */
+    size_t slash = m_path.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "." :
+                            m_path.substr(0, slash + 1);
+    int fd = open(directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      fsync(fd);
+      ::close(fd);
+    }
+  }
+};
+
+/**
+ * @brief Writes a whole checkpoint.  `energies(file)`, `numOnes(file)` and
+ *  `slab(file)` write the arrays of all the agents, in order.
+ */
+template <typename Energies, typename NumOnes, typename Slab>
+static void writeFile(const std::string &path, bool compress,
+                      const CheckpointHeader &header, Energies energies,
+                      NumOnes numOnes, Slab slab) {
+  CheckpointFile file(path, compress);
+  file.write(&header, sizeof(header));
+
+  file.padTo(header.energyOffset);
+  energies(file);
+  file.padTo(header.numOnesOffset);
+  numOnes(file);
+  file.padTo(header.slabOffset);
+  slab(file);
+
+  file.commit();
+}
+
+bool isCheckpoint(const std::string &path) {
+  char magic[sizeof(checkpointMagic)];
+
+#ifdef HAVE_LIBZ
+  /* Reads compressed and plain files alike */
+  gzFile gz = gzopen(path.c_str(), "rb");
+  if (gz == NULL) {
+    return false;
+  }
+  int n = gzread(gz, magic, sizeof(magic));
+  gzclose(gz);
+  return n == sizeof(magic) &&
+         memcmp(magic, checkpointMagic, sizeof(magic)) == 0;
+#else
+  std::ifstream ifs(path, std::ios::binary);
+  return ifs.read(magic, sizeof(magic)) &&
+         memcmp(magic, checkpointMagic, sizeof(magic)) == 0;
+#endif
+}
+
+void writeCheckpoint(const std::string &path, const Parameters &params,
+                     uint64_t seed, uint64_t generation,
+                     const Population &population, const SlotVector &order,
+                     bool compress) {
+  CheckpointHeader header = makeHeader(params, seed, generation,
+                                       population.sizeChromosome(),
+                                       order.size());
+
+  /* Gathered agent by agent, through the buffer of the file */
+  writeFile(path, compress, header, [&](CheckpointFile &file) {
+    for (unsigned k = 0; k < order.size(); k++) {
+      double energy = population.getEnergy(order[k]);
+      file.write(&energy, sizeof(energy));
+    }
+  }, [&](CheckpointFile &file) {
+    for (unsigned k = 0; k < order.size(); k++) {
+      uint32_t numOnes = population.getNumOnes(order[k]);
+      file.write(&numOnes, sizeof(numOnes));
+    }
+  }, [&](CheckpointFile &file) {
+    size_t size = population.stride() * Buffer::wordBytes;
+    for (unsigned k = 0; k < order.size(); k++) {
+      file.write(population.chromosome(order[k]), size);
+    }
+  });
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Background checkpoints                                                     *
+ * -------------------------------------------------------------------------- */
+
+void CheckpointSnapshot::capture(const Parameters &params, uint64_t seed,
+                                 uint64_t generation,
+                                 const Population &population,
+                                 const SlotVector &order) {
+  m_header = makeHeader(params, seed, generation,
+                        population.sizeChromosome(), order.size());
+
+  unsigned stride = population.stride();
+  m_energy.resize(order.size());
+  m_numOnes.resize(order.size());
+  m_slab.resize((size_t) order.size() * stride);
+
+  for (unsigned k = 0; k < order.size(); k++) {
+    m_energy[k] = population.getEnergy(order[k]);
+    m_numOnes[k] = population.getNumOnes(order[k]);
+    memcpy(&m_slab[(size_t) k * stride], population.chromosome(order[k]),
+           stride * Buffer::wordBytes);
+  }
+}
+
+uint64_t CheckpointSnapshot::generation(void) const {
+  return m_header.generation;
+}
+
+void CheckpointSnapshot::write(const std::string &path, bool compress) const {
+  /* The arrays are contiguous already */
+  writeFile(path, compress, m_header, [&](CheckpointFile &file) {
+    file.write(m_energy.data(), m_energy.size() * sizeof(double));
+  }, [&](CheckpointFile &file) {
+    file.write(m_numOnes.data(), m_numOnes.size() * sizeof(uint32_t));
+  }, [&](CheckpointFile &file) {
+    file.write(m_slab.data(), m_slab.size() * Buffer::wordBytes);
+  });
+}
+
+CheckpointWriter::CheckpointWriter(const std::string &path, bool compress) :
+  m_path(path), m_compress(compress), m_writing(-1), m_queued(-1),
+  m_stop(false) {
+#ifndef HAVE_LIBZ
+  if (compress) {
+    throw std::invalid_argument("compressed checkpoints need zlib");
+  }
+#endif
+  m_thread = std::thread(&CheckpointWriter::worker, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  m_thread.join();
+}
+
+void CheckpointWriter::worker(void) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (true) {
+    m_wake.wait(lock, [&] { return m_stop || m_queued >= 0; });
+    if (m_queued < 0) {
+      return;
+    }
+
+    m_writing = m_queued;
+    m_queued = -1;
+    m_done.notify_all();
+    lock.unlock();
+
+    try {
+      m_snapshots[m_writing].write(m_path, m_compress);
+    } catch (...) {
+      lock.lock();
+      m_error = std::current_exception();
+      lock.unlock();
+    }
+
+    lock.lock();
+    m_writing = -1;
+    m_done.notify_all();
+  }
+}
+
+void CheckpointWriter::rethrow(void) {
+  if (m_error) {
+    std::exception_ptr error = m_error;
+    m_error = std::exception_ptr();
+    std::rethrow_exception(error);
+  }
+}
+
+void CheckpointWriter::save(const Parameters &params, uint64_t seed,
+                            uint64_t generation,
+                            const Population &population,
+                            const SlotVector &order) {
+  int free;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&] { return m_queued < 0; });
+    rethrow();
+    free = (m_writing == 0) ? 1 : 0;
+  }
+
+  /* The worker only touches the snapshot it is writing */
+  m_snapshots[free].capture(params, seed, generation, population, order);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queued = free;
+  }
+  m_wake.notify_one();
+}
+
+void CheckpointWriter::wait(void) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [&] { return m_queued < 0 && m_writing < 0; });
+  rethrow();
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Loading checkpoints                                                        *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Three arrays of a checkpoint mapped into memory.  Each array is
+ *  mapped privately at the start of a larger anonymous reservation, so the
+ *  population can grow in place.
+ */
+class CheckpointMapping {
+ private:
+  std::vector<void *> m_regions;
+  std::vector<size_t> m_lengths;
+
+ public:
+  CheckpointMapping() { }
+  CheckpointMapping(const CheckpointMapping &) = delete;
+  CheckpointMapping &operator= (const CheckpointMapping &) = delete;
+
+  ~CheckpointMapping() {
+    for (unsigned k = 0; k < m_regions.size(); k++) {
+      munmap(m_regions[k], m_lengths[k]);
+    }
+  }
+
+  /**
+   * @brief Reserves `capacity` bytes and maps `length` bytes of `fd`,
+   *  starting at `offset`, over the beginning
+   */
+  void *map(int fd, uint64_t offset, size_t length, size_t capacity) {
+    capacity = alignUp(std::max<size_t>(capacity, 1), sysconf(_SC_PAGESIZE));
+    void *region = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+      throw std::runtime_error("cannot reserve memory for a checkpoint");
+    }
+    m_regions.push_back(region);
+    m_lengths.push_back(capacity);
+
+    if (length > 0 &&
+        mmap(region, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, offset) == MAP_FAILED) {
+      throw std::runtime_error("cannot map a checkpoint");
+    }
+    return region;
+  }
+};
+
+/* Closes a file descriptor when it goes out of scope */
+class FileDescriptor {
+ private:
+  int m_fd;
+
+ public:
+  FileDescriptor(int fd) : m_fd(fd) { }
+
+  ~FileDescriptor() {
+    if (m_fd >= 0) {
+      close(m_fd);
+    }
+  }
+
+  int get(void) const {
+    return m_fd;
+  }
+};
+
+/* Throws unless `header` describes a checkpoint we can read */
+static void checkHeader(const CheckpointHeader &header,
+                        const std::string &path) {
+  uint64_t numAgents = header.numAgents;
+  bool valid =
+    memcmp(header.magic, checkpointMagic, sizeof(checkpointMagic)) == 0 &&
+    header.version == checkpointVersion &&
+    header.headerSize == sizeof(CheckpointHeader) &&
+    header.stride == Buffer::paddedNumWords(header.sizeChromosome) &&
+    header.energyOffset % checkpointAlignment == 0 &&
+    header.numOnesOffset % checkpointAlignment == 0 &&
+    header.slabOffset % checkpointAlignment == 0 &&
+    header.energyOffset >= sizeof(CheckpointHeader) &&
+    header.numOnesOffset >= header.energyOffset +
+    numAgents * sizeof(double) &&
+    header.slabOffset >= header.numOnesOffset +
+    numAgents * sizeof(uint32_t) &&
+    header.fileSize == header.slabOffset +
+    numAgents * header.stride * Buffer::wordBytes;
+
+  if (!valid) {
+    throw std::runtime_error(path + " is not a valid checkpoint");
+  }
+}
+
+#ifdef HAVE_LIBZ
+/**
+ * @brief Reads a compressed checkpoint into ordinary memory.  Compressed
+ *  files cannot be mapped, so this is O(n) like any other load.
+ */
+static Population inflateCheckpoint(const std::string &path,
+                                    CheckpointHeader &header) {
+  std::unique_ptr<gzFile_s, int(*)(gzFile)> gz(gzopen(path.c_str(), "rb"),
+      gzclose);
+  if (!gz) {
+    throw std::runtime_error("cannot open " + path);
+  }
+
+  /* Reads exactly `size` bytes at `offset` */
+  auto read = [&](uint64_t offset, void *data, uint64_t size) {
+    if (gzseek(gz.get(), offset, SEEK_SET) != (z_off_t) offset) {
+      throw std::runtime_error(path + " is not a valid checkpoint");
+    }
+
+    char *bytes = static_cast<char *>(data);
+    while (size > 0) {
+      unsigned n = std::min<uint64_t>(size, 1 << 30);
+      if (gzread(gz.get(), bytes, n) != (int) n) {
+        throw std::runtime_error(path + " is not a valid checkpoint");
+      }
+      bytes += n;
+      size -= n;
+    }
+  };
+
+  read(0, &header, sizeof(header));
+  checkHeader(header, path);
+
+  unsigned numAgents = header.numAgents;
+  Population population(header.sizeChromosome);
+  population.reserve(numAgents);
+  for (unsigned k = 0; k < numAgents; k++) {
+    population.allocate(false);
+  }
+
+  std::vector<double> energy(numAgents);
+  std::vector<uint32_t> numOnes(numAgents);
+  read(header.energyOffset, energy.data(), numAgents * sizeof(double));
+  read(header.numOnesOffset, numOnes.data(), numAgents * sizeof(uint32_t));
+  if (numAgents > 0) {
+    read(header.slabOffset, population.chromosome(0),
+         (uint64_t) numAgents * header.stride * Buffer::wordBytes);
+  }
+
+  for (unsigned k = 0; k < numAgents; k++) {
+    population.setEnergy(k, energy[k]);
+    population.setNumOnes(k, numOnes[k]);
+  }
+  return population;
+}
+#endif
+
+Population mapCheckpoint(const std::string &path, Parameters &params,
+                         uint64_t &seed, uint64_t &generation) {
+  FileDescriptor fd(open(path.c_str(), O_RDONLY));
+  struct stat st;
+  if (fd.get() < 0 || fstat(fd.get(), &st) != 0) {
+    throw std::runtime_error("cannot open " + path);
+  }
+
+  CheckpointHeader header;
+  unsigned char magic[sizeof(gzipMagic)];
+  if (pread(fd.get(), magic, sizeof(magic), 0) == sizeof(magic) &&
+      memcmp(magic, gzipMagic, sizeof(magic)) == 0) {
+#ifdef HAVE_LIBZ
+    Population population = inflateCheckpoint(path, header);
+    params = headerParameters(header);
+    seed = header.seed;
+    generation = header.generation;
+    return population;
+#else
+    throw std::runtime_error("compressed checkpoints need zlib: " + path);
+#endif
+  }
+
+  if (pread(fd.get(), &header, sizeof(header), 0) != sizeof(header)) {
+    throw std::runtime_error(path + " is not a valid checkpoint");
+  }
+  checkHeader(header, path);
+  if (header.fileSize != (uint64_t) st.st_size) {
+    throw std::runtime_error(path + " is truncated");
+  }
+  if (checkpointAlignment % sysconf(_SC_PAGESIZE) != 0) {
+    throw std::runtime_error("the page size is too large to map " + path);
+  }
+
+  params = headerParameters(header);
+  seed = header.seed;
+  generation = header.generation;
+
+  /* Room for the survivors, their children and the algae of a generation
+   * step, so the first steps run in place */
+  unsigned numAgents = header.numAgents;
+  unsigned capacity = 2 * numAgents + header.sizePopulation;
+  size_t slotBytes = header.stride * Buffer::wordBytes;
+
+  std::shared_ptr<CheckpointMapping> mapping(new CheckpointMapping());
+  void *energy = mapping->map(fd.get(), header.energyOffset,
+                              numAgents * sizeof(double),
+                              capacity * sizeof(double));
+  void *numOnes = mapping->map(fd.get(), header.numOnesOffset,
+                               numAgents * sizeof(uint32_t),
+                               capacity * sizeof(uint32_t));
+  void *slab = mapping->map(fd.get(), header.slabOffset,
+                            numAgents * slotBytes, capacity * slotBytes);
+
+  return Population(header.sizeChromosome, numAgents, capacity,
+                    static_cast<Buffer::Word *>(slab),
+                    static_cast<double *>(energy),
+                    static_cast<unsigned *>(numOnes), mapping);
+}
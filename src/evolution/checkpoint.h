@@ -0,0 +1,214 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "parameters.h"
+#include "population.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Flat checkpoints                                                           *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Fixed-size header at the start of a flat checkpoint.  The file
+ *  continues with three arrays, each starting at a multiple of
+ *  `checkpointAlignment` so that it can be memory-mapped on its own ...
+ *
+ *    Offset            Contents
+ *
+ *    0                 CheckpointHeader
+ *    energyOffset      numAgents doubles, the energy of each agent
+ *    numOnesOffset     numAgents uint32_t, the Hamming weight of each agent
+ *    slabOffset        numAgents chromosomes of `stride` 64-bit words each,
+ *                      zero padded, like the slots of a `Population`
+ *
+ *  The agents are stored in pairing order and all numbers are little-endian
+ *  (the only byte order we build for).  Unused bytes are zero.  A whole file
+ *  in this format may also be gzip compressed, at the cost of not being
+ *  mappable.
+ */
+typedef struct {
+  char magic[8];            //! "EVOLCKPT"
+  uint32_t version;         //! Format version, see `checkpointVersion`
+  uint32_t headerSize;      //! sizeof(CheckpointHeader)
+
+  uint64_t seed;            //! Master seed of the ecosystem
+  uint64_t generation;      //! Number of generations run
+
+  uint32_t numAgents;       //! Number of live agents
+  uint32_t sizeChromosome;  //! Bytes per chromosome
+  uint32_t stride;          //! Words per chromosome, including padding
+  uint32_t reserved;
+
+  uint64_t energyOffset;    //! Offsets of the arrays from the file start
+  uint64_t numOnesOffset;
+  uint64_t slabOffset;
+  uint64_t fileSize;        //! Total size of the file
+
+  /* Parameters */
+  uint32_t sizePopulation;
+  uint32_t reservedParameters;
+  double muNumMutations;
+  double muNumCrossovers;
+  double lambdaEnergy;
+  double sigmaPredation;
+  double lambdaPredation;
+  double lambdaScoreFeed;
+  double lambdaEntropyFeed;
+  double muEnergyStarve;
+  double muMating;
+} CheckpointHeader;
+
+/* Current version of the format */
+static const uint32_t checkpointVersion = 1;
+
+/* Alignment of the arrays in the file.  It is a multiple of the page size
+ * of every platform we run on, which `mmap` requires */
+static const uint64_t checkpointAlignment = 1 << 16;
+
+/**
+ * @brief Checks whether the file at `path` starts like a flat checkpoint,
+ *  compressed or not (as opposed to, e.g., a Boost archive)
+ */
+bool isCheckpoint(const std::string &path);
+
+/**
+ * @brief Writes a flat checkpoint.  The agents in the slots listed by
+ *  `order` are written in that order.  The file is written under a
+ *  temporary name, synced and renamed over `path`, so `path` always holds a
+ *  complete checkpoint.
+ *
+ * @note This function throws an exception when the file cannot be written,
+ *  or when compression is asked for but we were built without zlib.
+ *
+ * @param compress gzip the file
+ */
+void writeCheckpoint(const std::string &path, const Parameters &params,
+                     uint64_t seed, uint64_t generation,
+                     const Population &population, const SlotVector &order,
+                     bool compress = false);
+
+/**
+ * @brief Maps a flat checkpoint into memory.  The returned population
+ *  lives directly in the (private, copy-on-write) mapping, so nothing is
+ *  read or copied until it is touched, and the file itself never changes.
+ *  Agent `k` of the checkpoint is in slot `k`.  The mapping reserves
+ *  (virtual) room for the population to grow before it has to move into
+ *  ordinary memory.
+ *
+ * @note Compressed checkpoints cannot be mapped and are inflated into
+ *  ordinary memory instead.
+ *
+ * @note This function throws an exception when the file cannot be mapped or
+ *  is not a valid checkpoint.
+ *
+ * @param path
+ * @param params receives the parameters
+ * @param seed receives the master seed
+ * @param generation receives the generation
+ *
+ * @return population
+ */
+Population mapCheckpoint(const std::string &path, Parameters &params,
+                         uint64_t &seed, uint64_t &generation);
+
+
+/* -------------------------------------------------------------------------- *
+ * Background checkpoints                                                     *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief A copy of the state of an ecosystem, laid out like a checkpoint
+ *  file.  Capturing again reuses the memory of the previous capture.
+ */
+class CheckpointSnapshot {
+ private:
+  CheckpointHeader m_header;
+  std::vector<double> m_energy;
+  std::vector<uint32_t> m_numOnes;
+  Buffer::WordVector m_slab;
+
+ public:
+
+  /* Copies the agents in the slots listed by `order`, in that order */
+  void capture(const Parameters &params, uint64_t seed, uint64_t generation,
+               const Population &population, const SlotVector &order);
+
+  uint64_t generation(void) const;
+
+  /* Writes the snapshot like `writeCheckpoint` */
+  void write(const std::string &path, bool compress) const;
+};
+
+/**
+ * @brief Writes checkpoints from a background thread, so a long run only
+ *  pauses for as long as it takes to copy the population into memory.
+ *
+ *  The writer is double buffered: `save` copies the state into whichever
+ *  snapshot is not being written and queues it.  It only blocks when a
+ *  snapshot is still queued, i.e. when checkpoints are requested faster
+ *  than the disk can take them.  Every checkpoint replaces the previous one
+ *  atomically.
+ */
+class CheckpointWriter {
+ private:
+  std::string m_path;
+  bool m_compress;
+
+  CheckpointSnapshot m_snapshots[2];
+  int m_writing;                  //! Snapshot being written, or -1
+  int m_queued;                   //! Snapshot waiting to be written, or -1
+  bool m_stop;
+  std::exception_ptr m_error;     //! Failure of the last write
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake; //! Signals the worker
+  std::condition_variable m_done; //! Signals that a snapshot was taken up
+  std::thread m_thread;
+
+  void worker(void);
+
+  /* Rethrows the failure of a background write.  Requires the lock */
+  void rethrow(void);
+
+ public:
+
+  /**
+   * @brief Starts the background thread
+   *
+   * @param path file replaced by every checkpoint
+   * @param compress gzip the checkpoints
+   */
+  CheckpointWriter(const std::string &path, bool compress = false);
+
+  /* Finishes the pending checkpoints */
+  ~CheckpointWriter();
+
+  CheckpointWriter(const CheckpointWriter &) = delete;
+  CheckpointWriter &operator= (const CheckpointWriter &) = delete;
+
+  /**
+   * @brief Snapshots the state and queues it for writing
+   *
+   * @note This function rethrows the exception of a failed earlier write.
+   */
+  void save(const Parameters &params, uint64_t seed, uint64_t generation,
+            const Population &population, const SlotVector &order);
+
+  /**
+   * @brief Waits until every queued checkpoint is on disk
+   *
+   * @note This function rethrows the exception of a failed write.
+   */
+  void wait(void);
+};
+
+
+#endif /* end of include guard: CHECKPOINT_H */
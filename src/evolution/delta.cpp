@@ -0,0 +1,497 @@
+#include <cstring>
+#include <stdexcept>
+#include "checkpoint.h"
+#include "delta.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Delta checkpoints                                                          *
+ * -------------------------------------------------------------------------- */
+
+static const char deltaMagic[8] = {'E', 'V', 'O', 'L', 'D', 'L', 'T', 'A'};
+
+/* Start of the stream */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+} DeltaStreamHeader;
+
+/* Start of every record */
+typedef struct {
+  uint32_t type;            //! DeltaRecordType
+  uint32_t reserved;
+  uint64_t generation;      //! Generation the record brings the state to
+  uint64_t size;            //! Bytes in the record after this header
+} DeltaRecordHeader;
+
+/* Start of a FULL record.  It is followed by the `numAgents` ids, energies
+ * and chromosomes (`sizeChromosome` bytes each) in pairing order */
+typedef struct {
+  uint64_t seed;
+  uint32_t numAgents;
+  uint32_t sizeChromosome;
+  uint32_t sizePopulation;
+  uint32_t reserved;
+  double muNumMutations;
+  double muNumCrossovers;
+  double lambdaEnergy;
+  double sigmaPredation;
+  double lambdaPredation;
+  double lambdaScoreFeed;
+  double lambdaEntropyFeed;
+  double muEnergyStarve;
+  double muMating;
+} DeltaFullHeader;
+
+/* Start of a DELTA record.  It is followed by the ids of the dead, the
+ * births (a `DeltaBirth`, the energy and the chromosome each), the pairing
+ * order as ids, and the indices (in the order) and values of the energies
+ * that changed */
+typedef struct {
+  uint32_t numDeaths;
+  uint32_t numBirths;
+  uint32_t numAgents;
+  uint32_t numChanged;
+} DeltaChangeHeader;
+
+template <typename T>
+static void writeArray(std::ofstream &stream, const std::vector<T> &array) {
+  stream.write(reinterpret_cast<const char *>(array.data()),
+               array.size() * sizeof(T));
+}
+
+DeltaWriter::DeltaWriter(const std::string &path, unsigned fullInterval,
+                         const Parameters &params, uint64_t seed,
+                         uint64_t generation, const Population &population,
+                         const SlotVector &order,
+                         const std::vector<uint64_t> &ids) :
+  m_stream(path, std::ios::binary | std::ios::trunc), m_path(path),
+  m_fullInterval(fullInterval) {
+  if (!m_stream) {
+    throw std::runtime_error("cannot open " + path);
+  }
+  if (fullInterval == 0) {
+    throw std::invalid_argument("the full record interval must be positive");
+  }
+
+  DeltaStreamHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, deltaMagic, sizeof(deltaMagic));
+  header.version = deltaVersion;
+  m_stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  finishFull(params, seed, generation, population, order, ids);
+}
+
+void DeltaWriter::born(unsigned slot, const DeltaBirth &birth) {
+  if (slot >= m_birthIndex.size()) {
+    m_birthIndex.resize(2 * slot + 1, -1);
+  }
+
+  m_birthIndex[slot] = m_births.size();
+  m_births.push_back(birth);
+  m_birthSlots.push_back(slot);
+  m_birthDied.push_back(0);
+}
+
+void DeltaWriter::died(unsigned slot, uint64_t id) {
+  m_deaths.push_back(id);
+
+  /* Algae can die in the generation they were born in */
+  if (slot < m_birthIndex.size() && m_birthIndex[slot] >= 0) {
+    int index = m_birthIndex[slot];
+    if (m_births[index].id == id) {
+      m_birthDied[index] = 1;
+      m_birthIndex[slot] = -1;
+    }
+  }
+}
+
+void DeltaWriter::finish(const Parameters &params, uint64_t seed,
+                         uint64_t generation, const Population &population,
+                         const SlotVector &order,
+                         const std::vector<uint64_t> &ids) {
+  /* The FULL record is written after the events, so the lineage has no
+   * gap at the generations that get one */
+  finishDelta(generation, population, order, ids);
+  if (generation % m_fullInterval == 0) {
+    finishFull(params, seed, generation, population, order, ids);
+  }
+}
+
+void DeltaWriter::finishFull(const Parameters &params, uint64_t seed,
+                             uint64_t generation,
+                             const Population &population,
+                             const SlotVector &order,
+                             const std::vector<uint64_t> &ids) {
+  unsigned numAgents = order.size();
+  unsigned size = population.sizeChromosome();
+
+  DeltaFullHeader full;
+  memset(&full, 0, sizeof(full));
+  full.seed = seed;
+  full.numAgents = numAgents;
+  full.sizeChromosome = size;
+  full.sizePopulation = params.sizePopulation;
+  full.muNumMutations = params.muNumMutations;
+  full.muNumCrossovers = params.muNumCrossovers;
+  full.lambdaEnergy = params.lambdaEnergy;
+  full.sigmaPredation = params.sigmaPredation;
+  full.lambdaPredation = params.lambdaPredation;
+  full.lambdaScoreFeed = params.lambdaScoreFeed;
+  full.lambdaEntropyFeed = params.lambdaEntropyFeed;
+  full.muEnergyStarve = params.muEnergyStarve;
+  full.muMating = params.muMating;
+
+  DeltaRecordHeader record;
+  memset(&record, 0, sizeof(record));
+  record.type = DELTA_RECORD_FULL;
+  record.generation = generation;
+  record.size = sizeof(full) +
+                (uint64_t) numAgents * (sizeof(uint64_t) + sizeof(double) +
+                                        size);
+
+  m_stream.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  m_stream.write(reinterpret_cast<const char *>(&full), sizeof(full));
+  for (unsigned k = 0; k < numAgents; k++) {
+    uint64_t id = ids[order[k]];
+    m_stream.write(reinterpret_cast<const char *>(&id), sizeof(id));
+  }
+  for (unsigned k = 0; k < numAgents; k++) {
+    double energy = population.getEnergy(order[k]);
+    m_stream.write(reinterpret_cast<const char *>(&energy), sizeof(energy));
+  }
+  for (unsigned k = 0; k < numAgents; k++) {
+    m_stream.write(reinterpret_cast<const char *>(
+                     population.chromosome(order[k])), size);
+  }
+
+  endRecord(population, order);
+}
+
+void DeltaWriter::finishDelta(uint64_t generation,
+                              const Population &population,
+                              const SlotVector &order,
+                              const std::vector<uint64_t> &ids) {
+  unsigned numAgents = order.size();
+  unsigned size = population.sizeChromosome();
+
+  /* New order, and the energies of the survivors that changed */
+  m_orderIds.resize(numAgents);
+  m_changedIndices.clear();
+  m_changedEnergies.clear();
+  for (unsigned k = 0; k < numAgents; k++) {
+    unsigned slot = order[k];
+    m_orderIds[k] = ids[slot];
+
+    bool newborn = slot < m_birthIndex.size() && m_birthIndex[slot] >= 0;
+    double energy = population.getEnergy(slot);
+    if (!newborn && (slot >= m_energy.size() || m_energy[slot] != energy)) {
+      m_changedIndices.push_back(k);
+      m_changedEnergies.push_back(energy);
+    }
+  }
+
+  DeltaChangeHeader change;
+  change.numDeaths = m_deaths.size();
+  change.numBirths = m_births.size();
+  change.numAgents = numAgents;
+  change.numChanged = m_changedIndices.size();
+
+  DeltaRecordHeader record;
+  memset(&record, 0, sizeof(record));
+  record.type = DELTA_RECORD_DELTA;
+  record.generation = generation;
+  record.size = sizeof(change) +
+                change.numDeaths * sizeof(uint64_t) +
+                change.numBirths * (sizeof(DeltaBirth) + sizeof(double) +
+                                    size) +
+                (uint64_t) numAgents * sizeof(uint64_t) +
+                change.numChanged * (sizeof(uint32_t) + sizeof(double));
+
+  m_stream.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  m_stream.write(reinterpret_cast<const char *>(&change), sizeof(change));
+  writeArray(m_stream, m_deaths);
+
+  /* Agents that died right away (algae) have no state worth keeping */
+  m_bytes.assign(size, 0);
+  for (unsigned n = 0; n < m_births.size(); n++) {
+    unsigned slot = m_birthSlots[n];
+    double energy = m_birthDied[n] ? 0 : population.getEnergy(slot);
+    const char *bytes = m_birthDied[n] ? m_bytes.data() :
+                        reinterpret_cast<const char *>(
+                          population.chromosome(slot));
+
+    m_stream.write(reinterpret_cast<const char *>(&m_births[n]),
+                   sizeof(DeltaBirth));
+    m_stream.write(reinterpret_cast<const char *>(&energy), sizeof(energy));
+    m_stream.write(bytes, size);
+  }
+
+  writeArray(m_stream, m_orderIds);
+  writeArray(m_stream, m_changedIndices);
+  writeArray(m_stream, m_changedEnergies);
+
+  endRecord(population, order);
+}
+
+void DeltaWriter::endRecord(const Population &population,
+                            const SlotVector &order) {
+  m_stream.flush();
+  if (!m_stream) {
+    throw std::runtime_error("cannot write " + m_path);
+  }
+
+  if (m_energy.size() < population.capacity()) {
+    m_energy.resize(population.capacity());
+  }
+  for (unsigned k = 0; k < order.size(); k++) {
+    m_energy[order[k]] = population.getEnergy(order[k]);
+  }
+
+  for (unsigned n = 0; n < m_birthSlots.size(); n++) {
+    m_birthIndex[m_birthSlots[n]] = -1;
+  }
+  m_births.clear();
+  m_birthSlots.clear();
+  m_birthDied.clear();
+  m_deaths.clear();
+}
+
+DeltaReader::DeltaReader(const std::string &path) :
+  m_stream(path, std::ios::binary), m_path(path), m_seed(0),
+  m_generation(0), m_valid(false) {
+  if (!m_stream) {
+    throw std::runtime_error("cannot open " + path);
+  }
+
+  DeltaStreamHeader header;
+  read(&header, sizeof(header));
+  if (memcmp(header.magic, deltaMagic, sizeof(deltaMagic)) != 0 ||
+      header.version != deltaVersion) {
+    throw std::runtime_error(path + " is not a delta stream");
+  }
+}
+
+void DeltaReader::read(void *data, uint64_t size) {
+  if (!m_stream.read(static_cast<char *>(data), size)) {
+    throw std::runtime_error(m_path + " is truncated");
+  }
+}
+
+unsigned DeltaReader::slotOf(uint64_t id) const {
+  std::unordered_map<uint64_t, unsigned>::const_iterator it = m_slots.find(id);
+  if (it == m_slots.end()) {
+    throw std::runtime_error(m_path + " refers to an unknown agent");
+  }
+  return it->second;
+}
+
+bool DeltaReader::next(void) {
+  DeltaRecordHeader record;
+  m_stream.read(reinterpret_cast<char *>(&record), sizeof(record));
+  if (m_stream.gcount() == 0 && m_stream.eof()) {
+    return false;
+  }
+  if (!m_stream) {
+    throw std::runtime_error(m_path + " is truncated");
+  }
+
+  m_births.clear();
+  m_deaths.clear();
+
+  if (record.type == DELTA_RECORD_FULL) {
+    readFull();
+  }
+
+  else if (record.type == DELTA_RECORD_DELTA && m_valid) {
+    readDelta();
+  }
+
+  else {
+    throw std::runtime_error(m_path + " has an unexpected record");
+  }
+
+  m_generation = record.generation;
+  return true;
+}
+
+void DeltaReader::readFull(void) {
+  DeltaFullHeader full;
+  read(&full, sizeof(full));
+
+  m_seed = full.seed;
+  m_parameters.sizePopulation = full.sizePopulation;
+  m_parameters.sizeChromosome = full.sizeChromosome;
+  m_parameters.muNumMutations = full.muNumMutations;
+  m_parameters.muNumCrossovers = full.muNumCrossovers;
+  m_parameters.lambdaEnergy = full.lambdaEnergy;
+  m_parameters.sigmaPredation = full.sigmaPredation;
+  m_parameters.lambdaPredation = full.lambdaPredation;
+  m_parameters.lambdaScoreFeed = full.lambdaScoreFeed;
+  m_parameters.lambdaEntropyFeed = full.lambdaEntropyFeed;
+  m_parameters.muEnergyStarve = full.muEnergyStarve;
+  m_parameters.muMating = full.muMating;
+
+  unsigned numAgents = full.numAgents;
+  m_population = Population(full.sizeChromosome);
+  m_population.reserve(numAgents);
+  m_ids.assign(numAgents, 0);
+  m_order.resize(numAgents);
+  m_slots.clear();
+
+  for (unsigned k = 0; k < numAgents; k++) {
+    m_order[k] = m_population.allocate();
+  }
+
+  std::vector<uint64_t> ids(numAgents);
+  std::vector<double> energy(numAgents);
+  read(ids.data(), numAgents * sizeof(uint64_t));
+  read(energy.data(), numAgents * sizeof(double));
+  for (unsigned k = 0; k < numAgents; k++) {
+    unsigned slot = m_order[k];
+    read(m_population.chromosome(slot), full.sizeChromosome);
+    m_population.countOnes(slot);
+    m_population.setEnergy(slot, energy[k]);
+    m_ids[slot] = ids[k];
+    m_slots[ids[k]] = slot;
+  }
+
+  m_valid = true;
+}
+
+void DeltaReader::readDelta(void) {
+  DeltaChangeHeader change;
+  read(&change, sizeof(change));
+  unsigned size = m_population.sizeChromosome();
+
+  m_deaths.resize(change.numDeaths);
+  read(m_deaths.data(), change.numDeaths * sizeof(uint64_t));
+
+  /* Births come first, since algae can be born and die in one generation */
+  m_births.resize(change.numBirths);
+  for (unsigned n = 0; n < change.numBirths; n++) {
+    double energy;
+    read(&m_births[n], sizeof(DeltaBirth));
+    read(&energy, sizeof(energy));
+
+    unsigned slot = m_population.allocate();
+    read(m_population.chromosome(slot), size);
+    m_population.countOnes(slot);
+    m_population.setEnergy(slot, energy);
+
+    if (slot >= m_ids.size()) {
+      m_ids.resize(m_population.capacity());
+    }
+    m_ids[slot] = m_births[n].id;
+    m_slots[m_births[n].id] = slot;
+  }
+
+  for (unsigned n = 0; n < m_deaths.size(); n++) {
+    m_population.release(slotOf(m_deaths[n]));
+    m_slots.erase(m_deaths[n]);
+  }
+
+  std::vector<uint64_t> ids(change.numAgents);
+  read(ids.data(), change.numAgents * sizeof(uint64_t));
+  m_order.resize(change.numAgents);
+  for (unsigned k = 0; k < change.numAgents; k++) {
+    m_order[k] = slotOf(ids[k]);
+  }
+
+  std::vector<uint32_t> indices(change.numChanged);
+  std::vector<double> energies(change.numChanged);
+  read(indices.data(), change.numChanged * sizeof(uint32_t));
+  read(energies.data(), change.numChanged * sizeof(double));
+  for (unsigned n = 0; n < change.numChanged; n++) {
+    if (indices[n] >= m_order.size()) {
+      throw std::runtime_error(m_path + " refers to an unknown agent");
+    }
+    m_population.setEnergy(m_order[indices[n]], energies[n]);
+  }
+}
+
+bool DeltaReader::seek(uint64_t generation) {
+  m_stream.clear();
+  m_stream.seekg(sizeof(DeltaStreamHeader));
+
+  /* Find the last FULL record at or before `generation` */
+  std::streamoff start = -1;
+  while (true) {
+    std::streamoff offset = m_stream.tellg();
+    DeltaRecordHeader record;
+    if (!m_stream.read(reinterpret_cast<char *>(&record), sizeof(record)) ||
+        record.generation > generation) {
+      break;
+    }
+
+    if (record.type == DELTA_RECORD_FULL) {
+      start = offset;
+    }
+    m_stream.seekg(record.size, std::ios::cur);
+  }
+
+  m_stream.clear();
+  if (start < 0) {
+    return false;
+  }
+
+  m_stream.seekg(start);
+  while (next()) {
+    if (m_generation == generation) {
+      return true;
+    }
+
+    /* Peek at the next generation */
+    DeltaRecordHeader record;
+    std::streamoff offset = m_stream.tellg();
+    if (!m_stream.read(reinterpret_cast<char *>(&record), sizeof(record)) ||
+        record.generation > generation) {
+      m_stream.clear();
+      m_stream.seekg(offset);
+      return false;
+    }
+    m_stream.seekg(offset);
+  }
+
+  return false;
+}
+
+const Parameters &DeltaReader::getParameters(void) const {
+  return m_parameters;
+}
+
+uint64_t DeltaReader::getSeed(void) const {
+  return m_seed;
+}
+
+uint64_t DeltaReader::getGeneration(void) const {
+  return m_generation;
+}
+
+const Population &DeltaReader::getPopulation(void) const {
+  return m_population;
+}
+
+const SlotVector &DeltaReader::getOrder(void) const {
+  return m_order;
+}
+
+uint64_t DeltaReader::getId(unsigned slot) const {
+  return m_ids[slot];
+}
+
+const std::vector<DeltaBirth> &DeltaReader::getBirths(void) const {
+  return m_births;
+}
+
+const std::vector<uint64_t> &DeltaReader::getDeaths(void) const {
+  return m_deaths;
+}
+
+void DeltaReader::saveCheckpoint(const std::string &path,
+                                 bool compress) const {
+  writeCheckpoint(path, m_parameters, m_seed, m_generation, m_population,
+                  m_order, compress);
+}
@@ -0,0 +1,190 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "parameters.h"
+#include "population.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Delta checkpoints                                                          *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief A delta stream records the history of an ecosystem one generation
+ *  at a time.  Every agent gets a unique, deterministic id when it is born,
+ *  and every record is one of
+ *
+ *    Record    Contents
+ *
+ *    FULL      The whole state: parameters, seed, and the id, energy and
+ *              chromosome of every agent in pairing order
+ *    DELTA     What happened during one generation: the ids of the agents
+ *              that died, the id, parents, energy and chromosome of the
+ *              agents that were born (algae have no parents), the new
+ *              pairing order as ids, and the energies that changed
+ *
+ *  The stream starts with a FULL record and repeats one periodically, so a
+ *  generation can be rebuilt without reading the stream from the start.
+ *  Every generation has a DELTA record, and a periodic FULL record follows
+ *  the DELTA record of its generation, so the births and deaths of every
+ *  generation are in the stream.
+ *  Surviving chromosomes, which make up most of the state, are never
+ *  written again.  All numbers are little-endian, and every record starts
+ *  with its type, generation and size so a reader can skip it.
+ */
+typedef enum {
+  DELTA_RECORD_FULL = 1,
+  DELTA_RECORD_DELTA = 2
+} DeltaRecordType;
+
+/* Parent id of the agents that have none */
+static const uint64_t noParent = UINT64_MAX;
+
+/* Current version of the stream format */
+static const uint32_t deltaVersion = 1;
+
+/* An agent born during a generation */
+typedef struct {
+  uint64_t id;
+  uint64_t father;
+  uint64_t mother;
+} DeltaBirth;
+
+/**
+ * @brief Writes a delta stream.  The ecosystem reports births and deaths as
+ *  they happen and calls `finish` at the end of every generation.
+ */
+class DeltaWriter {
+ private:
+  std::ofstream m_stream;
+  std::string m_path;
+  unsigned m_fullInterval;    //! Generations between two FULL records
+
+  /* Events of the current generation */
+  std::vector<DeltaBirth> m_births;
+  std::vector<unsigned> m_birthSlots;
+  std::vector<char> m_birthDied;      //! Born and died in this generation
+  std::vector<uint64_t> m_deaths;
+  std::vector<int> m_birthIndex;      //! Per slot, index of its birth or -1
+
+  std::vector<double> m_energy;       //! Per slot, last recorded energy
+
+  /* Scratch space of `finish` */
+  std::vector<uint64_t> m_orderIds;
+  std::vector<uint32_t> m_changedIndices;
+  std::vector<double> m_changedEnergies;
+  std::vector<char> m_bytes;
+
+  void finishFull(const Parameters &params, uint64_t seed,
+                  uint64_t generation, const Population &population,
+                  const SlotVector &order, const std::vector<uint64_t> &ids);
+  void finishDelta(uint64_t generation, const Population &population,
+                   const SlotVector &order, const std::vector<uint64_t> &ids);
+  void endRecord(const Population &population, const SlotVector &order);
+
+ public:
+
+  /**
+   * @brief Creates (or truncates) the stream at `path` and writes a FULL
+   *  record of the current state
+   *
+   * @param fullInterval a FULL record is also written whenever the
+   *  generation is a multiple of this
+   * @param ids id of the agent in each slot
+   *
+   * @note This function throws an exception when the file cannot be written.
+   */
+  DeltaWriter(const std::string &path, unsigned fullInterval,
+              const Parameters &params, uint64_t seed, uint64_t generation,
+              const Population &population, const SlotVector &order,
+              const std::vector<uint64_t> &ids);
+
+  /* An agent was born into `slot` */
+  void born(unsigned slot, const DeltaBirth &birth);
+
+  /* The agent `id` in `slot` died */
+  void died(unsigned slot, uint64_t id);
+
+  /**
+   * @brief Writes the record of the generation that just ended
+   *
+   * @note This function throws an exception when the file cannot be written.
+   */
+  void finish(const Parameters &params, uint64_t seed, uint64_t generation,
+              const Population &population, const SlotVector &order,
+              const std::vector<uint64_t> &ids);
+};
+
+/**
+ * @brief Rebuilds the states recorded in a delta stream, one record at a
+ *  time
+ */
+class DeltaReader {
+ private:
+  std::ifstream m_stream;
+  std::string m_path;
+
+  Parameters m_parameters;
+  uint64_t m_seed;
+  uint64_t m_generation;
+  bool m_valid;             //! Whether a FULL record has been applied
+  Population m_population;
+  SlotVector m_order;
+  std::vector<uint64_t> m_ids;                    //! Id of each slot
+  std::unordered_map<uint64_t, unsigned> m_slots; //! Slot of each id
+
+  /* Events of the last record applied */
+  std::vector<DeltaBirth> m_births;
+  std::vector<uint64_t> m_deaths;
+
+  void read(void *data, uint64_t size);
+  void readFull(void);
+  void readDelta(void);
+  unsigned slotOf(uint64_t id) const;
+
+ public:
+
+  /**
+   * @note This function throws an exception when the file cannot be read.
+   */
+  DeltaReader(const std::string &path);
+
+  /**
+   * @brief Applies the next record
+   *
+   * @note This function throws an exception when the stream is corrupt.
+   *
+   * @return false at the end of the stream
+   */
+  bool next(void);
+
+  /**
+   * @brief Rebuilds `generation` from the last FULL record before it
+   *
+   * @return false if the stream does not contain `generation`
+   */
+  bool seek(uint64_t generation);
+
+  /* State after the last record applied */
+  const Parameters &getParameters(void) const;
+  uint64_t getSeed(void) const;
+  uint64_t getGeneration(void) const;
+  const Population &getPopulation(void) const;
+  const SlotVector &getOrder(void) const;
+  uint64_t getId(unsigned slot) const;
+
+  /* Births and deaths of the last record.  A FULL record has neither */
+  const std::vector<DeltaBirth> &getBirths(void) const;
+  const std::vector<uint64_t> &getDeaths(void) const;
+
+  /* Writes the current state as a flat checkpoint (see `checkpoint.h`) */
+  void saveCheckpoint(const std::string &path, bool compress = false) const;
+};
+
+
+#endif /* end of include guard: DELTA_H */
@@ -1,99 +1,113 @@
-#include <cassert>
 #include <algorithm>
-#include <random>
+#include <cassert>
+#include <numeric>
+#include <stdexcept>
 #include "ecosystem.h"
+#include "kernels.h"
 
 
 /* -------------------------------------------------------------------------- *
  * Helper and thread functions                                                *
  * -------------------------------------------------------------------------- */
 
-/* Simplifies later declarations */
-typedef std::vector<std::unique_ptr<Agent>> AgentVector;
-
-
 /**
- * @brief Iterates through the vector of agents and sorts the agents based on
+ * @brief Iterates through the pairing order and sorts the slots based on
  *  whether the agent is still alive or dead.  Dead agents are pushed to the
- *  end of the vector.  Then the dead agents are erased from the vector.
+ *  end of the order.  Then the dead agents are erased from the order and
+ *  their slots are released to the population's free list.
  *
  * @note I haven't timed it myself, but I expect this is much faster than
  *  repeatedly calling `vector::erase`, since this will result in some elements
  *  being repeatedly shuffled, but in this function each item is moved at most
  *  one times.  The complexity of this function is O(n).
  *
- * @param agents
+ * @param population
+ * @param order
  *
  * @return number of dead agents
  */
-unsigned removeDeadAgents(AgentVector &agents) {
-  unsigned numDead = 0;
-  AgentVector::iterator fIt = agents.begin();
-  AgentVector::iterator bIt = agents.end() - 1;
+unsigned removeDeadAgents(Population &population, SlotVector &order) {
+  SlotVector::iterator fIt = order.begin();
+  SlotVector::iterator bIt = order.end();
 
-  while (bIt > fIt) {
+  while (true) {
 
     /* Find first dead agent */
-    while ((**fIt).getEnergy() > 0 && bIt > fIt) {
+    while (fIt < bIt && population.getEnergy(*fIt) > 0) {
       fIt++;
     }
 
     /* Find last alive agent */
-    while ((**bIt).getEnergy() <= 0 && bIt > fIt) {
+    while (fIt < bIt && population.getEnergy(*(bIt - 1)) <= 0) {
       bIt--;
     }
 
-    /* Swap */
-    std::unique_ptr<Agent> temp = std::move(*fIt);
-    *fIt = std::move(*bIt);
-    *bIt = std::move(temp);
-    numDead += 1;
+    if (fIt == bIt) {
+      break;
+    }
 
-    assert(!temp);
+    /* Swap */
+    std::swap(*fIt, *(bIt - 1));
+    fIt++;
+    bIt--;
   }
 
-  assert(bIt == fIt);
-  assert((**fIt).getEnergy() <= 0);
+  /* Release and erase */
+  for (SlotVector::iterator it = fIt; it != order.end(); it++) {
+    population.release(*it);
+  }
 
-  /* Erase.  No memory leak since we are using unique_ptr */
-  agents.erase(fIt, agents.end());
+  unsigned numDead = order.end() - fIt;
+  order.erase(fIt, order.end());
 
   return numDead;
 }
 
 /**
- * @brief Executed by a thread during the feeding round
+ * @brief Executed by a thread during the feeding round.  Returns the number
+ *  of deaths, of which `numKills` were eaten.
  */
-unsigned threadFeeding(const Parameters &params, AgentVector &agents,
-                       const AgentVector::iterator &start,
-                       const AgentVector::iterator &end) {
+unsigned threadFeeding(const Parameters &params, Population &population,
+                       const SlotVector::const_iterator &start,
+                       const SlotVector::const_iterator &end,
+                       Random &random, unsigned &numKills) {
   unsigned numDead = 0;
 
-  /* Feeding round */
-  AgentVector::iterator a;
-  AgentVector::iterator b;
-  PredationOutcome outcome;
-
-  for (a = start; a < end; a += 2) {
-    b = a + 1;
-    outcome = predation(**a, **b, params);
-    if (outcome == PREDATION_FIRST_SURVIVES) {
-      (**b).setEnergy(0);
-      feed(**a, **b, params);
-      numDead += 1;
+  /* Feeding round, a block of pairs at a time: the outcomes of the whole
+   * block are drawn in one batch, then applied */
+  unsigned numPairs = (end - start) / 2;
+  PredationOutcome outcomes[pairBlock];
+
+  for (unsigned first = 0; first < numPairs; first += pairBlock) {
+    unsigned count = std::min(pairBlock, numPairs - first);
+    const unsigned *block = &start[2 * first];
+    predation(population, block, count, params, random, outcomes);
+
+    for (unsigned k = 0; k < count; k++) {
+      unsigned a = block[2 * k];
+      unsigned b = block[2 * k + 1];
+      if (outcomes[k] == PREDATION_FIRST_SURVIVES) {
+        population.setEnergy(b, 0);
+        feed(population, a, b, params);
+        numDead += 1;
+      }
+
+      if (outcomes[k] == PREDATION_SECOND_SURVIVES) {
+        population.setEnergy(a, 0);
+        feed(population, b, a, params);
+        numDead += 1;
+      }
     }
+  }
 
-    if (outcome == PREDATION_SECOND_SURVIVES) {
-      (**a).setEnergy(0);
-      feed(**b, **a, params);
-      numDead += 1;
+  /* Starvation round.  Agents eaten above are already dead */
+  numKills = numDead;
+  for (SlotVector::const_iterator a = start; a != end; a++) {
+    if (population.getEnergy(*a) <= 0) {
+      continue;
     }
-  }
 
-  /* Starvation round */
-  for (a = start; a != end; a++) {
-    if (starve(**a, params)) {
-      (**a).setEnergy(0);
+    if (starve(population, *a, params, random)) {
       numDead += 1;
     }
   }
@@ -102,91 +116,454 @@ unsigned threadFeeding(const Parameters &params, AgentVector &agents,
 }
 
 /**
- * @brief Executed by a thread during the mating round
+ * @brief Executed by a thread during the first pass of the mating round:
+ *  decides the courtship of every pair of the range in one batch.  Bit `k`
+ *  of `mask` is set when pair `k` mates.
+ *
+ * @return number of pairs that mate
  */
-unsigned threadMating(const Parameters &params, AgentVector &agents,
-                      const AgentVector::iterator &start,
-                      const AgentVector::iterator &end,
-                      AgentVector &children) {
-  unsigned numBorn = 0;
+unsigned threadCourtship(const Parameters &params,
+                         const Population &population,
+                         const SlotVector::const_iterator &start,
+                         const SlotVector::const_iterator &end,
+                         uint64_t *mask, Random &random) {
+  unsigned numPairs = (end - start) / 2;
+  if (numPairs == 0) {
+    return 0;
+  }
 
-  /* Mating round */
-  AgentVector::iterator a;
-  AgentVector::iterator b;
-
-  for (a = start; a < end; a += 2) {
-    b = a + 1;
-    if (mate(**a, **b, params)) {
-      Agent child = crossover(**a, **b, params);
-      child.setEnergy(params.lambdaEnergy);
-      mutate(child, params);
-
-      /* Store a copy on the heap */
-      Agent *c = new Agent(child);
-      std::unique_ptr<Agent> ptr(c);
-      children.push_back(std::move(ptr));
-      numBorn += 1;
+  mate(population, &start[0], numPairs, params, random, mask);
+  return popcountWords(mask, (numPairs + 63) / 64);
+}
+
+/**
+ * @brief Executed by a thread during the second pass of the mating round.
+ *  The `n`th pair of the range that mates (see `threadCourtship`) writes its
+ *  child into the claimed slot `firstBirth + n` of the population, and the
+ *  slot into `children[n]`.  The entropy of every agent in the range, and
+ *  of every child, is added to `entropy`.
+ */
+void threadBirths(const Parameters &params, Population &population,
+                  const SlotVector::const_iterator &start,
+                  const SlotVector::const_iterator &end,
+                  const uint64_t *mask, unsigned firstBirth,
+                  unsigned *children, RunningStatistics &entropy,
+                  Random &random) {
+  unsigned numPairs = (end - start) / 2;
+  unsigned n = 0;
+
+  for (unsigned k = 0; k < numPairs; k++) {
+    unsigned a = start[2 * k];
+    unsigned b = start[2 * k + 1];
+    entropy.add(population.getEntropy(a));
+    entropy.add(population.getEntropy(b));
+
+    if ((mask[k / 64] >> (k % 64)) & 1) {
+      unsigned child = population.claim(firstBirth + n);
+      crossover(population, a, b, child, params, random);
+      mutate(population, child, params, random);
+      entropy.add(population.getEntropy(child));
+      children[n++] = child;
     }
   }
 
-  return numBorn;
+  /* Agent left without a partner */
+  if ((end - start) % 2 == 1) {
+    entropy.add(population.getEntropy(*(end - 1)));
+  }
+}
+
+/**
+ * @brief Number of agents in one unit of parallel work.  It is even, so
+ *  chunks never split a pair, and it does not depend on the number of
+ *  threads, so neither do the random streams or the results.
+ */
+static const unsigned agentsPerChunk = 1024;
+
+/* Chunks of the mating round own whole words of the courtship mask */
+static_assert(agentsPerChunk % 128 == 0, "chunks must not share mask words");
+
+/* Phases of a generation that draw random numbers */
+typedef enum {
+  PHASE_SHUFFLE,
+  PHASE_FEEDING,
+  PHASE_MATING,
+  PHASE_MIGRATION,
+  PHASE_BIRTH
+} GenerationPhase;
+
+/**
+ * @brief Index of the random stream used by one chunk of one phase of a
+ *  generation
+ */
+static uint64_t chunkStream(uint64_t generation, GenerationPhase phase,
+                            unsigned chunk) {
+  return (generation << 32) | ((uint64_t) phase << 28) | chunk;
+}
+
+static SlotVector::const_iterator chunkBegin(const SlotVector &order,
+    unsigned chunk) {
+  return order.begin() + chunk * agentsPerChunk;
+}
+
+static SlotVector::const_iterator chunkEnd(const SlotVector &order,
+    unsigned chunk) {
+  unsigned end = std::min<unsigned>((chunk + 1) * agentsPerChunk,
+                                    order.size());
+  return order.begin() + end;
 }
 
 /* -------------------------------------------------------------------------- *
  * Ecosystem class                                                            *
  * -------------------------------------------------------------------------- */
 
-Ecosystem::Ecosystem() { }
+Ecosystem::Ecosystem() : m_seed(0), m_generation(0),
+  m_pairing(new ShufflePairing()), m_checkpointInterval(0), m_nextId(0) { }
 
-Ecosystem::Ecosystem(const Parameters &params) {
+Ecosystem::Ecosystem(const Parameters &params, uint64_t seed) :
+  m_population(params.sizeChromosome), m_seed(seed), m_generation(0),
+  m_pairing(new ShufflePairing()), m_checkpointInterval(0), m_nextId(0) {
   m_parameters = params;
 
   /* Allocate agents */
+  m_population.reserve(m_parameters.sizePopulation);
   for (unsigned n = 0; n < m_parameters.sizePopulation; n++) {
-    Agent *a = new Agent(m_parameters.sizeChromosome, 0x00,
-                         m_parameters.lambdaEnergy);
-    std::unique_ptr<Agent> agentPtr(a);
-    m_agents.push_back(std::move(agentPtr));
+    unsigned slot = m_population.allocate();
+    m_population.setEnergy(slot, m_parameters.lambdaEnergy);
+    m_order.push_back(slot);
+  }
+
+  collectEntropy();
+  assignIds();
+}
+
+void Ecosystem::saveCheckpoint(const std::string &path,
+                               bool compress) const {
+  writeCheckpoint(path, m_parameters, m_seed, m_generation, m_population,
+                  m_order, compress);
+}
+
+void Ecosystem::loadCheckpoint(const std::string &path) {
+  m_population = mapCheckpoint(path, m_parameters, m_seed, m_generation);
+
+  /* Agent `k` of the checkpoint is in slot `k` */
+  m_order.resize(m_population.size());
+  for (unsigned k = 0; k < m_order.size(); k++) {
+    m_order[k] = k;
+  }
+
+  m_survival.clear();
+  collectEntropy();
+  assignIds();
+}
+
+void Ecosystem::setCheckpoint(const std::string &path, unsigned interval,
+                              bool compress) {
+  m_checkpointWriter.reset();
+  m_checkpointInterval = interval;
+  if (interval > 0) {
+    m_checkpointWriter.reset(new CheckpointWriter(path, compress));
+  }
+}
+
+void Ecosystem::flushCheckpoints(void) {
+  if (m_checkpointWriter) {
+    m_checkpointWriter->wait();
+  }
+}
+
+void Ecosystem::setDeltaRecording(const std::string &path,
+                                  unsigned fullInterval) {
+  m_deltaWriter.reset();
+  if (fullInterval > 0) {
+    m_deltaWriter.reset(new DeltaWriter(path, fullInterval, m_parameters,
+                                        m_seed, m_generation, m_population,
+                                        m_order, m_ids));
+  }
+}
+
+void Ecosystem::emigrate(unsigned count, MigrantBatch &batch,
+                         unsigned stream) {
+  count = std::min<unsigned>(count, m_order.size());
+
+  /* Partial Fisher-Yates shuffle that moves the emigrants to the back */
+  m_random.seed(m_seed, chunkStream(m_generation, PHASE_MIGRATION, stream));
+  unsigned numAgents = m_order.size();
+  for (unsigned n = 0; n < count; n++) {
+    unsigned last = numAgents - 1 - n;
+    unsigned k = gsl_rng_uniform_int(m_random.get(), last + 1);
+    std::swap(m_order[k], m_order[last]);
+
+    unsigned slot = m_order[last];
+    batch.append(m_population, slot);
+    if (m_deltaWriter) {
+      m_deltaWriter->died(slot, m_ids[slot]);
+    }
+    m_population.release(slot);
+  }
+  m_order.resize(numAgents - count);
+
+  collectEntropy();
+}
+
+void Ecosystem::immigrate(const MigrantBatch &batch) {
+  for (unsigned k = 0; k < batch.size(); k++) {
+    unsigned slot = batch.insert(m_population, k);
+    m_order.push_back(slot);
+    registerBirth(slot, noParent, noParent);
+  }
+
+  collectEntropy();
+}
+
+void Ecosystem::setProfile(const std::string &path, ProfileFormat format) {
+  if (!instrumentationEnabled) {
+    throw std::runtime_error("profiles need a build configured with "
+                             "--enable-instrumentation");
+  }
+
+  m_profileWriter.reset(new ProfileWriter(path, format));
+}
+
+const GenerationProfile &Ecosystem::getProfile(void) const {
+  return m_profiler.profile();
+}
+
+void Ecosystem::setPairingEngine(std::unique_ptr<PairingEngine> engine) {
+  if (!engine) {
+    throw std::invalid_argument("missing pairing engine");
+  }
+  m_pairing = std::move(engine);
+}
+
+const PairingEngine &Ecosystem::getPairingEngine(void) const {
+  return *m_pairing;
+}
+
+unsigned Ecosystem::size(void) const {
+  return m_order.size();
+}
+
+const Parameters &Ecosystem::getParameters(void) const {
+  return m_parameters;
+}
+
+uint64_t Ecosystem::getSeed(void) const {
+  return m_seed;
+}
+
+uint64_t Ecosystem::getGeneration(void) const {
+  return m_generation;
+}
+
+double Ecosystem::meanEntropy(void) const {
+  return m_entropy.mean();
+}
+
+double Ecosystem::stdevEntropy(void) const {
+  return m_entropy.stdev();
+}
+
+double Ecosystem::meanSurvivalFraction(void) const {
+  return m_survival.mean();
+}
+
+void Ecosystem::collectEntropy(void) {
+  m_entropy.clear();
+  for (unsigned k = 0; k < m_order.size(); k++) {
+    m_entropy.add(m_population.getEntropy(m_order[k]));
+  }
+}
+
+void Ecosystem::assignIds(void) {
+  m_ids.assign(m_population.capacity(), 0);
+  for (unsigned k = 0; k < m_order.size(); k++) {
+    m_ids[m_order[k]] = k;
+  }
+  m_nextId = m_order.size();
+}
+
+void Ecosystem::registerBirth(unsigned slot, uint64_t father,
+                              uint64_t mother) {
+  if (slot >= m_ids.size()) {
+    m_ids.resize(m_population.capacity());
+  }
+
+  DeltaBirth birth = {m_nextId++, father, mother};
+  m_ids[slot] = birth.id;
+  if (m_deltaWriter) {
+    m_deltaWriter->born(slot, birth);
   }
 }
 
 void Ecosystem::runOnceSerial(void) {
+  runOnceThread(1);
+}
+
+void Ecosystem::runOnceThread(unsigned numThreads) {
+  if (!m_pool || m_pool->size() != numThreads) {
+    m_pool.reset(new ThreadPool(numThreads));
+    m_streams.resize(numThreads);
+  }
+
+  PROFILE(m_profiler.begin(m_generation + 1));
 
   /* Insert simple (algae) organisms until the population is full */
-  for (unsigned n = m_agents.size(); n < m_parameters.sizePopulation; n++) {
-    Agent *a = new Agent(m_parameters.sizeChromosome, 0x00,
-                         m_parameters.lambdaEnergy);
-    std::unique_ptr<Agent> agentPtr(a);
-    m_agents.push_back(std::move(agentPtr));
+  for (unsigned n = m_order.size(); n < m_parameters.sizePopulation; n++) {
+    unsigned slot = m_population.allocate();
+    m_population.setEnergy(slot, m_parameters.lambdaEnergy);
+    m_order.push_back(slot);
+    registerBirth(slot, noParent, noParent);
+  }
+  PROFILE(m_profiler.phase(TIMER_ALGAE));
+
+  /* Feeding round.  Only the slot indices are paired; the chromosomes stay
+   * where they are */
+  m_pairing->arrange(m_population, m_order, m_seed,
+                     chunkStream(m_generation, PHASE_SHUFFLE, 0), *m_pool);
+  PROFILE(m_profiler.phase(TIMER_FEEDING_PAIRING));
+
+  unsigned numAgents = m_order.size();
+  unsigned numChunks = (numAgents + agentsPerChunk - 1) / agentsPerChunk;
+  FeedingDeaths deaths = {0, 0};
+  m_pool->parallelReduce(numChunks, m_chunkDeaths, deaths,
+                         [&](unsigned chunk, unsigned thread,
+  FeedingDeaths &chunkDeaths) {
+    Random &random = m_streams[thread];
+    random.seed(m_seed, chunkStream(m_generation, PHASE_FEEDING, chunk));
+    chunkDeaths.numDead = threadFeeding(m_parameters, m_population,
+                                        chunkBegin(m_order, chunk),
+                                        chunkEnd(m_order, chunk), random,
+                                        chunkDeaths.numKills);
+  }, [](FeedingDeaths &result, const FeedingDeaths &chunkDeaths) {
+    result.numDead += chunkDeaths.numDead;
+    result.numKills += chunkDeaths.numKills;
+  });
+  PROFILE(m_profiler.phase(TIMER_FEEDING));
+
+  if (m_deltaWriter) {
+    for (unsigned k = 0; k < numAgents; k++) {
+      unsigned slot = m_order[k];
+      if (m_population.getEnergy(slot) <= 0) {
+        m_deltaWriter->died(slot, m_ids[slot]);
+      }
+    }
   }
 
-  /* Feeding round */
-  std::random_device rd;
-  std::mt19937 g(rd());
-  std::shuffle(m_agents.begin(), m_agents.end(), g);
+  unsigned numDead = removeDeadAgents(m_population, m_order);
+  assert(numDead == deaths.numDead);
+  if (numAgents > 0) {
+    m_survival.add(1.0 - (double) numDead / numAgents);
+  }
 
-  int deltaPopulation = - threadFeeding(m_parameters, m_agents,
-                                        m_agents.begin(), m_agents.end());
-  removeDeadAgents(m_agents);
+  PROFILE(m_profiler.phase(TIMER_REMOVE_DEAD));
+  PROFILE(m_profiler.count(COUNTER_AGENTS, numAgents));
+  PROFILE(m_profiler.count(COUNTER_ENCOUNTERS, numAgents / 2));
+  PROFILE(m_profiler.count(COUNTER_KILLS, deaths.numKills));
+  PROFILE(m_profiler.count(COUNTER_STARVED, numDead - deaths.numKills));
 
   /* Mating round */
-  std::shuffle(m_agents.begin(), m_agents.end(), g);
-  AgentVector children;
+  m_pairing->arrange(m_population, m_order, m_seed,
+                     chunkStream(m_generation, PHASE_SHUFFLE, 1), *m_pool);
+  PROFILE(m_profiler.phase(TIMER_MATING_PAIRING));
+
+  /* First pass: every chunk decides its courtships and counts its births.
+   * Chunks own whole words of the mask */
+  unsigned numMatingAgents = m_order.size();
+  unsigned numPairs = numMatingAgents / 2;
+  numChunks = (numMatingAgents + agentsPerChunk - 1) / agentsPerChunk;
+  m_matingMask.assign((numPairs + 63) / 64, 0);
+  m_chunkBirths.assign(numChunks + 1, 0);
+  m_pool->parallelFor(numChunks, [&](unsigned chunk, unsigned thread) {
+    Random &random = m_streams[thread];
+    uint64_t *mask = m_matingMask.data() + chunk * agentsPerChunk / 128;
+    random.seed(m_seed, chunkStream(m_generation, PHASE_MATING, chunk));
+    m_chunkBirths[chunk + 1] = threadCourtship(m_parameters, m_population,
+                               chunkBegin(m_order, chunk),
+                               chunkEnd(m_order, chunk), mask, random);
+  });
+
+  /* Chunk `c` claims the slots and order positions from
+   * `m_chunkBirths[c]` on, so newborns join the population in pair order
+   * with no merge step, and the slab does not grow during the round */
+  std::partial_sum(m_chunkBirths.begin(), m_chunkBirths.end(),
+                   m_chunkBirths.begin());
+  unsigned numBorn = m_chunkBirths[numChunks];
+  m_population.openClaims(numBorn);
+  m_order.resize(numMatingAgents + numBorn);
+  m_ids.resize(m_population.capacity());
+
+  /* Second pass: children are written in place, and the chunks of the
+   * parents end before them.  The entropy statistics are reduced per chunk
+   * along the way, and merged in chunk order so they do not depend on the
+   * number of threads */
+  m_entropy.clear();
+  m_pool->parallelReduce(numChunks, m_chunkEntropy, m_entropy,
+                         [&](unsigned chunk, unsigned thread,
+  RunningStatistics &entropy) {
+    Random &random = m_streams[thread];
+    const uint64_t *mask = m_matingMask.data() + chunk * agentsPerChunk / 128;
+    unsigned firstBirth = m_chunkBirths[chunk];
+    unsigned *children = m_order.data() + numMatingAgents + firstBirth;
+    unsigned end = std::min((chunk + 1) * agentsPerChunk, numMatingAgents);
+    random.seed(m_seed, chunkStream(m_generation, PHASE_BIRTH, chunk));
+    threadBirths(m_parameters, m_population, chunkBegin(m_order, chunk),
+                 m_order.begin() + end, mask, firstBirth, children, entropy,
+                 random);
+
+    for (unsigned n = firstBirth; n < m_chunkBirths[chunk + 1]; n++) {
+      m_ids[m_order[numMatingAgents + n]] = m_nextId + n;
+    }
+  }, [](RunningStatistics &result, const RunningStatistics &entropy) {
+    result.merge(entropy);
+  });
+  PROFILE(m_profiler.phase(TIMER_MATING));
+
+  m_population.closeClaims(numBorn);
+
+  if (m_deltaWriter) {
+    unsigned n = numMatingAgents;
+    for (unsigned k = 0; k < numPairs; k++) {
+      if ((m_matingMask[k / 64] >> (k % 64)) & 1) {
+        unsigned child = m_order[n++];
+        DeltaBirth birth;
+        birth.id = m_ids[child];
+        birth.father = m_ids[m_order[2 * k]];
+        birth.mother = m_ids[m_order[2 * k + 1]];
+        m_deltaWriter->born(child, birth);
+      }
+    }
+  }
+  m_nextId += numBorn;
 
-  deltaPopulation = threadMating(m_parameters, m_agents,
-                                 m_agents.begin(), m_agents.end(), children);
+  PROFILE(m_profiler.phase(TIMER_MERGE));
+  PROFILE(m_profiler.count(COUNTER_MATINGS, numPairs));
+  PROFILE(m_profiler.count(COUNTER_BIRTHS, numBorn));
+  PROFILE(m_profiler.finish());
 
-  /* Can't use vector::insert since this uses a copy instead of move */
-  for (unsigned i = 0; i < children.size(); i++) {
-    m_agents.push_back(std::move(children[i]));
-  }
-}
+  m_generation += 1;
 
-void Ecosystem::run(unsigned numIterations) {
-  for (unsigned i = 0; i < numIterations; i++) {
-    runOnceSerial();
+  if (m_deltaWriter) {
+    m_deltaWriter->finish(m_parameters, m_seed, m_generation, m_population,
+                          m_order, m_ids);
   }
 }
 
+void Ecosystem::run(unsigned numIterations, unsigned numThreads) {
+  for (unsigned i = 0; i < numIterations; i++) {
+    if (numThreads > 1) {
+      runOnceThread(numThreads);
+    } else {
+      runOnceSerial();
+    }
 
+    if (m_profileWriter) {
+      m_profileWriter->write(m_profiler.profile());
+    }
 
+    if (m_checkpointWriter && m_generation % m_checkpointInterval == 0) {
+      m_checkpointWriter->save(m_parameters, m_seed, m_generation,
+                               m_population, m_order);
+    }
+  }
+}
@@ -2,8 +2,17 @@
 #define ECOSYSTEM_H
 
 #include <memory>
+#include <string>
 #include <boost/serialization/unique_ptr.hpp>
 #include "agent.h"
+#include "checkpoint.h"
+#include "delta.h"
+#include "instrumentation.h"
+#include "migrants.h"
+#include "pairing.h"
+#include "population.h"
+#include "statistics.h"
+#include "threadpool.h"
 
 
 
@@ -11,39 +20,278 @@
  * Ecosystem                                                                  *
  * -------------------------------------------------------------------------- */
 
+/**
+ * @brief Erases the dead agents (those without energy) from `order` and
+ *  releases their slots.  The order of the survivors is not preserved.
+ *
+ * @return number of dead agents
+ */
+unsigned removeDeadAgents(Population &population, SlotVector &order);
+
+
+/* Deaths of a chunk of the feeding round, or of the whole round */
+typedef struct {
+  unsigned numDead;     //! Agents eaten or starved
+  unsigned numKills;    //! Of which eaten
+} FeedingDeaths;
 
 class Ecosystem {
  private:
 
-  std::vector<std::unique_ptr<Agent>> m_agents;
+  Population m_population;  //! Agent store
+  SlotVector m_order;       //! Live slots, in pairing order
   Parameters m_parameters;
+  uint64_t m_seed;        //! Master seed of all random streams
+  uint64_t m_generation;  //! Number of generations run so far
+  Random m_random;        //! Reusable stream, re-keyed every generation
+
+  std::unique_ptr<PairingEngine> m_pairing;   //! Who meets whom
+  std::unique_ptr<ThreadPool> m_pool;   //! Workers of `runOnceThread`
+  std::vector<Random> m_streams;        //! One reusable stream per thread
+  std::vector<uint64_t> m_matingMask;   //! Bit `k`: pair `k` mates
+  std::vector<unsigned> m_chunkBirths;  //! First birth of each chunk
+
+  RunningStatistics m_entropy;    //! Entropy of the live agents
+  RunningStatistics m_survival;   //! Survival fraction of each generation
+  std::vector<RunningStatistics> m_chunkEntropy;  //! Partial entropy stats
+  std::vector<FeedingDeaths> m_chunkDeaths;   //! Deaths in each chunk
+
+  std::unique_ptr<CheckpointWriter> m_checkpointWriter;
+  unsigned m_checkpointInterval;  //! Generations between two checkpoints
+
+  std::vector<uint64_t> m_ids;    //! Id of the agent in each slot
+  uint64_t m_nextId;              //! Id of the next agent born
+  std::unique_ptr<DeltaWriter> m_deltaWriter;
+
+  Profiler m_profiler;    //! Only used by instrumented builds
+  std::unique_ptr<ProfileWriter> m_profileWriter;
 
   friend class boost::serialization::access;
 
-  /* Serialization */
+  /* Serialization.  The agents are written in pairing order as (energy,
+   * chromosome bytes) records, so the archive does not depend on the slot
+   * layout.  Version 0 and 1 archives stored a vector of `unique_ptr<Agent>`
+   * and can still be loaded */
   template <typename Archive>
-  void serialize(Archive &ar, const unsigned int version) {
-    ar &m_parameters;
-    ar &m_agents;
+  void save(Archive &ar, const unsigned int version) const {
+    ar << m_parameters;
+
+    unsigned numAgents = m_order.size();
+    ar << numAgents;
+    for (unsigned k = 0; k < numAgents; k++) {
+      unsigned slot = m_order[k];
+      double energy = m_population.getEnergy(slot);
+      ar << energy;
+      ar << boost::serialization::make_array(
+           reinterpret_cast<const char *>(m_population.chromosome(slot)),
+           m_population.sizeChromosome());
+    }
+
+    ar << m_seed;
+    ar << m_generation;
   }
 
+  template <typename Archive>
+  void load(Archive &ar, const unsigned int version) {
+    ar >> m_parameters;
+    m_population = Population(m_parameters.sizeChromosome);
+    m_order.clear();
+
+    if (version < 2) {
+      std::vector<std::unique_ptr<Agent>> agents;
+      ar >> agents;
+      for (unsigned k = 0; k < agents.size(); k++) {
+        m_order.push_back(m_population.insert(*agents[k]));
+      }
+    }
+
+    else {
+      unsigned numAgents;
+      ar >> numAgents;
+      m_population.reserve(numAgents);
+      for (unsigned k = 0; k < numAgents; k++) {
+        unsigned slot = m_population.allocate();
+        double energy;
+        ar >> energy;
+        m_population.setEnergy(slot, energy);
+        ar >> boost::serialization::make_array(
+             reinterpret_cast<char *>(m_population.chromosome(slot)),
+             m_population.sizeChromosome());
+        m_population.countOnes(slot);
+        m_order.push_back(slot);
+      }
+    }
+
+    if (version >= 1) {
+      ar >> m_seed;
+      ar >> m_generation;
+    }
+
+    m_survival.clear();
+    collectEntropy();
+    assignIds();
+  }
+
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+
   void runOnceSerial(void);
   void runOnceThread(unsigned numThreads);
 
+  /* Recomputes the entropy statistics from the cached Hamming weights, for
+   * populations that did not come out of a generation step */
+  void collectEntropy(void);
+
+  /* Numbers the live agents `0, 1, ...` in pairing order */
+  void assignIds(void);
+
+  /* Gives the agent just born into `slot` the next id */
+  void registerBirth(unsigned slot, uint64_t father, uint64_t mother);
+
  public:
 
   Ecosystem();
-  Ecosystem(const Parameters &params);
 
-  void run(unsigned numIterations = 1000);
+  /**
+   * @brief Creates a population of `sizePopulation` blank agents
+   *
+   * @param params
+   * @param seed master seed.  Two ecosystems with the same parameters and
+   *  seed evolve identically.
+   */
+  Ecosystem(const Parameters &params, uint64_t seed = 0);
+
+  /**
+   * @brief Runs `numIterations` generations.  With more than one thread the
+   *  feeding, starvation and mating rounds are split into fixed-size chunks
+   *  of pairs that run on a thread pool.  The results only depend on the
+   *  seed, not on the number of threads.
+   *
+   * @param numIterations
+   * @param numThreads
+   */
+  void run(unsigned numIterations = 1000, unsigned numThreads = 1);
+
+  /**
+   * @brief Writes the ecosystem as a flat checkpoint (see `checkpoint.h`).
+   *  This is much faster to save and restore than the Boost archive, which
+   *  remains available for compatibility.
+   *
+   * @note This function throws an exception when the file cannot be written.
+   */
+  void saveCheckpoint(const std::string &path, bool compress = false) const;
+
+  /**
+   * @brief Replaces the ecosystem with a flat checkpoint.  The checkpoint is
+   *  memory-mapped and used as the population store, so no chromosome is
+   *  read until a generation step touches it.
+   *
+   * @note This function throws an exception when the file cannot be mapped
+   *  or is not a valid checkpoint.
+   */
+  void loadCheckpoint(const std::string &path);
+
+  /**
+   * @brief Makes `run` save a flat checkpoint every `interval` generations
+   *  (counted from generation 0), from a background thread.  The run only
+   *  pauses to copy the population.  Resuming from a checkpoint with
+   *  `loadCheckpoint` continues exactly as the original run did.
+   *
+   * @param path file replaced by every checkpoint
+   * @param interval generations between two checkpoints, 0 to stop saving
+   * @param compress gzip the checkpoints
+   */
+  void setCheckpoint(const std::string &path, unsigned interval,
+                     bool compress = false);
+
+  /**
+   * @brief Waits until the checkpoints requested by `run` are on disk
+   *
+   * @note This function rethrows the exception of a failed write.
+   */
+  void flushCheckpoints(void);
+
+  /**
+   * @brief Makes `run` record every generation in a delta stream (see
+   *  `delta.h`), starting with a FULL record of the current state.  Agent
+   *  ids are assigned from the moment the ecosystem is created or loaded,
+   *  so they are only unique within one run.
+   *
+   * @param path file of the stream, truncated
+   * @param fullInterval generations between two FULL records, 0 to stop
+   *  recording
+   *
+   * @note This function throws an exception when the file cannot be written.
+   */
+  void setDeltaRecording(const std::string &path, unsigned fullInterval);
+
+  /**
+   * @brief Makes `run` write the profile of every generation (see
+   *  `instrumentation.h`) to a time series
+   *
+   * @param path file of the series, truncated
+   *
+   * @note This function throws an exception when the file cannot be written
+   *  or the build has no instrumentation.
+   */
+  void setProfile(const std::string &path, ProfileFormat format);
+
+  /* Profile of the last generation, all zeros without instrumentation */
+  const GenerationProfile &getProfile(void) const;
+
+  /**
+   * @brief Moves `count` live agents, chosen at random, out of the ecosystem
+   *  and appends them to `batch`.  The choice only depends on the seed, the
+   *  generation and `stream`.
+   *
+   * @param count capped at the number of live agents
+   * @param stream tells apart the batches of one generation
+   */
+  void emigrate(unsigned count, MigrantBatch &batch, unsigned stream = 0);
+
+  /**
+   * @brief Adds agents that emigrated from another ecosystem.  They join the
+   *  pairing order at the back, as if they were algae.
+   *
+   * @note This function throws an exception when the chromosome size does
+   *  not match.
+   */
+  void immigrate(const MigrantBatch &batch);
+
+  /**
+   * @brief Replaces the pairing engine (see `pairing.h`), which is a
+   *  `ShufflePairing` by default.  The engine is not saved in checkpoints:
+   *  a resumed run resumes exactly when it is given the same engine again.
+   */
+  void setPairingEngine(std::unique_ptr<PairingEngine> engine);
+  const PairingEngine &getPairingEngine(void) const;
+
+  /* Number of live agents */
+  unsigned size(void) const;
+
+  /* Model parameters, master seed and number of generations run so far */
+  const Parameters &getParameters(void) const;
+  uint64_t getSeed(void) const;
+  uint64_t getGeneration(void) const;
 
-  /* Simple statistics and diagnostics */
-  double meanEntropy(void);
-  double stdevEntropy(void);
-  double meanSurvivalFraction(void);
+  /**
+   * @brief Simple statistics and diagnostics.  They are reduced on the fly
+   *  by the threads of the generation step, so reading them is O(1).
+   *
+   *    Statistic               Meaning
+   *
+   *    meanEntropy             Mean Shannon entropy of the live agents
+   *    stdevEntropy            Standard deviation of the above
+   *    meanSurvivalFraction    Fraction of the agents that survive the
+   *                            feeding round, averaged over every
+   *                            generation run by this object (0 before the
+   *                            first one)
+   */
+  double meanEntropy(void) const;
+  double stdevEntropy(void) const;
+  double meanSurvivalFraction(void) const;
 };
 
 
-BOOST_CLASS_VERSION(Ecosystem, 0)
+BOOST_CLASS_VERSION(Ecosystem, 2)
 
 #endif /* end of include guard: ECOSYSTEM_H */
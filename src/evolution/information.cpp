@@ -1,38 +1,85 @@
+#include <cassert>
 #include <cmath>
 #include <cstring>
+#include <stdexcept>
 #include "information.h"
+#include "kernels.h"
 
 
 /* -------------------------------------------------------------------------- *
  * Information theory and bitstring buffers                                   *
  * -------------------------------------------------------------------------- */
 
-Buffer::Buffer() { }
+unsigned Buffer::paddedNumWords(unsigned size) {
+  unsigned numWords = (size + Buffer::wordBytes - 1) / Buffer::wordBytes;
+  unsigned numBlocks = (numWords + Buffer::blockWords - 1) / Buffer::blockWords;
+  return numBlocks * Buffer::blockWords;
+}
+
+Buffer::Buffer() : m_size(0) { }
+
+Buffer::Buffer(const char *c_str) : m_size(0) {
+  unsigned size = strlen(c_str);
+  resize(size);
+  memcpy(data(), c_str, size);
+}
+
+Buffer::Buffer(const char *c_str, unsigned size) : m_size(0) {
+  resize(size);
+  memcpy(data(), c_str, size);
+}
 
-Buffer::Buffer(const char *c_str) {
-  for (unsigned k = 0; k < strlen(c_str); k++) {
-    this->push_back(c_str[k]);
+Buffer::Buffer(unsigned num, char c) : m_size(0) {
+  resize(num);
+  memset(data(), c, num);
+}
+
+void Buffer::resize(unsigned size) {
+  unsigned oldSize = m_size;
+  m_words.resize(paddedNumWords(size), 0);
+  m_size = size;
+
+  /* Bytes dropped by a shrink must go back to being padding */
+  if (size < oldSize) {
+    memset(data() + size, 0, numWords() * wordBytes - size);
   }
 }
 
-Buffer::Buffer(const char *c_str, unsigned size) {
-  for (unsigned k = 0; k < size; k++) {
-    this->push_back(c_str[k]);
+void Buffer::clearPadding(void) {
+  unsigned last = m_size / wordBytes;
+  unsigned used = m_size % wordBytes;
+
+  if (used > 0) {
+    m_words[last] &= (Word(1) << (8 * used)) - 1;
+    last += 1;
+  }
+
+  for (unsigned k = last; k < numWords(); k++) {
+    m_words[k] = 0;
   }
 }
 
-Buffer::Buffer(unsigned num, char c) {
-  for (unsigned k = 0; k < num; k++) {
-    this->push_back(c);
+bool Buffer::operator== (const Buffer &obj) const {
+  if (m_size != obj.m_size) {
+    return false;
   }
+
+  /* Padding is always zero, so whole words can be compared */
+  return m_words == obj.m_words;
+}
+
+bool Buffer::operator!= (const Buffer &obj) const {
+  return !(*this == obj);
 }
 
 Buffer &Buffer::operator^= (const Buffer &obj) {
-  Buffer &self = *this;
-  for (unsigned k = 0; k < size(); k++) {
-    self[k] = self[k] ^ obj[k];
+  assert(obj.m_size == m_size);
+  Word *w = words();
+  const Word *v = obj.words();
+  for (unsigned k = 0; k < numWords(); k++) {
+    w[k] ^= v[k];
   }
-  return self;
+  return *this;
 }
 
 const Buffer Buffer::operator^ (const Buffer &obj) const {
@@ -42,65 +89,41 @@ const Buffer Buffer::operator^ (const Buffer &obj) const {
 }
 
 const Buffer Buffer::operator~() const {
-  const Buffer &self = *this;
   Buffer copy(*this);
-  for (unsigned k = 0; k < size(); k++) {
-    copy[k] = ~self[k];
+  Word *w = copy.words();
+  for (unsigned k = 0; k < numWords(); k++) {
+    w[k] = ~w[k];
   }
+  copy.clearPadding();
   return copy;
 }
 
-static const char flipMask[] = "\x01\x02\x04\x08\x10\x20\x40\x80";
-
 void Buffer::flipBit(unsigned index) {
-  Buffer &self = *this;
-  unsigned offset = index / 8;
-  unsigned k = index % 8;
+  unsigned offset = index / wordBits;
+  unsigned k = index % wordBits;
 
   /* Flip the bit */
-  char mask = flipMask[k];
-  self[offset] = self[offset] ^ mask;
+  m_words[offset] ^= Word(1) << k;
 }
 
 u_int8_t Buffer::getBit(unsigned index) const {
-  const Buffer &self = *this;
-  unsigned offset =  index / 8;
-  unsigned k = index % 8;
+  unsigned offset = index / wordBits;
+  unsigned k = index % wordBits;
 
   /* Get the bit */
-  char b = self[offset];
-  u_int8_t bit = ((b >> k) & 0x01);
+  u_int8_t bit = (m_words[offset] >> k) & 0x01;
   return bit;
 }
 
-/* Used in hammingWeight */
-static const unsigned hammingNumOnes[] = {
-  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
-};
-
-/**
- * @brief Returns the number of binary ones in an unsigned char
- *
- * @param x
- */
-static unsigned hammingCountOnes(unsigned char x) {
-  unsigned numOnes;
-  numOnes = hammingNumOnes[x & 0x0f];
-  numOnes += hammingNumOnes[x >> 4];
-  return numOnes;
-}
-
 unsigned hammingWeight(const Buffer &buffer) {
-  unsigned weight = 0;
-  for (unsigned k = 0; k < buffer.size(); k++) {
-    weight += hammingCountOnes(buffer[k]);
-  }
-  return weight;
+  return popcountWords(buffer.words(), buffer.numWords());
 }
 
 double shannonEntropy(const Buffer &buffer) {
-  unsigned numBits = buffer.size() * 8;
-  unsigned numOnes = hammingWeight(buffer);
+  return shannonEntropy(hammingWeight(buffer), buffer.size() * 8);
+}
+
+double shannonEntropy(unsigned numOnes, unsigned numBits) {
   unsigned numZeros = numBits - numOnes;
 
   /* Probabilities */
@@ -120,7 +143,12 @@ double shannonEntropy(const Buffer &buffer) {
 }
 
 unsigned distance(const Buffer &a, const Buffer &b) {
-  return hammingWeight(a ^ b);
+  if (a.size() != b.size()) {
+    throw std::invalid_argument("distance between unequally sized buffers");
+  }
+
+  /* Fused XOR and popcount, no temporary buffer */
+  return popcountXorWords(a.words(), b.words(), a.numWords());
 }
 
 
@@ -1,27 +1,124 @@
 #ifndef INFORMATION_H
 #define INFORMATION_H
 
+#include <cstdint>
+#include <cstdlib>
+#include <new>
 #include <vector>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/array_wrapper.hpp>
+#include <boost/serialization/collection_size_type.hpp>
+#include <boost/serialization/split_member.hpp>
 #include <boost/serialization/vector.hpp>
+#include "instrumentation.h"
+
+/* Buffers address individual bits through 64-bit words, which only agrees
+ * with the byte-wise view of the buffer on little-endian machines */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "Buffer requires a little-endian target"
+#endif
+
+
+/* -------------------------------------------------------------------------- *
+ * Aligned storage                                                            *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Standard allocator that hands out storage aligned to `Alignment`
+ *  bytes, so that word-packed buffers start on a cache line boundary.
+ */
+template <typename T, std::size_t Alignment = 64>
+class AlignedAllocator {
+ public:
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind {
+    typedef AlignedAllocator<U, Alignment> other;
+  };
+
+  AlignedAllocator() { }
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) { }
+
+  T *allocate(std::size_t n) {
+    PROFILE(countAllocation());
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, Alignment, n * sizeof(T)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, std::size_t) {
+    free(ptr);
+  }
+
+  template <typename U>
+  bool operator== (const AlignedAllocator<U, Alignment> &) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!= (const AlignedAllocator<U, Alignment> &) const {
+    return false;
+  }
+};
 
 
 /* -------------------------------------------------------------------------- *
  * Information theory                                                         *
  * -------------------------------------------------------------------------- */
 
-class Buffer : public std::vector<char> {
+/**
+ * @brief A byte string stored as a zero-padded array of 64-bit words.  The
+ *  words are 64-byte aligned and their count is rounded up to a whole
+ *  `blockWords` block, so the bitwise and popcount kernels can always work a
+ *  full machine word (or vector register) at a time.  Bytes past `size()`
+ *  are kept at zero.
+ */
+class Buffer {
+ public:
+  typedef uint64_t Word;
+  typedef std::vector<Word, AlignedAllocator<Word>> WordVector;
+
+  static const unsigned wordBytes = sizeof(Word);
+  static const unsigned wordBits = 8 * sizeof(Word);
+  static const unsigned blockWords = 8;
 
  private:
+  WordVector m_words;   //! Zero-padded word storage
+  unsigned m_size;      //! Number of bytes in the buffer
+
   friend class boost::serialization::access;
 
-  /* Serialization */
+  /* Serialization.  The wire format is the same as a `std::vector<char>` */
+  template <typename Archive>
+  void save(Archive &ar, const unsigned int version) const {
+    const boost::serialization::collection_size_type count(m_size);
+    ar << count;
+    if (m_size > 0) {
+      ar << boost::serialization::make_array(data(), m_size);
+    }
+  }
+
   template <typename Archive>
-  void serialize(Archive &ar, const unsigned int version) {
-    ar &boost::serialization::base_object<std::vector<char>> (*this);
+  void load(Archive &ar, const unsigned int version) {
+    boost::serialization::collection_size_type count;
+    ar >> count;
+    resize(count);
+    if (m_size > 0) {
+      ar >> boost::serialization::make_array(data(), m_size);
+    }
   }
 
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+  /* Clears the padding bytes in the last word */
+  void clearPadding(void);
+
  public:
 
   /* Helper constructors */
@@ -30,6 +127,70 @@ class Buffer : public std::vector<char> {
   Buffer(const char *c_str, unsigned size);
   Buffer(unsigned num, char c);
 
+  /* Byte-wise access */
+  unsigned size(void) const {
+    return m_size;
+  }
+
+  bool empty(void) const {
+    return m_size == 0;
+  }
+
+  char *data(void) {
+    return reinterpret_cast<char *>(m_words.data());
+  }
+
+  const char *data(void) const {
+    return reinterpret_cast<const char *>(m_words.data());
+  }
+
+  char &operator[](unsigned index) {
+    return data()[index];
+  }
+
+  const char &operator[](unsigned index) const {
+    return data()[index];
+  }
+
+  char *begin(void) {
+    return data();
+  }
+
+  const char *begin(void) const {
+    return data();
+  }
+
+  char *end(void) {
+    return data() + m_size;
+  }
+
+  const char *end(void) const {
+    return data() + m_size;
+  }
+
+  /* Resize to `size` bytes.  New bytes are zero */
+  void resize(unsigned size);
+
+  /* Word-wise access.  `numWords` includes the zero padding */
+  Word *words(void) {
+    return m_words.data();
+  }
+
+  const Word *words(void) const {
+    return m_words.data();
+  }
+
+  unsigned numWords(void) const {
+    return m_words.size();
+  }
+
+  /* Number of padded words used to store `size` bytes */
+  static unsigned paddedNumWords(unsigned size);
+
+  /* Comparison */
+  bool operator== (const Buffer &obj) const;
+  bool operator!= (const Buffer &obj) const;
+
   /* Bitwise arithmetic operations */
   Buffer &operator^= (const Buffer &obj);
   const Buffer operator^ (const Buffer &obj) const;
@@ -48,7 +209,7 @@ BOOST_CLASS_VERSION(Buffer, 0)
 
 /**
  * @brief Calculate the Hamming weight of a byte string, interpreting `buffer`
- *  as a string of bytes.
+ *  as a string of bytes.  Uses the popcount kernel selected in `kernels.h`.
  *
  * @param buffer
  *
@@ -65,16 +226,28 @@ unsigned hammingWeight(const Buffer &buffer);
  */
 double shannonEntropy(const Buffer &buffer);
 
+/**
+ * @brief Calculate the Shannon entropy of a bit string from its Hamming
+ *  weight
+ *
+ * @param numOnes Hamming weight
+ * @param numBits length of the string in bits
+ *
+ * @return Shannon entropy
+ */
+double shannonEntropy(unsigned numOnes, unsigned numBits);
+
 /**
  * @brief Calculate the distance between two byte strings, defined as the
  *  metric `d(a, b) = H(a - b)`, where `H(x)` is the Hamming weight.  The
- *  strings must be the same size.
+ *  strings must be the same size.  The XOR and the popcount are fused, so no
+ *  temporary buffer is allocated.
  *
  * @note This function throws an exception when byte strings are unequally
  *  sized.
  *
  * @param a first byte string
-\ * @param b second byte string
+ * @param b second byte string
  *
  * @return distance
  */
@@ -0,0 +1,187 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include "instrumentation.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(GENETICS_INSTRUMENTATION) && defined(HAVE_SYS_SDT_H)
+#include <sys/sdt.h>
+#define PROBE_PHASE(generation, timer, cycles) \
+  DTRACE_PROBE3(genetics, phase, generation, timer, cycles)
+#else
+#define PROBE_PHASE(generation, timer, cycles) do { } while (0)
+#endif
+
+
+/* -------------------------------------------------------------------------- *
+ * Instrumentation                                                            *
+ * -------------------------------------------------------------------------- */
+
+static const char *timerNames[NUM_PROFILE_TIMERS] = {
+  "algaeCycles", "feedingPairingCycles", "feedingCycles", "removeDeadCycles",
+  "matingPairingCycles", "matingCycles", "mergeCycles"
+};
+
+static const char *counterNames[NUM_PROFILE_COUNTERS] = {
+  "agents", "encounters", "kills", "starved", "matings", "births",
+  "allocations"
+};
+
+const char *profileTimerName(ProfileTimer timer) {
+  return timerNames[timer];
+}
+
+const char *profileCounterName(ProfileCounter counter) {
+  return counterNames[counter];
+}
+
+uint64_t readCycleCounter(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+#ifdef GENETICS_INSTRUMENTATION
+
+/* Relaxed: the count is only read between generations, after the thread
+ * pool has synchronized with the caller */
+static std::atomic<uint64_t> allocations(0);
+
+uint64_t numAllocations(void) {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+void countAllocation(void) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* Replacements of the global allocation functions, so every `new` of the
+ * process is counted.  The array and nothrow forms call these */
+void *operator new(std::size_t size) {
+  countAllocation();
+  void *ptr = std::malloc(size > 0 ? size : 1);
+  if (ptr == NULL) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+#else
+
+uint64_t numAllocations(void) {
+  return 0;
+}
+
+void countAllocation(void) { }
+
+#endif /* GENETICS_INSTRUMENTATION */
+
+Profiler::Profiler() : m_mark(0), m_allocations(0) {
+  memset(&m_profile, 0, sizeof(m_profile));
+}
+
+void Profiler::begin(uint64_t generation) {
+  memset(&m_profile, 0, sizeof(m_profile));
+  m_profile.generation = generation;
+  m_allocations = numAllocations();
+  m_mark = readCycleCounter();
+}
+
+void Profiler::phase(ProfileTimer timer) {
+  uint64_t now = readCycleCounter();
+  m_profile.cycles[timer] += now - m_mark;
+  m_mark = now;
+  PROBE_PHASE(m_profile.generation, (int) timer, m_profile.cycles[timer]);
+}
+
+void Profiler::count(ProfileCounter counter, uint64_t count) {
+  m_profile.counts[counter] += count;
+}
+
+void Profiler::finish(void) {
+  m_profile.counts[COUNTER_ALLOCATIONS] = numAllocations() - m_allocations;
+}
+
+const GenerationProfile &Profiler::profile(void) const {
+  return m_profile;
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Time series                                                                *
+ * -------------------------------------------------------------------------- */
+
+ProfileFormat parseProfileFormat(const std::string &name) {
+  if (name == "csv") {
+    return PROFILE_CSV;
+  }
+
+  if (name == "json") {
+    return PROFILE_JSON;
+  }
+
+  throw std::invalid_argument("unknown profile format " + name);
+}
+
+ProfileWriter::ProfileWriter(const std::string &path, ProfileFormat format) :
+  m_stream(path), m_path(path), m_format(format) {
+  if (!m_stream) {
+    throw std::runtime_error("cannot open " + path);
+  }
+
+  if (m_format == PROFILE_CSV) {
+    m_stream << "generation";
+    for (unsigned n = 0; n < NUM_PROFILE_TIMERS; n++) {
+      m_stream << "," << timerNames[n];
+    }
+    for (unsigned n = 0; n < NUM_PROFILE_COUNTERS; n++) {
+      m_stream << "," << counterNames[n];
+    }
+    m_stream << std::endl;
+  }
+}
+
+void ProfileWriter::write(const GenerationProfile &profile) {
+  if (m_format == PROFILE_CSV) {
+    m_stream << profile.generation;
+    for (unsigned n = 0; n < NUM_PROFILE_TIMERS; n++) {
+      m_stream << "," << profile.cycles[n];
+    }
+    for (unsigned n = 0; n < NUM_PROFILE_COUNTERS; n++) {
+      m_stream << "," << profile.counts[n];
+    }
+  }
+
+  else {
+    m_stream << "{\"generation\": " << profile.generation;
+    for (unsigned n = 0; n < NUM_PROFILE_TIMERS; n++) {
+      m_stream << ", \"" << timerNames[n] << "\": " << profile.cycles[n];
+    }
+    for (unsigned n = 0; n < NUM_PROFILE_COUNTERS; n++) {
+      m_stream << ", \"" << counterNames[n] << "\": " << profile.counts[n];
+    }
+    m_stream << "}";
+  }
+
+  m_stream << std::endl;
+  if (!m_stream) {
+    throw std::runtime_error("cannot write " + m_path);
+  }
+}
@@ -0,0 +1,157 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+
+/* -------------------------------------------------------------------------- *
+ * Instrumentation                                                            *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Hot-path instrumentation of the generation step.  It is compiled in
+ *  by `./configure --enable-instrumentation`, which defines
+ *  `GENETICS_INSTRUMENTATION`.  Otherwise `PROFILE(...)` expands to nothing,
+ *  so the generation step is exactly what it is without the layer.
+ *
+ *  An instrumented build times every phase of a generation with the cycle
+ *  counter, counts what happened in it, and counts the heap allocations of
+ *  the whole process.  When `<sys/sdt.h>` is available every phase is also
+ *  a USDT probe, `sdt_genetics:phase(generation, timer, cycles)`, which
+ *  `perf probe` and `perf record` can attach to.
+ */
+#ifdef GENETICS_INSTRUMENTATION
+#define PROFILE(...) __VA_ARGS__
+#else
+#define PROFILE(...) do { } while (0)
+#endif
+
+/* Whether this build has the instrumentation layer */
+#ifdef GENETICS_INSTRUMENTATION
+static const bool instrumentationEnabled = true;
+#else
+static const bool instrumentationEnabled = false;
+#endif
+
+/* Phases of a generation, in the order they run */
+typedef enum {
+  TIMER_ALGAE,            //! Top up the population with algae
+  TIMER_FEEDING_PAIRING,  //! Arrange the feeding pairs
+  TIMER_FEEDING,          //! Predation and starvation
+  TIMER_REMOVE_DEAD,      //! `removeDeadAgents`
+  TIMER_MATING_PAIRING,   //! Arrange the mating pairs
+  TIMER_MATING,           //! Courtship, crossover and mutation
+  TIMER_MERGE,            //! Newborns join the population
+  NUM_PROFILE_TIMERS
+} ProfileTimer;
+
+/* Events of a generation */
+typedef enum {
+  COUNTER_AGENTS,         //! Agents at the start of the feeding round
+  COUNTER_ENCOUNTERS,     //! Predation encounters
+  COUNTER_KILLS,          //! Encounters where one agent ate the other
+  COUNTER_STARVED,        //! Agents that died of starvation
+  COUNTER_MATINGS,        //! Mating attempts
+  COUNTER_BIRTHS,         //! Children born
+  COUNTER_ALLOCATIONS,    //! Heap allocations, by any thread
+  NUM_PROFILE_COUNTERS
+} ProfileCounter;
+
+/* Everything recorded about one generation */
+typedef struct {
+  uint64_t generation;
+  uint64_t cycles[NUM_PROFILE_TIMERS];
+  uint64_t counts[NUM_PROFILE_COUNTERS];
+} GenerationProfile;
+
+/* Column names of the timers and counters */
+const char *profileTimerName(ProfileTimer timer);
+const char *profileCounterName(ProfileCounter counter);
+
+/**
+ * @brief Reads the time stamp counter on x86, which ticks at a constant
+ *  rate close to the nominal clock of the CPU, and a monotonic clock in
+ *  nanoseconds elsewhere
+ */
+uint64_t readCycleCounter(void);
+
+/**
+ * @brief Number of heap allocations made by the process so far, through
+ *  `operator new` or `AlignedAllocator`.  Always 0 without the
+ *  instrumentation layer.
+ */
+uint64_t numAllocations(void);
+void countAllocation(void);
+
+/**
+ * @brief Records the profile of one generation at a time.  `begin` starts
+ *  the first phase, and every call to `phase` closes the phase running since
+ *  the previous call.
+ */
+class Profiler {
+ private:
+  GenerationProfile m_profile;
+  uint64_t m_mark;          //! Cycle counter at the start of the phase
+  uint64_t m_allocations;   //! Allocation count at the start
+
+ public:
+  Profiler();
+
+  void begin(uint64_t generation);
+  void phase(ProfileTimer timer);
+  void count(ProfileCounter counter, uint64_t count);
+  void finish(void);
+
+  /* The last generation finished, all zeros before the first one */
+  const GenerationProfile &profile(void) const;
+};
+
+
+/* -------------------------------------------------------------------------- *
+ * Time series                                                                *
+ * -------------------------------------------------------------------------- */
+
+typedef enum {
+  PROFILE_CSV,    //! One header line, then one line per generation
+  PROFILE_JSON    //! JSON Lines: one object per generation
+} ProfileFormat;
+
+/**
+ * @brief Parses a format name, `csv` or `json`
+ *
+ * @note This function throws an exception when the name is unknown.
+ */
+ProfileFormat parseProfileFormat(const std::string &name);
+
+/**
+ * @brief Writes profiles as a time series, with one column or key per
+ *  timer and counter.  Every line is flushed, so a series can be followed
+ *  while the run goes on.
+ */
+class ProfileWriter {
+ private:
+  std::ofstream m_stream;
+  std::string m_path;
+  ProfileFormat m_format;
+
+ public:
+
+  /**
+   * @brief Creates (or truncates) the file at `path`
+   *
+   * @note This function throws an exception when the file cannot be
+   *  written.
+   */
+  ProfileWriter(const std::string &path, ProfileFormat format);
+
+  /**
+   * @note This function throws an exception when the file cannot be
+   *  written.
+   */
+  void write(const GenerationProfile &profile);
+};
+
+
+#endif /* end of include guard: INSTRUMENTATION_H */
@@ -0,0 +1,565 @@
+#include <atomic>
+#include <stdexcept>
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+/* -------------------------------------------------------------------------- *
+ * Word loaders                                                               *
+ * -------------------------------------------------------------------------- */
+
+/* Every kernel is written once and instantiated twice: with `Xor = false` it
+ * counts the ones in `a`, with `Xor = true` it counts the ones in `a ^ b`. */
+template <bool Xor>
+static inline uint64_t loadWord(const uint64_t *a, const uint64_t *b,
+                                unsigned k) {
+  return Xor ? (a[k] ^ b[k]) : a[k];
+}
+
+/* Every kernel is also instantiated for a few fixed lengths (see
+ * `fixedLengths`).  With `Fixed != 0` the length is a compile-time constant,
+ * so the loops are unrolled and the tails vanish; `numWords` is ignored. */
+template <unsigned Fixed>
+static inline unsigned kernelLength(unsigned numWords) {
+  return Fixed != 0 ? Fixed : numWords;
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Portable kernels                                                           *
+ * -------------------------------------------------------------------------- */
+
+/* Used in the table kernel */
+static const unsigned hammingNumOnes[] = {
+  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+/**
+ * @brief Byte-at-a-time nibble look-up.  This is the original implementation
+ *  of `hammingWeight`, kept as a baseline for benchmarks.
+ */
+template <unsigned Fixed, bool Xor>
+static uint64_t tableCount(const uint64_t *a, const uint64_t *b,
+                           unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  uint64_t weight = 0;
+  for (unsigned k = 0; k < numWords; k++) {
+    uint64_t w = loadWord<Xor>(a, b, k);
+    for (unsigned j = 0; j < 8; j++) {
+      unsigned char x = (w >> (8 * j)) & 0xff;
+      weight += hammingNumOnes[x & 0x0f];
+      weight += hammingNumOnes[x >> 4];
+    }
+  }
+  return weight;
+}
+
+/**
+ * @brief Counts the ones of a word with shifts and masks only
+ */
+static inline uint64_t swarCount(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return (x * 0x0101010101010101ULL) >> 56;
+}
+
+template <unsigned Fixed, bool Xor>
+static uint64_t scalarCount(const uint64_t *a, const uint64_t *b,
+                            unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  uint64_t weight = 0;
+  for (unsigned k = 0; k < numWords; k++) {
+    weight += swarCount(loadWord<Xor>(a, b, k));
+  }
+  return weight;
+}
+
+
+/* Low bit of every two-bit cell */
+static const uint64_t cellMask = 0x5555555555555555ULL;
+
+/**
+ * @brief Bit-sliced rock-paper-scissors.  Reading a word as 32 two-bit cells
+ *  with value `2 * hi + lo`, `a` beats `b` in a cell when `b = a + 1 (mod 4)`
+ *  and loses when `a = b + 1 (mod 4)`.  Both cases need `a_lo != b_lo`, and
+ *  then exactly one of them holds: `a` wins iff `a_hi ^ b_hi == a_lo`.  The
+ *  returned masks have one bit set (at the cell's low bit) per won or
+ *  decided cell, so that `score = 2 * |win| - |decided|`.
+ */
+static inline uint64_t scoreMasks(uint64_t a, uint64_t b, uint64_t &decided) {
+  uint64_t x = a ^ b;
+  decided = x & cellMask;
+  return decided & ~((x >> 1) ^ a);
+}
+
+template <unsigned Fixed>
+static int64_t scalarScore(const uint64_t *a, const uint64_t *b,
+                           unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  int64_t wins = 0;
+  int64_t decided = 0;
+  uint64_t d;
+  for (unsigned k = 0; k < numWords; k++) {
+    wins += swarCount(scoreMasks(a[k], b[k], d));
+    decided += swarCount(d);
+  }
+  return 2 * wins - decided;
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * x86 kernels                                                                *
+ * -------------------------------------------------------------------------- */
+
+#ifdef HAVE_X86_KERNELS
+
+#define TARGET_POPCNT __attribute__((target("popcnt")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512vpopcntdq")))
+
+/**
+ * @brief One `popcnt` per word.  Four independent accumulators keep the
+ *  instruction's latency off the critical path.
+ */
+template <unsigned Fixed, bool Xor>
+static TARGET_POPCNT uint64_t popcntCount(const uint64_t *a,
+    const uint64_t *b, unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+  unsigned k = 0;
+  for (; k + 4 <= numWords; k += 4) {
+    c0 += __builtin_popcountll(loadWord<Xor>(a, b, k));
+    c1 += __builtin_popcountll(loadWord<Xor>(a, b, k + 1));
+    c2 += __builtin_popcountll(loadWord<Xor>(a, b, k + 2));
+    c3 += __builtin_popcountll(loadWord<Xor>(a, b, k + 3));
+  }
+  for (; k < numWords; k++) {
+    c0 += __builtin_popcountll(loadWord<Xor>(a, b, k));
+  }
+  return c0 + c1 + c2 + c3;
+}
+
+template <unsigned Fixed>
+static TARGET_POPCNT int64_t popcntScore(const uint64_t *a,
+    const uint64_t *b, unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  int64_t wins = 0;
+  int64_t decided = 0;
+  uint64_t d;
+  for (unsigned k = 0; k < numWords; k++) {
+    wins += __builtin_popcountll(scoreMasks(a[k], b[k], d));
+    decided += __builtin_popcountll(d);
+  }
+  return 2 * wins - decided;
+}
+
+template <bool Xor>
+static inline TARGET_AVX2 __m256i loadAvx2(const uint64_t *a,
+    const uint64_t *b, unsigned k) {
+  __m256i v = _mm256_loadu_si256((const __m256i *)(a + k));
+  if (Xor) {
+    v = _mm256_xor_si256(v, _mm256_loadu_si256((const __m256i *)(b + k)));
+  }
+  return v;
+}
+
+/**
+ * @brief Per-byte popcount with two `pshufb` nibble look-ups, summed into the
+ *  four 64-bit lanes with `psadbw`
+ */
+static inline TARGET_AVX2 __m256i popcountAvx2(__m256i v) {
+  const __m256i lookup = _mm256_setr_epi8(
+                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i lowMask = _mm256_set1_epi8(0x0f);
+  __m256i lo = _mm256_and_si256(v, lowMask);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+  __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                   _mm256_shuffle_epi8(lookup, hi));
+  return _mm256_sad_epu8(counts, _mm256_setzero_si256());
+}
+
+/* Carry-save adder: (high, low) = a + b + c, bit by bit */
+static inline TARGET_AVX2 void csaAvx2(__m256i &high, __m256i &low,
+                                       __m256i a, __m256i b, __m256i c) {
+  __m256i u = _mm256_xor_si256(a, b);
+  high = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(u, c));
+  low = _mm256_xor_si256(u, c);
+}
+
+/**
+ * @brief Harley-Seal popcount.  Sixteen vectors at a time are reduced through
+ *  a tree of carry-save adders, so only one in sixteen vectors needs a full
+ *  `pshufb` popcount.
+ */
+template <unsigned Fixed, bool Xor>
+static TARGET_AVX2 uint64_t avx2Count(const uint64_t *a, const uint64_t *b,
+                                      unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  const unsigned vecWords = 4;
+  const unsigned blockWords = 16 * vecWords;
+
+  __m256i total = _mm256_setzero_si256();
+  __m256i ones = _mm256_setzero_si256();
+  __m256i twos = _mm256_setzero_si256();
+  __m256i fours = _mm256_setzero_si256();
+  __m256i eights = _mm256_setzero_si256();
+  __m256i sixteens, twosA, twosB, foursA, foursB, eightsA, eightsB;
+
+  unsigned k = 0;
+  for (; k + blockWords <= numWords; k += blockWords) {
+    csaAvx2(twosA, ones, ones, loadAvx2<Xor>(a, b, k + 0 * vecWords),
+            loadAvx2<Xor>(a, b, k + 1 * vecWords));
+    csaAvx2(twosB, ones, ones, loadAvx2<Xor>(a, b, k + 2 * vecWords),
+            loadAvx2<Xor>(a, b, k + 3 * vecWords));
+    csaAvx2(foursA, twos, twos, twosA, twosB);
+    csaAvx2(twosA, ones, ones, loadAvx2<Xor>(a, b, k + 4 * vecWords),
+            loadAvx2<Xor>(a, b, k + 5 * vecWords));
+    csaAvx2(twosB, ones, ones, loadAvx2<Xor>(a, b, k + 6 * vecWords),
+            loadAvx2<Xor>(a, b, k + 7 * vecWords));
+    csaAvx2(foursB, twos, twos, twosA, twosB);
+    csaAvx2(eightsA, fours, fours, foursA, foursB);
+    csaAvx2(twosA, ones, ones, loadAvx2<Xor>(a, b, k + 8 * vecWords),
+            loadAvx2<Xor>(a, b, k + 9 * vecWords));
+    csaAvx2(twosB, ones, ones, loadAvx2<Xor>(a, b, k + 10 * vecWords),
+            loadAvx2<Xor>(a, b, k + 11 * vecWords));
+    csaAvx2(foursA, twos, twos, twosA, twosB);
+    csaAvx2(twosA, ones, ones, loadAvx2<Xor>(a, b, k + 12 * vecWords),
+            loadAvx2<Xor>(a, b, k + 13 * vecWords));
+    csaAvx2(twosB, ones, ones, loadAvx2<Xor>(a, b, k + 14 * vecWords),
+            loadAvx2<Xor>(a, b, k + 15 * vecWords));
+    csaAvx2(foursB, twos, twos, twosA, twosB);
+    csaAvx2(eightsB, fours, fours, foursA, foursB);
+    csaAvx2(sixteens, eights, eights, eightsA, eightsB);
+
+    total = _mm256_add_epi64(total, popcountAvx2(sixteens));
+  }
+
+  /* Weigh the partial sums */
+  total = _mm256_slli_epi64(total, 4);
+  total = _mm256_add_epi64(total,
+                           _mm256_slli_epi64(popcountAvx2(eights), 3));
+  total = _mm256_add_epi64(total,
+                           _mm256_slli_epi64(popcountAvx2(fours), 2));
+  total = _mm256_add_epi64(total,
+                           _mm256_slli_epi64(popcountAvx2(twos), 1));
+  total = _mm256_add_epi64(total, popcountAvx2(ones));
+
+  /* Whole vectors left over */
+  for (; k + vecWords <= numWords; k += vecWords) {
+    total = _mm256_add_epi64(total, popcountAvx2(loadAvx2<Xor>(a, b, k)));
+  }
+
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i *) lanes, total);
+  uint64_t weight = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+  /* Words left over */
+  for (; k < numWords; k++) {
+    weight += swarCount(loadWord<Xor>(a, b, k));
+  }
+  return weight;
+}
+
+/* Sums the four 64-bit lanes */
+static inline TARGET_AVX2 uint64_t sumAvx2(__m256i v) {
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i *) lanes, v);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+/**
+ * @brief `scoreMasks` over 256-bit lanes
+ */
+template <unsigned Fixed>
+static TARGET_AVX2 int64_t avx2Score(const uint64_t *a, const uint64_t *b,
+                                     unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  const __m256i mask = _mm256_set1_epi64x(cellMask);
+  __m256i wins = _mm256_setzero_si256();
+  __m256i decided = _mm256_setzero_si256();
+
+  unsigned k = 0;
+  for (; k + 4 <= numWords; k += 4) {
+    __m256i va = _mm256_loadu_si256((const __m256i *)(a + k));
+    __m256i vb = _mm256_loadu_si256((const __m256i *)(b + k));
+    __m256i x = _mm256_xor_si256(va, vb);
+    __m256i d = _mm256_and_si256(x, mask);
+    __m256i w = _mm256_andnot_si256(
+                  _mm256_xor_si256(_mm256_srli_epi64(x, 1), va), d);
+    wins = _mm256_add_epi64(wins, popcountAvx2(w));
+    decided = _mm256_add_epi64(decided, popcountAvx2(d));
+  }
+
+  int64_t score = 2 * (int64_t) sumAvx2(wins) - (int64_t) sumAvx2(decided);
+  return score + scalarScore<0>(a + k, b + k, numWords - k);
+}
+
+/* Sums the eight 64-bit lanes */
+static inline TARGET_AVX512 uint64_t sumAvx512(__m512i v) {
+  uint64_t lanes[8];
+  _mm512_storeu_si512(lanes, v);
+  uint64_t sum = 0;
+  for (unsigned j = 0; j < 8; j++) {
+    sum += lanes[j];
+  }
+  return sum;
+}
+
+template <bool Xor>
+static inline TARGET_AVX512 __m512i loadAvx512(const uint64_t *a,
+    const uint64_t *b, unsigned k, __mmask8 mask) {
+  __m512i v = _mm512_maskz_loadu_epi64(mask, a + k);
+  if (Xor) {
+    v = _mm512_xor_si512(v, _mm512_maskz_loadu_epi64(mask, b + k));
+  }
+  return v;
+}
+
+/**
+ * @brief Native 64-bit lane popcount.  The tail is handled with a masked
+ *  load, so there is no scalar clean-up loop.
+ */
+template <unsigned Fixed, bool Xor>
+static TARGET_AVX512 uint64_t avx512Count(const uint64_t *a,
+    const uint64_t *b, unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  __m512i c0 = _mm512_setzero_si512();
+  __m512i c1 = _mm512_setzero_si512();
+
+  unsigned k = 0;
+  for (; k + 16 <= numWords; k += 16) {
+    c0 = _mm512_add_epi64(c0, _mm512_popcnt_epi64(
+                            loadAvx512<Xor>(a, b, k, 0xff)));
+    c1 = _mm512_add_epi64(c1, _mm512_popcnt_epi64(
+                            loadAvx512<Xor>(a, b, k + 8, 0xff)));
+  }
+  for (; k < numWords; k += 8) {
+    unsigned left = numWords - k;
+    __mmask8 mask = (left >= 8) ? 0xff : (__mmask8)((1u << left) - 1);
+    c0 = _mm512_add_epi64(c0, _mm512_popcnt_epi64(
+                            loadAvx512<Xor>(a, b, k, mask)));
+  }
+
+  return sumAvx512(_mm512_add_epi64(c0, c1));
+}
+
+/**
+ * @brief `scoreMasks` over 512-bit lanes, with a masked tail
+ */
+template <unsigned Fixed>
+static TARGET_AVX512 int64_t avx512Score(const uint64_t *a,
+    const uint64_t *b, unsigned numWords) {
+  numWords = kernelLength<Fixed>(numWords);
+  const __m512i mask = _mm512_set1_epi64(cellMask);
+  __m512i wins = _mm512_setzero_si512();
+  __m512i decided = _mm512_setzero_si512();
+
+  for (unsigned k = 0; k < numWords; k += 8) {
+    unsigned left = numWords - k;
+    __mmask8 load = (left >= 8) ? 0xff : (__mmask8)((1u << left) - 1);
+    __m512i va = _mm512_maskz_loadu_epi64(load, a + k);
+    __m512i vb = _mm512_maskz_loadu_epi64(load, b + k);
+    __m512i x = _mm512_xor_si512(va, vb);
+    __m512i d = _mm512_and_si512(x, mask);
+
+    /* w = d & ~((x >> 1) ^ a) in one ternary-logic instruction */
+    __m512i w = _mm512_ternarylogic_epi64(
+                  d, _mm512_maskz_srli_epi64(0xff, x, 1), va, 0x90);
+    wins = _mm512_add_epi64(wins, _mm512_popcnt_epi64(w));
+    decided = _mm512_add_epi64(decided, _mm512_popcnt_epi64(d));
+  }
+
+  return 2 * (int64_t) sumAvx512(wins) - (int64_t) sumAvx512(decided);
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+
+/* -------------------------------------------------------------------------- *
+ * Dispatch                                                                   *
+ * -------------------------------------------------------------------------- */
+
+typedef uint64_t (*CountFunction)(const uint64_t *, const uint64_t *,
+                                  unsigned);
+typedef int64_t (*ScoreFunction)(const uint64_t *, const uint64_t *,
+                                 unsigned);
+
+/**
+ * @brief Every implementation comes in `numLengths` variants: one for any
+ *  length, then one for each of the fixed lengths 8, 32 and 128 words.
+ *  Those are the padded sizes of 64, 256 and 1024-byte chromosomes, the
+ *  sizes used in production.  `lengthIndex` maps a length to its variant.
+ */
+static const unsigned numLengths = 4;
+
+#define WEIGHT_KERNELS(kernel) \
+  { kernel<0, false>, kernel<8, false>, kernel<32, false>, kernel<128, false> }
+#define DISTANCE_KERNELS(kernel) \
+  { kernel<0, true>, kernel<8, true>, kernel<32, true>, kernel<128, true> }
+#define SCORE_KERNELS(kernel) \
+  { kernel<0>, kernel<8>, kernel<32>, kernel<128> }
+
+/**
+ * @brief Entry in the dispatch table
+ */
+typedef struct {
+  PopcountKernel kernel;
+  const char *name;
+  CountFunction weight[numLengths];
+  CountFunction distance[numLengths];
+  ScoreFunction score[numLengths];
+} PopcountImplementation;
+
+/* Ordered from slowest to fastest */
+static const PopcountImplementation implementations[] = {
+  {
+    POPCOUNT_TABLE, "table", WEIGHT_KERNELS(tableCount),
+    DISTANCE_KERNELS(tableCount), SCORE_KERNELS(scalarScore)
+  },
+  {
+    POPCOUNT_SCALAR, "scalar", WEIGHT_KERNELS(scalarCount),
+    DISTANCE_KERNELS(scalarCount), SCORE_KERNELS(scalarScore)
+  },
+#ifdef HAVE_X86_KERNELS
+  {
+    POPCOUNT_POPCNT, "popcnt", WEIGHT_KERNELS(popcntCount),
+    DISTANCE_KERNELS(popcntCount), SCORE_KERNELS(popcntScore)
+  },
+  {
+    POPCOUNT_AVX2, "avx2", WEIGHT_KERNELS(avx2Count),
+    DISTANCE_KERNELS(avx2Count), SCORE_KERNELS(avx2Score)
+  },
+  {
+    POPCOUNT_AVX512, "avx512", WEIGHT_KERNELS(avx512Count),
+    DISTANCE_KERNELS(avx512Count), SCORE_KERNELS(avx512Score)
+  },
+#endif
+};
+
+static const unsigned numImplementations =
+  sizeof(implementations) / sizeof(implementations[0]);
+
+static const PopcountImplementation *findImplementation(
+  PopcountKernel kernel) {
+  for (unsigned k = 0; k < numImplementations; k++) {
+    if (implementations[k].kernel == kernel) {
+      return &implementations[k];
+    }
+  }
+  return NULL;
+}
+
+bool popcountKernelSupported(PopcountKernel kernel) {
+  switch (kernel) {
+  case POPCOUNT_AUTO:
+  case POPCOUNT_TABLE:
+  case POPCOUNT_SCALAR:
+    return true;
+#ifdef HAVE_X86_KERNELS
+  case POPCOUNT_POPCNT:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("popcnt");
+  case POPCOUNT_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  case POPCOUNT_AVX512:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Picks the fastest supported implementation
+ */
+static const PopcountImplementation *bestImplementation(void) {
+  const PopcountImplementation *best = &implementations[0];
+  for (unsigned k = 0; k < numImplementations; k++) {
+    if (popcountKernelSupported(implementations[k].kernel)) {
+      best = &implementations[k];
+    }
+  }
+  return best;
+}
+
+static std::atomic<const PopcountImplementation *> active(
+  bestImplementation());
+
+void setPopcountKernel(PopcountKernel kernel) {
+  if (!popcountKernelSupported(kernel)) {
+    throw std::invalid_argument("popcount kernel not supported by this CPU");
+  }
+
+  if (kernel == POPCOUNT_AUTO) {
+    active.store(bestImplementation());
+  } else {
+    active.store(findImplementation(kernel));
+  }
+}
+
+PopcountKernel getPopcountKernel(void) {
+  return active.load(std::memory_order_relaxed)->kernel;
+}
+
+const char *popcountKernelName(PopcountKernel kernel) {
+  if (kernel == POPCOUNT_AUTO) {
+    return "auto";
+  }
+
+  const PopcountImplementation *impl = findImplementation(kernel);
+  return impl ? impl->name : "unknown";
+}
+
+static std::atomic<bool> fixedLengths(true);
+
+void setFixedLengthKernels(bool enabled) {
+  fixedLengths.store(enabled);
+}
+
+bool getFixedLengthKernels(void) {
+  return fixedLengths.load();
+}
+
+/* Variant of the kernels for arrays of `numWords` words */
+static inline unsigned lengthIndex(unsigned numWords) {
+  if (!fixedLengths.load(std::memory_order_relaxed)) {
+    return 0;
+  }
+
+  switch (numWords) {
+  case 8:
+    return 1;
+  case 32:
+    return 2;
+  case 128:
+    return 3;
+  default:
+    return 0;
+  }
+}
+
+uint64_t popcountWords(const uint64_t *words, unsigned numWords) {
+  return active.load(std::memory_order_relaxed)->weight[lengthIndex(
+           numWords)](words, words, numWords);
+}
+
+uint64_t popcountXorWords(const uint64_t *a, const uint64_t *b,
+                          unsigned numWords) {
+  return active.load(std::memory_order_relaxed)->distance[lengthIndex(
+           numWords)](a, b, numWords);
+}
+
+int64_t predationScoreWords(const uint64_t *a, const uint64_t *b,
+                            unsigned numWords) {
+  return active.load(std::memory_order_relaxed)->score[lengthIndex(
+           numWords)](a, b, numWords);
+}
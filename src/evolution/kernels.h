@@ -0,0 +1,118 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstdint>
+
+
+/* -------------------------------------------------------------------------- *
+ * Bitwise kernels                                                            *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Implementations of the popcount kernels.  `POPCOUNT_AUTO` picks the
+ *  fastest kernel the CPU supports (this is the default); the others force a
+ *  particular implementation, which is mostly useful for benchmarks and
+ *  tests.
+ *
+ *    Kernel            Implementation
+ *
+ *    POPCOUNT_TABLE    Byte loop with a 16-entry nibble look-up table
+ *    POPCOUNT_SCALAR   Portable 64-bit SWAR bit counting
+ *    POPCOUNT_POPCNT   SSE4.2 `popcnt` instruction, one word at a time
+ *    POPCOUNT_AVX2     Harley-Seal carry-save adders over `pshufb` counts
+ *    POPCOUNT_AVX512   AVX-512 `vpopcntq`
+ */
+typedef enum {
+  POPCOUNT_AUTO,
+  POPCOUNT_TABLE,
+  POPCOUNT_SCALAR,
+  POPCOUNT_POPCNT,
+  POPCOUNT_AVX2,
+  POPCOUNT_AVX512
+} PopcountKernel;
+
+/**
+ * @brief Checks whether the CPU we are running on can execute `kernel`
+ *
+ * @param kernel
+ *
+ * @return true if the kernel can be selected
+ */
+bool popcountKernelSupported(PopcountKernel kernel);
+
+/**
+ * @brief Selects the kernel used by `popcountWords`, `popcountXorWords` and
+ *  `predationScoreWords` (and therefore by `hammingWeight`, `distance` and
+ *  `predationScore`) for the whole process.
+ *
+ * @note This function throws an exception when the kernel is not supported
+ *  by the CPU.
+ *
+ * @param kernel
+ */
+void setPopcountKernel(PopcountKernel kernel);
+
+/**
+ * @brief Returns the kernel currently in use.  Never returns `POPCOUNT_AUTO`.
+ */
+PopcountKernel getPopcountKernel(void);
+
+/**
+ * @brief Human readable name of a kernel, e.g. "avx2"
+ */
+const char *popcountKernelName(PopcountKernel kernel);
+
+/**
+ * @brief Enables or disables the kernels built for fixed lengths.  Arrays of
+ *  8, 32 and 128 words (the padded sizes of 64, 256 and 1024-byte
+ *  chromosomes) get variants of the selected kernel with a compile-time
+ *  length, so their loops are unrolled and have no tails.  Other lengths
+ *  always use the generic variant.  Enabled by default; disabling them is
+ *  mostly useful for benchmarks and tests.
+ *
+ * @param enabled
+ */
+void setFixedLengthKernels(bool enabled);
+bool getFixedLengthKernels(void);
+
+/**
+ * @brief Counts the ones in an array of 64-bit words.  Does not allocate.
+ *
+ * @param words
+ * @param numWords
+ *
+ * @return number of ones
+ */
+uint64_t popcountWords(const uint64_t *words, unsigned numWords);
+
+/**
+ * @brief Counts the ones in `a ^ b` without materializing the XOR.  Does not
+ *  allocate.
+ *
+ * @param a
+ * @param b
+ * @param numWords number of words in each array
+ *
+ * @return number of differing bits
+ */
+uint64_t popcountXorWords(const uint64_t *a, const uint64_t *b,
+                          unsigned numWords);
+
+/**
+ * @brief Rock-paper-scissors score `K(a, b)` of two word arrays, read as
+ *  strings of two-bit cells (bits `2i` and `2i + 1` form cell `i`).  Each
+ *  cell `a` wins scores +1, each cell it loses scores -1.  The cells are
+ *  resolved 64 bits (or a whole vector register) at a time with boolean
+ *  algebra and popcounts.  Zero padding scores nothing.
+ *
+ * @param a
+ * @param b
+ * @param numWords number of words in each array
+ *
+ * @return score
+ */
+int64_t predationScoreWords(const uint64_t *a, const uint64_t *b,
+                            unsigned numWords);
+
+
+#endif /* end of include guard: KERNELS_H */
@@ -0,0 +1,414 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "agent.h"
+#include "lattice.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Helper functions                                                           *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Side of the square tiles swept by one task.  A tile of 32 x 32
+ *  cells holds as many agents as a chunk of `Ecosystem`, and the three rows
+ *  read by the mating stencil stay in cache while it crosses the tile.
+ *  Tiles have an even side, so with a domino offset of 0 only the dominoes
+ *  that wrap around the torus straddle two tiles.  With an offset of 1,
+ *  every domino on a tile edge straddles two tiles.  Such a domino is
+ *  resolved by the tile of its anchor cell, which also updates the partner
+ *  across the edge, and the tile of the partner skips it.
+ */
+static const unsigned tileSize = 32;
+
+/* Phases of a generation that draw random numbers */
+typedef enum {
+  LATTICE_ORIENTATION,
+  LATTICE_FEEDING,
+  LATTICE_STARVATION,
+  LATTICE_MATING
+} LatticePhase;
+
+/**
+ * @brief Index of the random stream used by one cell (or the pair anchored
+ *  at it) in one phase of a generation.  Cells are numbered `yW + x` over
+ *  the whole torus, so every band draws the same numbers for a cell.
+ */
+static uint64_t cellStream(uint64_t generation, LatticePhase phase,
+                           uint64_t cell) {
+  return (generation << 36) | ((uint64_t) phase << 32) | cell;
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Lattice class                                                              *
+ * -------------------------------------------------------------------------- */
+
+Lattice::Lattice(const Parameters &params, unsigned width, unsigned height,
+                 uint64_t seed, unsigned firstRow, unsigned numRows) :
+  m_parameters(params), m_width(width), m_height(height),
+  m_firstRow(firstRow), m_numRows(numRows), m_seed(seed), m_generation(0),
+  m_population(params.sizeChromosome) {
+  if (width < 4 || height < 4 || width % 2 != 0 || height % 2 != 0) {
+    throw std::invalid_argument("the sides of the lattice must be even and "
+                                "at least 4");
+  }
+
+  if (m_numRows == 0) {
+    m_numRows = height;
+  }
+
+  if (m_firstRow >= height || m_numRows > height - m_firstRow) {
+    throw std::invalid_argument("band does not fit the lattice");
+  }
+
+  if ((uint64_t) width * height > (1ULL << 32) ||
+      (uint64_t) width * (m_numRows + 2) > UINT32_MAX) {
+    throw std::invalid_argument("lattice has too many cells");
+  }
+
+  /* Slot `k` is handed out `k`th, so cells and slots line up.  The halo
+   * stays empty until the first exchange */
+  unsigned numSlots = width * (m_numRows + 2);
+  m_population.reserve(numSlots);
+  for (unsigned k = 0; k < numSlots; k++) {
+    m_population.allocate();
+  }
+
+  for (unsigned row = 1; row <= m_numRows; row++) {
+    for (unsigned x = 0; x < width; x++) {
+      m_population.setEnergy(cellSlot(x, row), params.lambdaEnergy);
+    }
+  }
+
+  for (unsigned k = 0; k < m_width * m_numRows; k++) {
+    m_entropy.add(0);
+  }
+}
+
+unsigned Lattice::bandRow(unsigned y) const {
+  unsigned offset = (y + m_height - m_firstRow) % m_height;
+  if (offset < m_numRows) {
+    return 1 + offset;
+  }
+  return offset == m_height - 1 ? 0 : m_numRows + 1;
+}
+
+unsigned Lattice::numTiles(void) const {
+  return (m_numRows + tileSize - 1) / tileSize *
+         ((m_width + tileSize - 1) / tileSize);
+}
+
+template <typename Sweep>
+void Lattice::sweepTiles(const Sweep &sweep) {
+  unsigned tileColumns = (m_width + tileSize - 1) / tileSize;
+
+  m_pool->parallelFor(numTiles(), [&](unsigned tile, unsigned thread) {
+    unsigned firstRow = 1 + tile / tileColumns * tileSize;
+    unsigned firstColumn = tile % tileColumns * tileSize;
+    sweep(tile, firstRow, std::min(firstRow + tileSize, m_numRows + 1),
+          firstColumn, std::min(firstColumn + tileSize, m_width), thread);
+  });
+}
+
+template <typename T, typename Sweep, typename Merge>
+void Lattice::reduceTiles(std::vector<T> &partials, T &result,
+                          const Sweep &sweep, const Merge &merge) {
+  unsigned tileColumns = (m_width + tileSize - 1) / tileSize;
+
+  m_pool->parallelReduce(numTiles(), partials, result,
+                         [&](unsigned tile, unsigned thread, T &partial) {
+    unsigned firstRow = 1 + tile / tileColumns * tileSize;
+    unsigned firstColumn = tile % tileColumns * tileSize;
+    sweep(firstRow, std::min(firstRow + tileSize, m_numRows + 1),
+          firstColumn, std::min(firstColumn + tileSize, m_width), thread,
+          partial);
+  }, merge);
+}
+
+void Lattice::fillAlgae(void) {
+  const unsigned numWords = m_population.stride();
+  sweepTiles([&](unsigned, unsigned firstRow, unsigned lastRow,
+                 unsigned firstColumn, unsigned lastColumn, unsigned) {
+    for (unsigned row = firstRow; row < lastRow; row++) {
+      for (unsigned x = firstColumn; x < lastColumn; x++) {
+        unsigned slot = cellSlot(x, row);
+        if (m_population.getEnergy(slot) <= 0) {
+          memset(m_population.chromosome(slot), 0,
+                 numWords * Buffer::wordBytes);
+          m_population.setNumOnes(slot, 0);
+          m_population.setEnergy(slot, m_parameters.lambdaEnergy);
+        }
+      }
+    }
+  });
+}
+
+void Lattice::feeding(void) {
+  /* One orientation and offset of the dominoes for the whole torus */
+  m_streams[0].seed(m_seed, cellStream(m_generation, LATTICE_ORIENTATION, 0));
+  uint64_t bits = m_streams[0]();
+  bool vertical = bits & 1;
+  unsigned offset = (bits >> 1) & 1;
+
+  unsigned numDead = 0;
+  reduceTiles(m_tileDeaths, numDead,
+              [&](unsigned firstRow, unsigned lastRow, unsigned firstColumn,
+                  unsigned lastColumn, unsigned thread,
+  unsigned &tileDeaths) {
+    Random &random = m_streams[thread];
+
+    for (unsigned row = firstRow; row < lastRow; row++) {
+      unsigned y = m_firstRow + row - 1;
+      for (unsigned x = firstColumn; x < lastColumn; x++) {
+
+        /* Find the other cell of the domino.  A pair is resolved by the
+         * tile of its anchor, or by the tile of its only cell in the band */
+        unsigned px = x;
+        unsigned py = y;
+        bool anchor;
+        if (vertical) {
+          anchor = (y & 1) == offset;
+          py = anchor ? (y + 1) % m_height : (y + m_height - 1) % m_height;
+        } else {
+          anchor = (x & 1) == offset;
+          px = anchor ? (x + 1) % m_width : (x + m_width - 1) % m_width;
+        }
+
+        unsigned partnerRow = bandRow(py);
+        bool partnerOwned = partnerRow >= 1 && partnerRow <= m_numRows;
+        if (!anchor && partnerOwned) {
+          continue;
+        }
+
+        unsigned slot = cellSlot(x, row);
+        unsigned partner = cellSlot(px, partnerRow);
+        unsigned a = anchor ? slot : partner;
+        unsigned b = anchor ? partner : slot;
+        uint64_t cell = anchor ? (uint64_t) y * m_width + x :
+                        (uint64_t) py * m_width + px;
+
+        random.seed(m_seed, cellStream(m_generation, LATTICE_FEEDING, cell));
+        PredationOutcome outcome = predation(m_population, a, b,
+                                             m_parameters, random);
+        if (outcome == PREDATION_FIRST_SURVIVES) {
+          m_population.setEnergy(b, 0);
+          feed(m_population, a, b, m_parameters);
+        }
+
+        if (outcome == PREDATION_SECOND_SURVIVES) {
+          m_population.setEnergy(a, 0);
+          feed(m_population, b, a, m_parameters);
+        }
+
+        /* Starvation of the cells of the band; the other band starves its
+         * own cell */
+        unsigned cells[2] = {slot, partner};
+        uint64_t indices[2] = {(uint64_t) y * m_width + x,
+                               (uint64_t) py * m_width + px
+                              };
+        for (unsigned k = 0; k < (partnerOwned ? 2 : 1); k++) {
+          if (m_population.getEnergy(cells[k]) <= 0) {
+            tileDeaths += 1;
+            continue;
+          }
+
+          random.seed(m_seed, cellStream(m_generation, LATTICE_STARVATION,
+                                         indices[k]));
+          if (starve(m_population, cells[k], m_parameters, random)) {
+            tileDeaths += 1;
+          }
+        }
+      }
+    }
+  }, [](unsigned &numDead, unsigned tileDeaths) {
+    numDead += tileDeaths;
+  });
+
+  m_survival.add(1.0 - (double) numDead / (m_width * m_numRows));
+}
+
+void Lattice::mating(void) {
+  /* Children are only born into empty cells and parents are only read from
+   * live ones, so a snapshot of the live cells keeps the tiles apart */
+  m_alive.resize(m_population.capacity());
+  for (unsigned x = 0; x < m_width; x++) {
+    m_alive[cellSlot(x, 0)] = isAlive(x, 0);
+    m_alive[cellSlot(x, m_numRows + 1)] = isAlive(x, m_numRows + 1);
+  }
+
+  sweepTiles([&](unsigned, unsigned firstRow, unsigned lastRow,
+                 unsigned firstColumn, unsigned lastColumn, unsigned) {
+    for (unsigned row = firstRow; row < lastRow; row++) {
+      for (unsigned x = firstColumn; x < lastColumn; x++) {
+        m_alive[cellSlot(x, row)] = isAlive(x, row);
+      }
+    }
+  });
+
+  m_entropy.clear();
+  reduceTiles(m_tileEntropy, m_entropy,
+              [&](unsigned firstRow, unsigned lastRow, unsigned firstColumn,
+                  unsigned lastColumn, unsigned thread,
+  RunningStatistics &entropy) {
+    Random &random = m_streams[thread];
+
+    for (unsigned row = firstRow; row < lastRow; row++) {
+      unsigned y = m_firstRow + row - 1;
+      unsigned above = bandRow((y + m_height - 1) % m_height);
+      unsigned below = bandRow((y + 1) % m_height);
+
+      for (unsigned x = firstColumn; x < lastColumn; x++) {
+        unsigned slot = cellSlot(x, row);
+        if (!m_alive[slot]) {
+          unsigned neighbours[4] = {
+            cellSlot(x, above), cellSlot(x, below),
+            cellSlot((x + m_width - 1) % m_width, row),
+            cellSlot((x + 1) % m_width, row)
+          };
+
+          unsigned parents[4];
+          unsigned numParents = 0;
+          for (unsigned k = 0; k < 4; k++) {
+            if (m_alive[neighbours[k]]) {
+              parents[numParents++] = neighbours[k];
+            }
+          }
+
+          if (numParents >= 2) {
+            random.seed(m_seed, cellStream(m_generation, LATTICE_MATING,
+                                           (uint64_t) y * m_width + x));
+            unsigned father = gsl_rng_uniform_int(random.get(), numParents);
+            unsigned mother = gsl_rng_uniform_int(random.get(),
+                                                  numParents - 1);
+            mother += mother >= father;
+
+            if (mate(m_population, parents[father], parents[mother],
+                     m_parameters, random)) {
+              crossover(m_population, parents[father], parents[mother], slot,
+                        m_parameters, random);
+              mutate(m_population, slot, m_parameters, random);
+            }
+          }
+        }
+
+        if (m_population.getEnergy(slot) > 0) {
+          entropy.add(m_population.getEntropy(slot));
+        }
+      }
+    }
+  }, [](RunningStatistics &result, const RunningStatistics &entropy) {
+    result.merge(entropy);
+  });
+}
+
+void Lattice::exchangeHalo(void) {
+  if (m_numRows < m_height) {
+    m_halo->exchange(*this);
+  }
+}
+
+void Lattice::run(unsigned numIterations, unsigned numThreads) {
+  if (m_numRows < m_height && !m_halo) {
+    throw std::runtime_error("a lattice band needs a halo exchange");
+  }
+
+  if (!m_pool || m_pool->size() != numThreads) {
+    m_pool.reset(new ThreadPool(numThreads));
+    m_streams.resize(numThreads);
+  }
+
+  for (unsigned i = 0; i < numIterations; i++) {
+    fillAlgae();
+    exchangeHalo();
+    feeding();
+    exchangeHalo();
+    mating();
+    m_generation += 1;
+  }
+}
+
+void Lattice::setHaloExchange(std::unique_ptr<HaloExchange> halo) {
+  m_halo = std::move(halo);
+}
+
+void Lattice::packRow(unsigned row, MigrantBatch &batch) const {
+  for (unsigned x = 0; x < m_width; x++) {
+    batch.append(m_population, cellSlot(x, row));
+  }
+}
+
+void Lattice::unpackRow(unsigned row, const MigrantBatch &batch,
+                        unsigned first) {
+  unsigned size = m_population.sizeChromosome();
+  if (batch.sizeChromosome() != size) {
+    throw std::runtime_error("halo row has the wrong chromosome size");
+  }
+
+  if (batch.size() < first || batch.size() - first < m_width) {
+    throw std::runtime_error("halo row is too short");
+  }
+
+  for (unsigned x = 0; x < m_width; x++) {
+    unsigned slot = cellSlot(x, row);
+    memcpy(m_population.chromosome(slot), batch.chromosome(first + x), size);
+    m_population.countOnes(slot);
+    m_population.setEnergy(slot, batch.getEnergy(first + x));
+  }
+}
+
+unsigned Lattice::width(void) const {
+  return m_width;
+}
+
+unsigned Lattice::height(void) const {
+  return m_height;
+}
+
+unsigned Lattice::firstRow(void) const {
+  return m_firstRow;
+}
+
+unsigned Lattice::numRows(void) const {
+  return m_numRows;
+}
+
+unsigned Lattice::cellSlot(unsigned x, unsigned row) const {
+  return row * m_width + x;
+}
+
+bool Lattice::isAlive(unsigned x, unsigned row) const {
+  return m_population.getEnergy(cellSlot(x, row)) > 0;
+}
+
+const Population &Lattice::getPopulation(void) const {
+  return m_population;
+}
+
+unsigned Lattice::size(void) const {
+  return m_entropy.count();
+}
+
+const Parameters &Lattice::getParameters(void) const {
+  return m_parameters;
+}
+
+uint64_t Lattice::getSeed(void) const {
+  return m_seed;
+}
+
+uint64_t Lattice::getGeneration(void) const {
+  return m_generation;
+}
+
+double Lattice::meanEntropy(void) const {
+  return m_entropy.mean();
+}
+
+double Lattice::stdevEntropy(void) const {
+  return m_entropy.stdev();
+}
+
+double Lattice::meanSurvivalFraction(void) const {
+  return m_survival.mean();
+}
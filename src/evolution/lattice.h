@@ -0,0 +1,186 @@
+#ifndef LATTICE_H
+#define LATTICE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "migrants.h"
+#include "parameters.h"
+#include "population.h"
+#include "rng.h"
+#include "statistics.h"
+#include "threadpool.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Lattice ecosystem                                                          *
+ * -------------------------------------------------------------------------- */
+
+class Lattice;
+
+/**
+ * @brief Fills the halo rows of a lattice band (see `Lattice`) with copies
+ *  of the rows just outside it, as they are in the bands that own them.
+ *  Every band of a torus calls `exchange` at the same points of every
+ *  generation, so an implementation can talk to the neighbouring bands
+ *  over any transport.
+ */
+class HaloExchange {
+ public:
+  virtual ~HaloExchange() { }
+
+  /* Fills rows `0` and `numRows() + 1` of `lattice` */
+  virtual void exchange(Lattice &lattice) = 0;
+};
+
+/**
+ * @brief A spatial ecosystem on a `width` x `height` torus with at most one
+ *  agent per cell.  Agents only meet their four nearest neighbours, so
+ *  niches can form in different regions of the lattice.  Every generation
+ *  does three sweeps over the lattice.
+ *
+ *    Sweep       What happens
+ *
+ *    Algae       Every empty cell gets a blank agent with `lambdaEnergy`
+ *    Feeding     The cells are paired off like dominoes, all horizontally
+ *                or all vertically, with a random offset.  The two members of
+ *                each pair go through `predation`, and the survivors
+ *                through `starve`.
+ *    Mating      Every empty cell picks two of its live neighbours as
+ *                parents.  If they `mate`, their child is born in the cell.
+ *
+ *  Cell `(x, y)` is stored in a fixed slot of a `Population`, and an empty
+ *  cell is just a slot without energy, so there are no slot lists: a sweep
+ *  streams through the slab in memory order, one square tile of cells at a
+ *  time.  The tiles run on a thread pool.  Every pair and every cell draws
+ *  from its own random stream, so the results do not depend on the number
+ *  of threads, nor on how the torus is split into bands.
+ *
+ *  A lattice can own the whole torus, or a band of `numRows` consecutive
+ *  rows of it, so several processes can run one torus together.  A band
+ *  stores two extra rows, its halo: row `0` mirrors the row above the band
+ *  and row `numRows + 1` the row below, while rows `1, ..., numRows` are its
+ *  own.  The halo is refreshed by a `HaloExchange` before the feeding and
+ *  mating sweeps, and pairs that straddle two bands are resolved
+ *  identically by both of them.
+ *
+ * @note The torus is limited to 2^32 cells, and runs to 2^28 generations.
+ */
+class Lattice {
+ private:
+  Parameters m_parameters;
+  unsigned m_width;
+  unsigned m_height;
+  unsigned m_firstRow;      //! First row of the band on the torus
+  unsigned m_numRows;       //! Number of rows of the band
+  uint64_t m_seed;          //! Master seed of all random streams
+  uint64_t m_generation;    //! Number of generations run so far
+
+  Population m_population;  //! Cell `(x, r)` of the band is in slot `rW + x`
+  std::vector<char> m_alive;    //! Live cells before the mating sweep
+  std::unique_ptr<HaloExchange> m_halo;
+
+  std::unique_ptr<ThreadPool> m_pool;   //! Workers of the sweeps
+  std::vector<Random> m_streams;        //! One reusable stream per thread
+  std::vector<unsigned> m_tileDeaths;   //! Partial death counts
+  std::vector<RunningStatistics> m_tileEntropy;   //! Partial entropy stats
+
+  RunningStatistics m_entropy;    //! Entropy of the live agents
+  RunningStatistics m_survival;   //! Survival fraction of each generation
+
+  /* Row of the band, halo included, that holds row `y` of the torus.  `y`
+   * must be in the band or next to it */
+  unsigned bandRow(unsigned y) const;
+
+  /* Runs `sweep(tile, firstRow, lastRow, firstColumn, lastColumn, thread)`
+   * over every tile of the band, in parallel */
+  unsigned numTiles(void) const;
+  template <typename Sweep>
+  void sweepTiles(const Sweep &sweep);
+
+  /* Same, with `sweep(..., thread, partial)` accumulating into a partial
+   * result per tile, which are merged into `result` in tile order (see
+   * `ThreadPool::parallelReduce`) */
+  template <typename T, typename Sweep, typename Merge>
+  void reduceTiles(std::vector<T> &partials, T &result, const Sweep &sweep,
+                   const Merge &merge);
+
+  void fillAlgae(void);
+  void feeding(void);
+  void mating(void);
+  void exchangeHalo(void);
+
+ public:
+
+  /**
+   * @brief Creates a lattice full of blank agents
+   *
+   * @param params `sizePopulation` is ignored: there are as many agents as
+   *  cells
+   * @param width columns of the torus, even and at least 4
+   * @param height rows of the torus, even and at least 4
+   * @param seed master seed.  Two lattices with the same parameters and seed
+   *  evolve identically.
+   * @param firstRow first row of the band
+   * @param numRows rows of the band, 0 for the whole torus
+   *
+   * @note This function throws an exception when the torus or the band does
+   *  not fit these constraints.
+   */
+  Lattice(const Parameters &params, unsigned width, unsigned height,
+          uint64_t seed = 0, unsigned firstRow = 0, unsigned numRows = 0);
+
+  /**
+   * @brief Runs `numIterations` generations.  The tiles of every sweep are
+   *  shared among `numThreads` threads.
+   *
+   * @note This function throws an exception when the lattice is a band
+   *  without a halo exchange, or when the exchange fails.
+   */
+  void run(unsigned numIterations = 1000, unsigned numThreads = 1);
+
+  /* Sets how the halo of a band is refreshed.  A lattice that owns the
+   * whole torus has no use for it */
+  void setHaloExchange(std::unique_ptr<HaloExchange> halo);
+
+  /* Appends the `width` agents of row `row` of the band (halo included) to
+   * `batch`, empty cells too */
+  void packRow(unsigned row, MigrantBatch &batch) const;
+
+  /**
+   * @brief Overwrites row `row` of the band (halo included) with agents
+   *  `first, ..., first + width - 1` of `batch`
+   *
+   * @note This function throws an exception when the batch is too short or
+   *  its chromosomes have the wrong size.
+   */
+  void unpackRow(unsigned row, const MigrantBatch &batch, unsigned first = 0);
+
+  /* Geometry of the torus and of the band */
+  unsigned width(void) const;
+  unsigned height(void) const;
+  unsigned firstRow(void) const;
+  unsigned numRows(void) const;
+
+  /* Slot of cell `x` of row `row` of the band (halo included), and whether
+   * an agent lives there */
+  unsigned cellSlot(unsigned x, unsigned row) const;
+  bool isAlive(unsigned x, unsigned row) const;
+  const Population &getPopulation(void) const;
+
+  /* Number of live agents in the band */
+  unsigned size(void) const;
+
+  /* Model parameters, master seed and number of generations run so far */
+  const Parameters &getParameters(void) const;
+  uint64_t getSeed(void) const;
+  uint64_t getGeneration(void) const;
+
+  /* Same statistics as `Ecosystem`, over the band */
+  double meanEntropy(void) const;
+  double stdevEntropy(void) const;
+  double meanSurvivalFraction(void) const;
+};
+
+
+#endif /* end of include guard: LATTICE_H */
@@ -1,3 +1,333 @@
-int main(int argc, const char *argv[]) {
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <boost/program_options.hpp>
+#include "checkpoint.h"
+#include "ecosystem.h"
+#include "lattice.h"
+#include "options.h"
+
+namespace po = boost::program_options;
+
+
+/* -------------------------------------------------------------------------- *
+ * Command line                                                               *
+ * -------------------------------------------------------------------------- */
+
+/* Settings of a run that are not model parameters */
+typedef struct {
+  unsigned numIterations;   //! Number of generations to run
+  unsigned numThreads;      //! Number of threads of the generation step
+  std::string pinning;      //! Where the threads run
+  uint64_t seed;            //! Master seed
+  unsigned interval;        //! Generations between two statistics records
+  std::string load;         //! Checkpoint to resume from
+  std::string checkpoint;   //! Where to write the final ecosystem
+  bool archive;             //! Write a Boost archive, not a flat checkpoint
+  bool compress;            //! Compress flat checkpoints
+  unsigned checkpointInterval;  //! Generations between two checkpoints
+  std::string delta;        //! Where to record the delta stream
+  unsigned fullInterval;    //! Generations between two FULL records
+  std::string profile;      //! Where to write the generation profiles
+  std::string profileFormat;    //! csv or json
+  std::string output;       //! Where to write the statistics
+  std::string pairing;      //! Pairing engine
+  unsigned latticeWidth;    //! Columns of the lattice, 0 for no lattice
+  unsigned latticeHeight;   //! Rows of the lattice
+} Settings;
+
+static po::options_description runOptions(Settings &settings) {
+  po::options_description options("Run");
+  options.add_options()
+  ("iterations,n", po::value(&settings.numIterations)->default_value(1000),
+   "number of generations to run")
+  ("threads,t", po::value(&settings.numThreads)->default_value(1),
+   "number of threads")
+  ("pinning", po::value(&settings.pinning)->default_value("none"),
+   "where the threads run: none, cores (one CPU each) or numa (threads "
+   "spread evenly over the NUMA nodes, Linux only)")
+  ("seed,s", po::value(&settings.seed)->default_value(0),
+   "master seed of the random streams")
+  ("load,l", po::value(&settings.load),
+   "resume from this checkpoint (flat or Boost archive).  The model "
+   "parameters, seed and generation count are read from it.")
+  ("checkpoint,k", po::value(&settings.checkpoint),
+   "write the ecosystem to this file when the run is over")
+  ("archive,a", po::bool_switch(&settings.archive),
+   "write the checkpoint as a Boost archive instead of the flat format")
+  ("compress,z", po::bool_switch(&settings.compress),
+   "gzip the flat checkpoints")
+  ("checkpointInterval",
+   po::value(&settings.checkpointInterval)->default_value(0),
+   "also write the checkpoint every this many generations, in the "
+   "background (0 to only write it at the end)")
+  ("delta,d", po::value(&settings.delta),
+   "record every generation in this delta stream (see `replay`)")
+  ("fullInterval", po::value(&settings.fullInterval)->default_value(100),
+   "generations between two full records of the delta stream")
+  ("profile", po::value(&settings.profile),
+   "write the time and events of every phase of every generation to this "
+   "file (needs a build configured with --enable-instrumentation)")
+  ("profileFormat", po::value(&settings.profileFormat)->default_value("csv"),
+   "format of the profiles: csv or json (JSON Lines)")
+  ("pairing", po::value(&settings.pairing)->default_value("shuffle"),
+   "pairing engine: shuffle (Fisher-Yates) or permutation (parallel "
+   "Feistel permutation, pairs in the order of their first member)")
+  ("latticeWidth", po::value(&settings.latticeWidth)->default_value(0),
+   "run a lattice (torus) of this many columns, where agents only meet "
+   "their neighbours, instead of a well-mixed ecosystem.  sizePopulation is "
+   "ignored.")
+  ("latticeHeight", po::value(&settings.latticeHeight)->default_value(0),
+   "rows of the lattice")
+  ("output,o", po::value(&settings.output),
+   "write statistics to this CSV file")
+  ("interval,i", po::value(&settings.interval)->default_value(1),
+   "generations between two lines of statistics");
+  return options;
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Reporting                                                                  *
+ * -------------------------------------------------------------------------- */
+
+/* Peak resident set size of the process in megabytes */
+static double peakRssMegabytes(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0;
+}
+
+static void writeStatisticsHeader(std::ostream &os) {
+  os << "generation,agents,meanEntropy,stdevEntropy,meanSurvivalFraction"
+     << std::endl;
+}
+
+/* Works for `Ecosystem` and `Lattice` */
+template <typename Model>
+static void writeStatistics(std::ostream &os, const Model &ecosystem) {
+  os << ecosystem.getGeneration() << ","
+     << ecosystem.size() << ","
+     << ecosystem.meanEntropy() << ","
+     << ecosystem.stdevEntropy() << ","
+     << ecosystem.meanSurvivalFraction() << std::endl;
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Driver                                                                     *
+ * -------------------------------------------------------------------------- */
+
+static int evolve(const Settings &settings, const Parameters &params) {
+  Ecosystem ecosystem;
+
+  if (!settings.load.empty() && isCheckpoint(settings.load)) {
+    ecosystem.loadCheckpoint(settings.load);
+  }
+
+  else if (!settings.load.empty()) {
+    std::ifstream ifs(settings.load, std::ios::binary);
+    if (!ifs) {
+      throw std::runtime_error("cannot open " + settings.load);
+    }
+    boost::archive::binary_iarchive ia(ifs);
+    ia >> ecosystem;
+  }
+
+  else {
+    checkParameters(params);
+    ecosystem = Ecosystem(params, settings.seed);
+  }
+
+  ecosystem.setPairingEngine(createPairingEngine(settings.pairing));
+
+  if (settings.checkpointInterval > 0) {
+    ecosystem.setCheckpoint(settings.checkpoint, settings.checkpointInterval,
+                            settings.compress);
+  }
+
+  if (!settings.delta.empty()) {
+    ecosystem.setDeltaRecording(settings.delta, settings.fullInterval);
+  }
+
+  if (!settings.profile.empty()) {
+    ecosystem.setProfile(settings.profile,
+                         parseProfileFormat(settings.profileFormat));
+  }
+
+  std::ofstream output;
+  if (!settings.output.empty()) {
+    output.open(settings.output);
+    if (!output) {
+      throw std::runtime_error("cannot open " + settings.output);
+    }
+    writeStatisticsHeader(output);
+  }
+
+  /* Every agent of a generation, including the algae topping up the
+   * population, has one predation encounter and one mating attempt */
+  const unsigned sizePopulation = ecosystem.getParameters().sizePopulation;
+  uint64_t numEvaluations = 0;
+
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (unsigned n = 0; n < settings.numIterations; n++) {
+    numEvaluations += std::max(ecosystem.size(), sizePopulation);
+    ecosystem.run(1, settings.numThreads);
+
+    if (output.is_open() && (n + 1) % settings.interval == 0) {
+      writeStatistics(output, ecosystem);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  /* The last periodic checkpoint must not land after the final one */
+  ecosystem.flushCheckpoints();
+
+  if (!settings.checkpoint.empty() && !settings.archive) {
+    ecosystem.saveCheckpoint(settings.checkpoint, settings.compress);
+  }
+
+  else if (!settings.checkpoint.empty()) {
+    std::ofstream ofs(settings.checkpoint, std::ios::binary);
+    if (!ofs) {
+      throw std::runtime_error("cannot open " + settings.checkpoint);
+    }
+    boost::archive::binary_oarchive oa(ofs);
+    oa << ecosystem;
+  }
+
+  double seconds = elapsed.count();
+  std::cout << "generations        " << settings.numIterations << std::endl
+            << "threads            " << settings.numThreads << std::endl
+            << "agents             " << ecosystem.size() << std::endl
+            << "seconds            " << seconds << std::endl
+            << "generations/sec    " << settings.numIterations / seconds
+            << std::endl
+            << "evaluations/sec    " << numEvaluations / seconds << std::endl
+            << "peak RSS (MB)      " << peakRssMegabytes() << std::endl;
   return 0;
 }
+
+/* Runs a lattice instead.  Every cell of a generation has one predation
+ * encounter, and one mating attempt if it is empty afterwards */
+static int evolveLattice(const Settings &settings, const Parameters &params) {
+  checkParameters(params);
+  Lattice lattice(params, settings.latticeWidth, settings.latticeHeight,
+                  settings.seed);
+
+  std::ofstream output;
+  if (!settings.output.empty()) {
+    output.open(settings.output);
+    if (!output) {
+      throw std::runtime_error("cannot open " + settings.output);
+    }
+    writeStatisticsHeader(output);
+  }
+
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (unsigned n = 0; n < settings.numIterations; n++) {
+    lattice.run(1, settings.numThreads);
+
+    if (output.is_open() && (n + 1) % settings.interval == 0) {
+      writeStatistics(output, lattice);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  double seconds = elapsed.count();
+  uint64_t numEvaluations = (uint64_t) settings.numIterations *
+                            settings.latticeWidth * settings.latticeHeight;
+  std::cout << "generations        " << settings.numIterations << std::endl
+            << "threads            " << settings.numThreads << std::endl
+            << "agents             " << lattice.size() << std::endl
+            << "seconds            " << seconds << std::endl
+            << "generations/sec    " << settings.numIterations / seconds
+            << std::endl
+            << "evaluations/sec    " << numEvaluations / seconds << std::endl
+            << "peak RSS (MB)      " << peakRssMegabytes() << std::endl;
+  return 0;
+}
+
+int main(int argc, const char *argv[]) {
+  Parameters params;
+  Settings settings;
+  std::string config;
+
+  po::options_description general("General");
+  general.add_options()
+  ("help,h", "print this message")
+  ("config,c", po::value(&config),
+   "read options from this file (`name = value` lines).  The command line "
+   "takes precedence.");
+
+  po::options_description fileOptions;
+  fileOptions.add(runOptions(settings)).add(modelOptions(params));
+
+  po::options_description allOptions("Usage: evolve [options]");
+  allOptions.add(general).add(fileOptions);
+
+  try {
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, allOptions), vm);
+
+    if (vm.count("help")) {
+      std::cout << allOptions << std::endl;
+      return 0;
+    }
+
+    if (vm.count("config")) {
+      std::ifstream ifs(vm["config"].as<std::string>());
+      if (!ifs) {
+        throw std::runtime_error("cannot open " +
+                                 vm["config"].as<std::string>());
+      }
+      po::store(po::parse_config_file(ifs, fileOptions), vm);
+    }
+    po::notify(vm);
+
+    if (settings.numThreads == 0 || settings.interval == 0) {
+      throw std::invalid_argument("threads and interval must be positive");
+    }
+    setThreadPinning(parseThreadPinning(settings.pinning));
+
+    if (settings.checkpointInterval > 0 && settings.checkpoint.empty()) {
+      throw std::invalid_argument("checkpointInterval needs a checkpoint");
+    }
+
+    if (!settings.delta.empty() && settings.fullInterval == 0) {
+      throw std::invalid_argument("fullInterval must be positive");
+    }
+
+    if (settings.checkpointInterval > 0 && settings.archive) {
+      throw std::invalid_argument("periodic checkpoints are never archives");
+    }
+
+    if ((settings.latticeWidth > 0) != (settings.latticeHeight > 0)) {
+      throw std::invalid_argument("a lattice needs both a width and a "
+                                  "height");
+    }
+
+    if (settings.latticeWidth > 0) {
+      if (!settings.load.empty() || !settings.checkpoint.empty() ||
+          !settings.delta.empty() || !settings.profile.empty()) {
+        throw std::invalid_argument("lattices cannot be checkpointed, "
+                                    "recorded or profiled");
+      }
+      return evolveLattice(settings, params);
+    }
+
+    return evolve(settings, params);
+  }
+
+  catch (const std::exception &e) {
+    std::cerr << "evolve: " << e.what() << std::endl;
+    return 1;
+  }
+}
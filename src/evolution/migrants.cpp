@@ -0,0 +1,120 @@
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include "migrants.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Migrant batches                                                            *
+ * -------------------------------------------------------------------------- */
+
+static const char migrantMagic[4] = {'M', 'I', 'G', 'R'};
+static const uint32_t migrantVersion = 1;
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t numAgents;
+  uint32_t sizeChromosome;
+} MigrantHeader;
+
+static MigrantHeader readHeader(const std::string &data) {
+  MigrantHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  return header;
+}
+
+MigrantBatch::MigrantBatch(unsigned sizeChromosome) {
+  clear(sizeChromosome);
+}
+
+void MigrantBatch::clear(unsigned sizeChromosome) {
+  MigrantHeader header;
+  memcpy(header.magic, migrantMagic, sizeof(migrantMagic));
+  header.version = migrantVersion;
+  header.numAgents = 0;
+  header.sizeChromosome = sizeChromosome;
+
+  m_data.assign(reinterpret_cast<const char *>(&header), sizeof(header));
+  m_recordSize = sizeof(double) + sizeChromosome;
+}
+
+const char *MigrantBatch::record(unsigned k) const {
+  return m_data.data() + sizeof(MigrantHeader) + (size_t) k * m_recordSize;
+}
+
+void MigrantBatch::append(const Population &population, unsigned slot) {
+  unsigned size = sizeChromosome();
+  if (population.sizeChromosome() != size) {
+    throw std::invalid_argument("agent does not fit the batch");
+  }
+
+  size_t offset = m_data.size();
+  m_data.resize(offset + m_recordSize);
+
+  char *record = &m_data[offset];
+  double energy = population.getEnergy(slot);
+  memcpy(record, &energy, sizeof(energy));
+  memcpy(record + sizeof(energy), population.chromosome(slot), size);
+
+  uint32_t numAgents = this->size() + 1;
+  memcpy(&m_data[offsetof(MigrantHeader, numAgents)], &numAgents,
+         sizeof(numAgents));
+}
+
+unsigned MigrantBatch::insert(Population &population, unsigned k) const {
+  unsigned size = sizeChromosome();
+  if (population.sizeChromosome() != size) {
+    throw std::invalid_argument("agent does not fit the population");
+  }
+
+  unsigned slot = population.allocate();
+  memcpy(population.chromosome(slot), chromosome(k), size);
+  population.countOnes(slot);
+  population.setEnergy(slot, getEnergy(k));
+  return slot;
+}
+
+unsigned MigrantBatch::size(void) const {
+  return readHeader(m_data).numAgents;
+}
+
+unsigned MigrantBatch::sizeChromosome(void) const {
+  return readHeader(m_data).sizeChromosome;
+}
+
+double MigrantBatch::getEnergy(unsigned k) const {
+  double energy;
+  memcpy(&energy, record(k), sizeof(energy));
+  return energy;
+}
+
+const char *MigrantBatch::chromosome(unsigned k) const {
+  return record(k) + sizeof(double);
+}
+
+std::string &MigrantBatch::data(void) {
+  return m_data;
+}
+
+const std::string &MigrantBatch::data(void) const {
+  return m_data;
+}
+
+void MigrantBatch::validate(void) {
+  if (m_data.size() < sizeof(MigrantHeader)) {
+    throw std::runtime_error("migrant batch is truncated");
+  }
+
+  MigrantHeader header = readHeader(m_data);
+  if (memcmp(header.magic, migrantMagic, sizeof(migrantMagic)) != 0 ||
+      header.version != migrantVersion) {
+    throw std::runtime_error("not a migrant batch");
+  }
+
+  m_recordSize = sizeof(double) + header.sizeChromosome;
+  if (m_data.size() != sizeof(MigrantHeader) +
+      (uint64_t) header.numAgents * m_recordSize) {
+    throw std::runtime_error("migrant batch has the wrong length");
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef MIGRANTS_H
+#define MIGRANTS_H
+
+#include <cstdint>
+#include <string>
+#include "population.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Migrant batches                                                            *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief A batch of agents packed into one contiguous message, for moving
+ *  them between processes.  All numbers are little-endian.
+ *
+ *    Offset            Size        Field
+ *
+ *    0                 4           Magic "MIGR"
+ *    4                 4           Format version
+ *    8                 4           Number of agents `n`
+ *    12                4           Chromosome size `s` in bytes
+ *    16 + k (8 + s)    8           Energy of agent `k` (IEEE 754 double)
+ *    24 + k (8 + s)    s           Chromosome of agent `k`
+ *
+ *  Unlike a Boost archive there are no per-object headers, and neither
+ *  packing nor unpacking allocates per agent: agents are copied straight
+ *  from and into population slots, and a batch reused for the next message
+ *  keeps its memory.
+ */
+class MigrantBatch {
+ private:
+  std::string m_data;
+  unsigned m_recordSize;    //! Bytes per agent
+
+  const char *record(unsigned k) const;
+
+ public:
+
+  /* Creates an empty batch of agents with `sizeChromosome` bytes */
+  MigrantBatch(unsigned sizeChromosome = 0);
+
+  /* Empties the batch, keeping its memory */
+  void clear(unsigned sizeChromosome);
+
+  /* Appends a copy of the agent in `slot` */
+  void append(const Population &population, unsigned slot);
+
+  /**
+   * @brief Copies agent `k` into a new slot of `population`
+   *
+   * @return slot index
+   */
+  unsigned insert(Population &population, unsigned k) const;
+
+  /* Number of agents, and bytes per chromosome */
+  unsigned size(void) const;
+  unsigned sizeChromosome(void) const;
+
+  /* Energy and chromosome bytes of agent `k` */
+  double getEnergy(unsigned k) const;
+  const char *chromosome(unsigned k) const;
+
+  /**
+   * @brief The message itself.  A received message can be swapped in, and
+   *  must then be checked with `validate`.
+   */
+  std::string &data(void);
+  const std::string &data(void) const;
+
+  /**
+   * @brief Checks the header and the length of the message
+   *
+   * @note This function throws an exception when the message is not a
+   *  valid batch.
+   */
+  void validate(void);
+};
+
+
+#endif /* end of include guard: MIGRANTS_H */
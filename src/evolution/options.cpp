@@ -0,0 +1,48 @@
+#include <stdexcept>
+#include "options.h"
+
+namespace po = boost::program_options;
+
+
+/* -------------------------------------------------------------------------- *
+ * Command line options                                                       *
+ * -------------------------------------------------------------------------- */
+
+po::options_description modelOptions(Parameters &params) {
+  po::options_description options("Model parameters");
+  options.add_options()
+  ("sizePopulation", po::value(&params.sizePopulation)->default_value(1000),
+   "maximum number of agents in the population")
+  ("sizeChromosome", po::value(&params.sizeChromosome)->default_value(128),
+   "number of bytes in each agent's chromosome")
+  ("muNumMutations", po::value(&params.muNumMutations)->default_value(2.0),
+   "mean number of mutations per child")
+  ("muNumCrossovers", po::value(&params.muNumCrossovers)->default_value(1.5),
+   "mean number of crossovers per child")
+  ("lambdaEnergy", po::value(&params.lambdaEnergy)->default_value(3.0),
+   "energy given to every child at birth")
+  ("sigmaPredation", po::value(&params.sigmaPredation)->default_value(1.0),
+   "standard deviation of the predation noise")
+  ("lambdaPredation", po::value(&params.lambdaPredation)->default_value(0.1),
+   "escape rate of the prey")
+  ("lambdaScoreFeed", po::value(&params.lambdaScoreFeed)->default_value(1.0),
+   "energy gained per bit of prey entropy")
+  ("lambdaEntropyFeed",
+   po::value(&params.lambdaEntropyFeed)->default_value(1.0),
+   "parameter of `feed` operations")
+  ("muEnergyStarve", po::value(&params.muEnergyStarve)->default_value(1.0),
+   "mean energy required to survive a starvation round")
+  ("muMating", po::value(&params.muMating)->default_value(0.5),
+   "average selectivity for mating, in (0, 1)");
+  return options;
+}
+
+void checkParameters(const Parameters &params) {
+  if (params.sizeChromosome == 0) {
+    throw std::invalid_argument("sizeChromosome must be positive");
+  }
+
+  if (!(params.muMating > 0 && params.muMating < 1)) {
+    throw std::invalid_argument("muMating must be in (0, 1)");
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <boost/program_options.hpp>
+#include "parameters.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Command line options                                                       *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Options for every field of `Parameters`, shared by the programs that
+ *  run ecosystems.  They are named after the fields, so a config file reads
+ *  like the struct.
+ */
+boost::program_options::options_description modelOptions(Parameters &params);
+
+/**
+ * @brief Checks the parameters that would make the model misbehave
+ *
+ * @note This function throws an exception when a parameter is out of range.
+ */
+void checkParameters(const Parameters &params);
+
+
+#endif /* end of include guard: OPTIONS_H */
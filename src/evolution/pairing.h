@@ -0,0 +1,105 @@
+#ifndef PAIRING_H
+#define PAIRING_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "population.h"
+#include "rng.h"
+#include "threadpool.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Pairing engines                                                            *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Decides who meets whom.  Twice per generation (before the feeding
+ *  and the mating rounds) the ecosystem asks its engine to rearrange the
+ *  live slots so that agents `2k` and `2k + 1` of the order form pair `k`.
+ *  With an odd number of agents the last one sits the round out.
+ *
+ *  Engines must be deterministic functions of their arguments, so runs stay
+ *  reproducible.  They may look at the agents in the population, so spatial
+ *  or assortative pairing can be added later.
+ *
+ *    Engine              Pairing
+ *
+ *    ShufflePairing      Fisher-Yates shuffle of the order (the default)
+ *    PermutationPairing  Keyed Feistel permutation of the order, generated
+ *                        in parallel.  Pairs keep the relative order of
+ *                        their first member.
+ *
+ *  Engines must only depend on the sequence of agents in the order, not on
+ *  the slots they occupy: a checkpoint keeps the order but not the slots,
+ *  and a resumed run has to pair exactly as the original one.
+ */
+class PairingEngine {
+ public:
+  virtual ~PairingEngine() { }
+
+  /**
+   * @brief Rearranges `order` into pairs
+   *
+   * @param population the agents, for engines that look at them
+   * @param order live slots, in any order
+   * @param seed master seed of the ecosystem
+   * @param stream random stream reserved for this call
+   * @param pool threads the engine may use
+   */
+  virtual void arrange(const Population &population, SlotVector &order,
+                       uint64_t seed, uint64_t stream, ThreadPool &pool) = 0;
+
+  /* Human readable name, e.g. "shuffle" */
+  virtual const char *name(void) const = 0;
+};
+
+/**
+ * @brief Uniformly random pairs from a Fisher-Yates shuffle.  O(n) but
+ *  serial, and it scatters the order over the slab.
+ */
+class ShufflePairing : public PairingEngine {
+ private:
+  Random m_random;
+
+ public:
+  void arrange(const Population &population, SlotVector &order,
+               uint64_t seed, uint64_t stream, ThreadPool &pool);
+  const char *name(void) const;
+};
+
+/**
+ * @brief Uniformly random pairs from a keyed bijection of `[0, n)`: an
+ *  8-round Feistel network over the smallest number of bits that covers
+ *  `n`, cycle-walked back into range.  The permutation is computed
+ *  on the fly, so every chunk of pairs is generated independently.
+ *
+ *  Each position of the order is paired with the position next to it in
+ *  the permutation.  Pairs are emitted in the order of their first member,
+ *  so an order that follows the slab (as it does after loading a
+ *  checkpoint) is swept forwards for half of the accesses.  A keyed coin
+ *  decides which member comes first in its pair, so no position is
+ *  favoured.
+ */
+class PermutationPairing : public PairingEngine {
+ private:
+  Random m_random;
+  SlotVector m_slots;               //! Copy of the order being arranged
+  SlotVector m_partners;            //! Position of each position's partner
+  std::vector<unsigned> m_chunkPairs;   //! Pairs emitted by each chunk
+
+ public:
+  void arrange(const Population &population, SlotVector &order,
+               uint64_t seed, uint64_t stream, ThreadPool &pool);
+  const char *name(void) const;
+};
+
+/**
+ * @brief Creates the engine called `name` ("shuffle" or "permutation")
+ *
+ * @note This function throws an exception when there is no such engine.
+ */
+std::unique_ptr<PairingEngine> createPairingEngine(const std::string &name);
+
+
+#endif /* end of include guard: PAIRING_H */
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include "kernels.h"
+#include "population.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Population arena                                                           *
+ * -------------------------------------------------------------------------- */
+
+Population::Population(unsigned sizeChromosome) {
+  m_sizeChromosome = sizeChromosome;
+  m_stride = Buffer::paddedNumWords(sizeChromosome);
+  m_capacity = 0;
+  m_slab = nullptr;
+  m_energy = nullptr;
+  m_numOnes = nullptr;
+}
+
+Population::Population(unsigned sizeChromosome, unsigned numSlots,
+                       unsigned capacity, Buffer::Word *slab, double *energy,
+                       unsigned *numOnes, std::shared_ptr<void> external) {
+  if (numSlots > capacity) {
+    throw std::invalid_argument("more slots in use than the capacity");
+  }
+
+  m_sizeChromosome = sizeChromosome;
+  m_stride = Buffer::paddedNumWords(sizeChromosome);
+  m_capacity = capacity;
+  m_slab = slab;
+  m_energy = energy;
+  m_numOnes = numOnes;
+  m_external = external;
+
+  for (unsigned slot = capacity; slot > numSlots; slot--) {
+    m_free.push_back(slot - 1);
+  }
+}
+
+Population::Population(const Population &other) :
+  Population(other.m_sizeChromosome) {
+  reserve(other.m_capacity);
+  m_free = other.m_free;
+
+  if (m_capacity > 0) {
+    memcpy(m_slab, other.m_slab,
+           (size_t) m_capacity * m_stride * Buffer::wordBytes);
+    memcpy(m_energy, other.m_energy, m_capacity * sizeof(double));
+    memcpy(m_numOnes, other.m_numOnes, m_capacity * sizeof(unsigned));
+  }
+}
+
+Population::Population(Population &&other) : Population() {
+  swap(other);
+}
+
+Population &Population::operator= (const Population &other) {
+  Population copy(other);
+  swap(copy);
+  return *this;
+}
+
+Population &Population::operator= (Population &&other) {
+  swap(other);
+  return *this;
+}
+
+void Population::swap(Population &other) {
+  std::swap(m_sizeChromosome, other.m_sizeChromosome);
+  std::swap(m_stride, other.m_stride);
+  std::swap(m_capacity, other.m_capacity);
+  std::swap(m_slab, other.m_slab);
+  std::swap(m_energy, other.m_energy);
+  std::swap(m_numOnes, other.m_numOnes);
+  m_free.swap(other.m_free);
+  m_slabStorage.swap(other.m_slabStorage);
+  m_energyStorage.swap(other.m_energyStorage);
+  m_numOnesStorage.swap(other.m_numOnesStorage);
+  m_external.swap(other.m_external);
+}
+
+bool Population::isExternal(void) const {
+  return (bool) m_external;
+}
+
+unsigned Population::sizeChromosome(void) const {
+  return m_sizeChromosome;
+}
+
+unsigned Population::stride(void) const {
+  return m_stride;
+}
+
+unsigned Population::capacity(void) const {
+  return m_capacity;
+}
+
+unsigned Population::size(void) const {
+  return capacity() - m_free.size();
+}
+
+void Population::reserve(unsigned numSlots) {
+  unsigned oldCapacity = capacity();
+  if (numSlots <= oldCapacity) {
+    return;
+  }
+
+  /* Move out of external memory */
+  if (m_external) {
+    m_slabStorage.assign(m_slab, m_slab + (size_t) oldCapacity * m_stride);
+    m_energyStorage.assign(m_energy, m_energy + oldCapacity);
+    m_numOnesStorage.assign(m_numOnes, m_numOnes + oldCapacity);
+    m_external.reset();
+  }
+
+  m_slabStorage.resize((size_t) numSlots * m_stride, 0);
+  m_energyStorage.resize(numSlots, 0);
+  m_numOnesStorage.resize(numSlots, 0);
+
+  m_capacity = numSlots;
+  m_slab = m_slabStorage.data();
+  m_energy = m_energyStorage.data();
+  m_numOnes = m_numOnesStorage.data();
+
+  /* Push in reverse, so the lowest slot is handed out first */
+  for (unsigned slot = numSlots; slot > oldCapacity; slot--) {
+    m_free.push_back(slot - 1);
+  }
+}
+
+unsigned Population::allocate(bool zero) {
+  if (m_free.empty()) {
+    reserve(capacity() < 8 ? 8 : 2 * capacity());
+  }
+
+  unsigned slot = m_free.back();
+  m_free.pop_back();
+
+  if (zero) {
+    memset(chromosome(slot), 0, m_stride * Buffer::wordBytes);
+    m_numOnes[slot] = 0;
+  }
+  m_energy[slot] = 0;
+  return slot;
+}
+
+void Population::release(unsigned slot) {
+  m_free.push_back(slot);
+}
+
+void Population::openClaims(unsigned count) {
+  unsigned numFree = m_free.size();
+  if (count <= numFree) {
+    return;
+  }
+
+  /* The new slots go under the free ones, since `allocate` only grows once
+   * the free list is empty */
+  reserve(capacity() + count - numFree);
+  std::rotate(m_free.begin(), m_free.begin() + numFree, m_free.end());
+}
+
+void Population::closeClaims(unsigned numClaimed) {
+  m_free.resize(m_free.size() - numClaimed);
+}
+
+void Population::clear(void) {
+  m_free.clear();
+  for (unsigned slot = capacity(); slot > 0; slot--) {
+    m_free.push_back(slot - 1);
+  }
+}
+
+unsigned Population::insert(const Agent &agent) {
+  const Buffer &c = agent.getChromosomeConst();
+  if (c.size() != m_sizeChromosome) {
+    throw std::invalid_argument("agent does not fit the population");
+  }
+
+  unsigned slot = allocate();
+  memcpy(chromosome(slot), c.words(), m_stride * Buffer::wordBytes);
+  m_energy[slot] = agent.getEnergy();
+  m_numOnes[slot] = agent.getNumOnes();
+  return slot;
+}
+
+Agent Population::getAgent(unsigned slot) const {
+  const char *bytes = reinterpret_cast<const char *>(chromosome(slot));
+  Agent agent(Buffer(bytes, m_sizeChromosome), m_energy[slot]);
+  agent.setNumOnes(m_numOnes[slot]);
+  return agent;
+}
+
+void Population::countOnes(unsigned slot) {
+  m_numOnes[slot] = popcountWords(chromosome(slot), m_stride);
+}
@@ -0,0 +1,193 @@
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <memory>
+#include <vector>
+#include "agent.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Population arena                                                           *
+ * -------------------------------------------------------------------------- */
+
+/* List of slots, e.g. the live agents in pairing order */
+typedef std::vector<unsigned> SlotVector;
+
+/**
+ * @brief Structure-of-arrays store for the agents of an ecosystem.  All
+ *  chromosomes live in one contiguous slab with a fixed stride of whole
+ *  `Buffer` blocks (so every slot is 64-byte aligned and zero padded, just
+ *  like a `Buffer`), next to a parallel array of energies.  An agent is
+ *  identified by its slot index.  Slots of dead agents go on a free list and
+ *  are handed out again before the slab grows.
+ *
+ *  The Hamming weight of every chromosome is cached in a third array, so
+ *  entropies are O(1).  Code that writes through `chromosome()` must keep
+ *  it up to date with `setNumOnes` or `countOnes`.
+ *
+ *  The arrays are normally owned by the population, but it can also be laid
+ *  over external memory, such as a memory-mapped checkpoint.  Growing past
+ *  the external capacity moves everything into owned memory.
+ *
+ * @note Growing the slab (`allocate` with an empty free list, or `reserve`)
+ *  invalidates chromosome pointers, so it must not race with readers.
+ */
+class Population {
+ private:
+  unsigned m_sizeChromosome;    //! Bytes per chromosome
+  unsigned m_stride;            //! Words per slot
+  unsigned m_capacity;          //! Number of slots
+  Buffer::Word *m_slab;         //! Chromosomes, `m_stride` words per slot
+  double *m_energy;             //! Energy of the agent in each slot
+  unsigned *m_numOnes;          //! Hamming weight of each chromosome
+  SlotVector m_free;            //! Released slots, reused last-in first-out
+
+  /* Owned memory behind the arrays above, unless they are external */
+  Buffer::WordVector m_slabStorage;
+  std::vector<double> m_energyStorage;
+  std::vector<unsigned> m_numOnesStorage;
+  std::shared_ptr<void> m_external;   //! Keeps external memory alive
+
+ public:
+
+  /**
+   * @brief Creates an empty population
+   *
+   * @param sizeChromosome size of every chromosome in bytes
+   */
+  Population(unsigned sizeChromosome = 0);
+
+  /**
+   * @brief Lays a population over external memory without copying it.  The
+   *  slots `[0, numSlots)` are in use and `[numSlots, capacity)` are free.
+   *
+   * @param sizeChromosome size of every chromosome in bytes
+   * @param numSlots number of slots in use
+   * @param capacity number of slots the arrays can hold
+   * @param slab `capacity * stride()` words, 64-byte aligned, zero padded
+   * @param energy `capacity` energies
+   * @param numOnes `capacity` Hamming weights
+   * @param external owner of the memory, kept alive as long as the
+   *  population uses it
+   */
+  Population(unsigned sizeChromosome, unsigned numSlots, unsigned capacity,
+             Buffer::Word *slab, double *energy, unsigned *numOnes,
+             std::shared_ptr<void> external);
+
+  /* Copies always own their memory */
+  Population(const Population &other);
+  Population(Population &&other);
+  Population &operator= (const Population &other);
+  Population &operator= (Population &&other);
+
+  void swap(Population &other);
+
+  /* Whether the arrays live in external memory */
+  bool isExternal(void) const;
+
+  /* Layout */
+  unsigned sizeChromosome(void) const;
+  unsigned stride(void) const;
+
+  /* Number of slots, live or free */
+  unsigned capacity(void) const;
+
+  /* Number of slots in use */
+  unsigned size(void) const;
+
+  /**
+   * @brief Grows the slab to at least `numSlots` slots.  The new slots go on
+   *  the free list.
+   */
+  void reserve(unsigned numSlots);
+
+  /**
+   * @brief Hands out a slot with a zeroed chromosome and zero energy
+   *
+   * @param zero when false the old contents (and their cached Hamming
+   *  weight) are left in place, for callers that overwrite the whole slot
+   *  anyway
+   *
+   * @return slot index
+   */
+  unsigned allocate(bool zero = true);
+
+  /* Returns a slot to the free list */
+  void release(unsigned slot);
+
+  /**
+   * @brief Concurrent allocation, for rounds where many threads create
+   *  agents.  `openClaims(count)` makes sure that `count` slots are free,
+   *  growing the slab if needed.  Until `closeClaims`, any thread can then
+   *  take the slot `claim(j)`, for `j < count`, without synchronization: it
+   *  is the slot that the `j`th call of `allocate` would hand out, so
+   *  distinct indices give distinct slots, and the slots do not depend on
+   *  which thread takes them.  `closeClaims(numClaimed)` takes claims
+   *  `0, ..., numClaimed - 1` off the free list in O(1); the others stay
+   *  free.
+   *
+   * @note Claimed slots keep their old contents, as with `allocate(false)`.
+   *  Nothing else may allocate, release or grow while claims are open.
+   */
+  void openClaims(unsigned count);
+
+  unsigned claim(unsigned index) const {
+    return m_free[m_free.size() - 1 - index];
+  }
+
+  void closeClaims(unsigned numClaimed);
+
+  /* Releases every slot */
+  void clear(void);
+
+  /* Chromosome of the agent in `slot`, `stride()` words long */
+  Buffer::Word *chromosome(unsigned slot) {
+    return m_slab + (size_t) slot * m_stride;
+  }
+
+  const Buffer::Word *chromosome(unsigned slot) const {
+    return m_slab + (size_t) slot * m_stride;
+  }
+
+  /* Getter and setter for the energy */
+  double getEnergy(unsigned slot) const {
+    return m_energy[slot];
+  }
+
+  void setEnergy(unsigned slot, double energy) {
+    m_energy[slot] = energy;
+  }
+
+  /* Getter and setter for the cached Hamming weight */
+  unsigned getNumOnes(unsigned slot) const {
+    return m_numOnes[slot];
+  }
+
+  void setNumOnes(unsigned slot, unsigned numOnes) {
+    m_numOnes[slot] = numOnes;
+  }
+
+  /* Recounts the Hamming weight of `slot` from its chromosome */
+  void countOnes(unsigned slot);
+
+  /* Shannon entropy of the chromosome, from the cached Hamming weight */
+  double getEntropy(unsigned slot) const {
+    return shannonEntropy(m_numOnes[slot], 8 * m_sizeChromosome);
+  }
+
+  /**
+   * @brief Copies `agent` into a new slot.
+   *
+   * @note This function throws an exception when the chromosome size does
+   *  not match the population.
+   *
+   * @return slot index
+   */
+  unsigned insert(const Agent &agent);
+
+  /* Copies the agent in `slot` out of the population */
+  Agent getAgent(unsigned slot) const;
+};
+
+
+#endif /* end of include guard: POPULATION_H */
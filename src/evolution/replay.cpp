@@ -0,0 +1,148 @@
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <boost/program_options.hpp>
+#include "delta.h"
+
+namespace po = boost::program_options;
+
+
+/* -------------------------------------------------------------------------- *
+ * Command line                                                               *
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+  std::string stream;       //! Delta stream to read
+  uint64_t generation;      //! Generation to rebuild
+  bool last;                //! Rebuild the last generation of the stream
+  std::string output;       //! Where to write the rebuilt checkpoint
+  bool compress;            //! Compress the checkpoint
+  std::string lineage;      //! Where to write the births and deaths
+} Settings;
+
+static void writeLineageHeader(std::ostream &os) {
+  os << "generation,event,id,father,mother" << std::endl;
+}
+
+/* Parents of algae are left empty */
+static void writeParent(std::ostream &os, uint64_t parent) {
+  if (parent != noParent) {
+    os << parent;
+  }
+}
+
+static void writeLineage(std::ostream &os, const DeltaReader &reader) {
+  const std::vector<DeltaBirth> &births = reader.getBirths();
+  for (unsigned n = 0; n < births.size(); n++) {
+    os << reader.getGeneration() << ",birth," << births[n].id << ",";
+    writeParent(os, births[n].father);
+    os << ",";
+    writeParent(os, births[n].mother);
+    os << std::endl;
+  }
+
+  const std::vector<uint64_t> &deaths = reader.getDeaths();
+  for (unsigned n = 0; n < deaths.size(); n++) {
+    os << reader.getGeneration() << ",death," << deaths[n] << ",,"
+       << std::endl;
+  }
+}
+
+
+/* -------------------------------------------------------------------------- *
+ * Driver                                                                     *
+ * -------------------------------------------------------------------------- */
+
+static int replay(const Settings &settings) {
+  DeltaReader reader(settings.stream);
+  bool found = false;
+
+  /* The lineage needs every record, so it reads the stream from the start */
+  if (!settings.lineage.empty()) {
+    std::ofstream lineage(settings.lineage);
+    if (!lineage) {
+      throw std::runtime_error("cannot open " + settings.lineage);
+    }
+    writeLineageHeader(lineage);
+
+    while (reader.next()) {
+      writeLineage(lineage, reader);
+      found = settings.last ||
+              reader.getGeneration() == settings.generation;
+      if (!settings.last && reader.getGeneration() >= settings.generation) {
+        break;
+      }
+    }
+  }
+
+  else if (settings.last) {
+    while (reader.next()) {
+      found = true;
+    }
+  }
+
+  else {
+    found = reader.seek(settings.generation);
+  }
+
+  if (settings.last && !found) {
+    throw std::runtime_error(settings.stream + " has no records");
+  }
+
+  if (!settings.last && !found) {
+    throw std::invalid_argument("the stream does not contain generation " +
+                                std::to_string(settings.generation));
+  }
+
+  if (!settings.output.empty()) {
+    reader.saveCheckpoint(settings.output, settings.compress);
+  }
+
+  std::cout << "generation         " << reader.getGeneration() << std::endl
+            << "agents             " << reader.getOrder().size() << std::endl;
+  return 0;
+}
+
+int main(int argc, const char *argv[]) {
+  Settings settings;
+
+  po::options_description options("Usage: replay [options] stream");
+  options.add_options()
+  ("help,h", "print this message")
+  ("stream", po::value(&settings.stream)->required(),
+   "delta stream written by `evolve --delta`")
+  ("generation,g", po::value(&settings.generation),
+   "generation to rebuild (default: the last one in the stream)")
+  ("output,o", po::value(&settings.output),
+   "write the rebuilt generation to this flat checkpoint, which `evolve "
+   "--load` can resume from")
+  ("compress,z", po::bool_switch(&settings.compress),
+   "gzip the checkpoint")
+  ("lineage", po::value(&settings.lineage),
+   "write every birth (with its parents) and death up to the generation to "
+   "this CSV file");
+
+  po::positional_options_description positional;
+  positional.add("stream", 1);
+
+  try {
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options)
+              .positional(positional).run(), vm);
+
+    if (vm.count("help")) {
+      std::cout << options << std::endl;
+      return 0;
+    }
+    po::notify(vm);
+
+    settings.last = !vm.count("generation");
+    return replay(settings);
+  }
+
+  catch (const std::exception &e) {
+    std::cerr << "replay: " << e.what() << std::endl;
+    return 1;
+  }
+}
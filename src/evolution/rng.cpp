@@ -0,0 +1,135 @@
+#include <cmath>
+#include "rng.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Counter-based generator                                                    *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief State of the counter-based generator.  Output `n` of a stream is
+ *  `mix(key + mix(n))`, where `mix` is the SplitMix64 finalizer (a bijection
+ *  on 64-bit words).
+ */
+typedef struct {
+  uint64_t key;
+  uint64_t counter;
+} CounterState;
+
+static inline uint64_t mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t counterNext(CounterState *state) {
+  return mix64(state->key + mix64(state->counter++));
+}
+
+static inline void counterSeed(CounterState *state, uint64_t seed,
+                               uint64_t stream) {
+  state->key = mix64(mix64(seed) ^ (stream + 0x9e3779b97f4a7c15ULL));
+  state->counter = 0;
+}
+
+static void counterSet(void *state, unsigned long int seed) {
+  counterSeed(static_cast<CounterState *>(state), seed, 0);
+}
+
+static unsigned long int counterGet(void *state) {
+  return counterNext(static_cast<CounterState *>(state));
+}
+
+static double counterGetDouble(void *state) {
+  /* 53 random bits, in [0, 1) */
+  uint64_t x = counterNext(static_cast<CounterState *>(state));
+  return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static const gsl_rng_type counterType = {
+  "counter",              /* name */
+  (unsigned long) -1,     /* RAND_MAX */
+  0,                      /* RAND_MIN */
+  sizeof(CounterState),
+  &counterSet,
+  &counterGet,
+  &counterGetDouble
+};
+
+const gsl_rng_type *counterRngType = &counterType;
+
+
+/* -------------------------------------------------------------------------- *
+ * Random streams                                                             *
+ * -------------------------------------------------------------------------- */
+
+Random::Random(uint64_t seed, uint64_t stream) {
+  m_rng = gsl_rng_alloc(counterRngType);
+  this->seed(seed, stream);
+}
+
+Random::Random(const Random &obj) {
+  m_rng = gsl_rng_clone(obj.m_rng);
+}
+
+Random &Random::operator= (const Random &obj) {
+  gsl_rng_memcpy(m_rng, obj.m_rng);
+  return *this;
+}
+
+Random::~Random() {
+  gsl_rng_free(m_rng);
+}
+
+void Random::seed(uint64_t seed, uint64_t stream) {
+  counterSeed(static_cast<CounterState *>(m_rng->state), seed, stream);
+}
+
+Random::result_type Random::operator()(void) {
+  return counterNext(static_cast<CounterState *>(m_rng->state));
+}
+
+void Random::uniforms(double *values, unsigned count) {
+  CounterState *state = static_cast<CounterState *>(m_rng->state);
+  const uint64_t key = state->key;
+  const uint64_t counter = state->counter;
+
+  for (unsigned k = 0; k < count; k++) {
+    uint64_t x = mix64(key + mix64(counter + k));
+    values[k] = (x >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  state->counter = counter + count;
+}
+
+void Random::gaussians(double sigma, double *values, unsigned count) {
+  CounterState *state = static_cast<CounterState *>(m_rng->state);
+  const uint64_t key = state->key;
+  const uint64_t counter = state->counter;
+  const double twoPi = 6.283185307179586;
+
+  /* Uniforms first, in a loop without dependencies between iterations.  The
+   * first of each pair is in (0, 1], so its logarithm is finite */
+  unsigned numPairs = (count + 1) / 2;
+  for (unsigned k = 0; k < count; k++) {
+    uint64_t x = mix64(key + mix64(counter + k));
+    values[k] = ((x >> 11) + (k % 2 == 0)) * (1.0 / 9007199254740992.0);
+  }
+
+  for (unsigned k = 0; 2 * k + 1 < count; k++) {
+    double radius = sigma * sqrt(-2.0 * log(values[2 * k]));
+    double angle = twoPi * values[2 * k + 1];
+    values[2 * k] = radius * cos(angle);
+    values[2 * k + 1] = radius * sin(angle);
+  }
+
+  /* Odd count: the partner of the last uniform is drawn but not kept */
+  if (count % 2 == 1) {
+    uint64_t x = mix64(key + mix64(counter + count));
+    double angle = twoPi * ((x >> 11) * (1.0 / 9007199254740992.0));
+    values[count - 1] = sigma * sqrt(-2.0 * log(values[count - 1])) *
+                        cos(angle);
+  }
+
+  state->counter = counter + 2 * numPairs;
+}
@@ -0,0 +1,96 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+#include <gsl/gsl_rng.h>
+
+
+/* -------------------------------------------------------------------------- *
+ * Random number streams                                                      *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief A reusable stream of random numbers, passed explicitly to every
+ *  genetics operation.
+ *
+ *  The underlying GSL generator is allocated once, when the stream is
+ *  constructed.  It is a counter-based generator: the `n`th output of stream
+ *  `(seed, stream)` is a pure function of `seed`, `stream` and `n`, so
+ *  `seed()` re-keys the generator in O(1) without touching the heap.  This
+ *  lets the caller hand out one independent stream per unit of work (e.g. per
+ *  generation and chunk of agents), which keeps a run reproducible from a
+ *  single master seed no matter which thread ends up doing the work.
+ *
+ *  The class also models the standard `UniformRandomBitGenerator` concept,
+ *  so it can be used with `std::shuffle`.
+ */
+class Random {
+ private:
+  gsl_rng *m_rng;
+
+ public:
+  typedef uint64_t result_type;
+
+  /**
+   * @brief Allocates a new stream
+   *
+   * @param seed master seed
+   * @param stream index of the stream derived from the master seed
+   */
+  Random(uint64_t seed = 0, uint64_t stream = 0);
+
+  /* Copies the position in the stream as well as the key */
+  Random(const Random &obj);
+  Random &operator= (const Random &obj);
+
+  ~Random();
+
+  /**
+   * @brief Re-keys the generator to the start of stream `stream` of the
+   *  master seed `seed`.  Does not allocate.
+   */
+  void seed(uint64_t seed, uint64_t stream = 0);
+
+  /* Generator to pass to the `gsl_ran_*` functions */
+  gsl_rng *get(void) const {
+    return m_rng;
+  }
+
+  /* UniformRandomBitGenerator interface */
+  static constexpr result_type min(void) {
+    return 0;
+  }
+
+  static constexpr result_type max(void) {
+    return UINT64_MAX;
+  }
+
+  result_type operator()(void);
+
+  /**
+   * @brief Fills `values` with `count` uniforms in `[0, 1)`, the same numbers
+   *  as `count` calls of `gsl_rng_uniform`, in a loop the compiler can
+   *  vectorize
+   */
+  void uniforms(double *values, unsigned count);
+
+  /**
+   * @brief Fills `values` with `count` independent samples of the normal
+   *  distribution `N(0, sigma^2)`.  The samples come from the Box-Muller
+   *  transform of uniforms read straight from the counter, two at a time,
+   *  in plain loops without calls through the GSL, so a batch is much
+   *  cheaper than `count` calls of `gsl_ran_gaussian`.  It advances the
+   *  stream by `count` rounded up to even.
+   */
+  void gaussians(double sigma, double *values, unsigned count);
+};
+
+
+/**
+ * @brief The GSL generator type behind `Random`.  Exposed so that plain
+ *  `gsl_rng` code can use it too.
+ */
+extern const gsl_rng_type *counterRngType;
+
+
+#endif /* end of include guard: RNG_H */
@@ -0,0 +1,53 @@
+#include <cmath>
+#include "statistics.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Running statistics                                                         *
+ * -------------------------------------------------------------------------- */
+
+RunningStatistics::RunningStatistics() {
+  clear();
+}
+
+void RunningStatistics::clear(void) {
+  m_count = 0;
+  m_mean = 0;
+  m_m2 = 0;
+}
+
+void RunningStatistics::add(double x) {
+  m_count += 1;
+  double delta = x - m_mean;
+  m_mean += delta / m_count;
+  m_m2 += delta * (x - m_mean);
+}
+
+void RunningStatistics::merge(const RunningStatistics &other) {
+  if (other.m_count == 0) {
+    return;
+  }
+
+  double count = m_count + other.m_count;
+  double delta = other.m_mean - m_mean;
+
+  m_mean += delta * other.m_count / count;
+  m_m2 += other.m_m2 + delta * delta * m_count * other.m_count / count;
+  m_count = count;
+}
+
+double RunningStatistics::count(void) const {
+  return m_count;
+}
+
+double RunningStatistics::mean(void) const {
+  return m_mean;
+}
+
+double RunningStatistics::variance(void) const {
+  return (m_count > 0) ? m_m2 / m_count : 0;
+}
+
+double RunningStatistics::stdev(void) const {
+  return sqrt(variance());
+}
@@ -0,0 +1,48 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+
+/* -------------------------------------------------------------------------- *
+ * Running statistics                                                         *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Single-pass mean and variance of a stream of values.  Values are
+ *  added with Welford's update, and two partial results are combined with
+ *  Chan's formula, so a stream can be split into chunks that are reduced
+ *  independently (e.g. on different threads) and merged afterwards without
+ *  losing precision.  Merging the chunks in a fixed order gives the same
+ *  result no matter which thread reduced which chunk.
+ */
+class RunningStatistics {
+ private:
+  double m_count;   //! Number of values
+  double m_mean;    //! Mean of the values
+  double m_m2;      //! Sum of squared deviations from the mean
+
+ public:
+  RunningStatistics();
+
+  /* Forgets all values */
+  void clear(void);
+
+  /* Adds one value */
+  void add(double x);
+
+  /* Adds all the values summarized by `other` */
+  void merge(const RunningStatistics &other);
+
+  /* Number of values */
+  double count(void) const;
+
+  /* Mean of the values, or 0 when there are none */
+  double mean(void) const;
+
+  /* Population variance and standard deviation (normalized by the number
+   * of values), or 0 when there are none */
+  double variance(void) const;
+  double stdev(void) const;
+};
+
+
+#endif /* end of include guard: STATISTICS_H */
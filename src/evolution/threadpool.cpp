@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "threadpool.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+/* -------------------------------------------------------------------------- *
+ * Thread pinning                                                             *
+ * -------------------------------------------------------------------------- */
+
+static std::atomic<ThreadPinning> currentPinning(PINNING_NONE);
+
+ThreadPinning parseThreadPinning(const std::string &name) {
+  if (name == "none") {
+    return PINNING_NONE;
+  }
+
+  if (name == "cores") {
+    return PINNING_CORES;
+  }
+
+  if (name == "numa") {
+    return PINNING_NUMA;
+  }
+
+  throw std::invalid_argument("unknown thread pinning " + name);
+}
+
+void setThreadPinning(ThreadPinning pinning) {
+  currentPinning.store(pinning);
+}
+
+ThreadPinning getThreadPinning(void) {
+  return currentPinning.load();
+}
+
+#ifdef __linux__
+
+/* Parses a sysfs CPU list such as "0-3,8-11" */
+static std::vector<unsigned> parseCpuList(const std::string &list) {
+  std::vector<unsigned> cpus;
+  std::istringstream iss(list);
+  std::string range;
+
+  while (std::getline(iss, range, ',')) {
+    unsigned first, last;
+    int numFields = sscanf(range.c_str(), "%u-%u", &first, &last);
+    if (numFields == 1) {
+      last = first;
+    }
+    for (unsigned cpu = first; numFields > 0 && cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<std::vector<unsigned> > numaNodes(void) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+
+  std::vector<std::vector<unsigned> > nodes;
+  for (unsigned node = 0; ; node++) {
+    std::ifstream ifs("/sys/devices/system/node/node" +
+                      std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!std::getline(ifs, list)) {
+      break;
+    }
+
+    std::vector<unsigned> cpus;
+    for (unsigned cpu : parseCpuList(list)) {
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      nodes.push_back(cpus);
+    }
+  }
+
+  if (nodes.empty()) {
+    nodes.resize(1);
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        nodes[0].push_back(cpu);
+      }
+    }
+  }
+  return nodes;
+}
+
+void ThreadPool::pin(ThreadPinning pinning) {
+  if (pinning == PINNING_NONE || m_threads.empty()) {
+    return;
+  }
+
+  std::vector<std::vector<unsigned> > nodes = numaNodes();
+  std::vector<unsigned> cpus;
+  for (unsigned node = 0; node < nodes.size(); node++) {
+    cpus.insert(cpus.end(), nodes[node].begin(), nodes[node].end());
+  }
+  if (cpus.empty()) {
+    return;
+  }
+
+  /* Failures are ignored: the thread keeps running unpinned */
+  for (unsigned k = 1; k < size(); k++) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pinning == PINNING_CORES) {
+      CPU_SET(cpus[k % cpus.size()], &set);
+    } else {
+      for (unsigned cpu : nodes[(uint64_t) k * nodes.size() / size()]) {
+        CPU_SET(cpu, &set);
+      }
+    }
+    pthread_setaffinity_np(m_threads[k - 1].native_handle(), sizeof(set),
+                           &set);
+  }
+}
+
+#else
+
+std::vector<std::vector<unsigned> > numaNodes(void) {
+  return std::vector<std::vector<unsigned> >(1);
+}
+
+void ThreadPool::pin(ThreadPinning pinning) { }
+
+#endif /* __linux__ */
+
+
+/* -------------------------------------------------------------------------- *
+ * Thread pool                                                                *
+ * -------------------------------------------------------------------------- */
+
+static inline uint64_t packRange(unsigned begin, unsigned end) {
+  return (uint64_t) begin << 32 | end;
+}
+
+ThreadPool::ThreadPool(unsigned numThreads, ThreadPinning pinning) :
+  m_ranges(std::max(numThreads, 1u)), m_task(NULL), m_busy(0), m_job(0),
+  m_stop(false) {
+  for (unsigned k = 0; k < m_ranges.size(); k++) {
+    m_ranges[k].bounds.store(0);
+  }
+
+  for (unsigned k = 1; k < numThreads; k++) {
+    m_threads.push_back(std::thread(&ThreadPool::worker, this, k));
+  }
+  pin(pinning);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+
+  for (unsigned k = 0; k < m_threads.size(); k++) {
+    m_threads[k].join();
+  }
+}
+
+unsigned ThreadPool::size(void) const {
+  return m_threads.size() + 1;
+}
+
+/* Takes the first task of the range of `thread` */
+bool ThreadPool::pop(unsigned thread, unsigned &task) {
+  std::atomic<uint64_t> &bounds = m_ranges[thread].bounds;
+  uint64_t range = bounds.load();
+
+  while (true) {
+    unsigned begin = range >> 32;
+    unsigned end = (uint32_t) range;
+    if (begin >= end) {
+      return false;
+    }
+    if (bounds.compare_exchange_weak(range, packRange(begin + 1, end))) {
+      task = begin;
+      return true;
+    }
+  }
+}
+
+/* Takes the back half of the range of the next thread that has tasks left,
+ * runs its first task and keeps the rest as the range of `thread`.  A task
+ * leaves the ranges for good once taken, so a range seen twice with the
+ * same bounds still holds the same tasks, and the swap is safe */
+bool ThreadPool::steal(unsigned thread, unsigned &task) {
+  for (unsigned d = 1; d < size(); d++) {
+    std::atomic<uint64_t> &bounds = m_ranges[(thread + d) % size()].bounds;
+    uint64_t range = bounds.load();
+
+    while (true) {
+      unsigned begin = range >> 32;
+      unsigned end = (uint32_t) range;
+      if (begin >= end) {
+        break;
+      }
+
+      unsigned middle = end - (end - begin + 1) / 2;
+      if (bounds.compare_exchange_weak(range, packRange(begin, middle))) {
+        m_ranges[thread].bounds.store(packRange(middle + 1, end));
+        task = middle;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::drain(unsigned thread) {
+  unsigned k;
+  while (pop(thread, k) || steal(thread, k)) {
+    try {
+      (*m_task)(k, thread);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_error) {
+        m_error = std::current_exception();
+      }
+    }
+  }
+}
+
+void ThreadPool::worker(unsigned thread) {
+  unsigned long seen = 0;
+
+  while (true) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wake.wait(lock, [&] { return m_stop || m_job != seen; });
+    if (m_stop) {
+      return;
+    }
+    seen = m_job;
+    lock.unlock();
+
+    drain(thread);
+
+    lock.lock();
+    m_busy -= 1;
+    if (m_busy == 0) {
+      m_done.notify_one();
+    }
+  }
+}
+
+void ThreadPool::parallelFor(unsigned numTasks, const Task &task) {
+  m_error = std::exception_ptr();
+
+  if (m_threads.empty()) {
+    for (unsigned k = 0; k < numTasks; k++) {
+      try {
+        task(k, 0);
+      } catch (...) {
+        if (!m_error) {
+          m_error = std::current_exception();
+        }
+      }
+    }
+
+    if (m_error) {
+      std::rethrow_exception(m_error);
+    }
+    return;
+  }
+
+  /* Publish the job, with one contiguous range of tasks per thread.  The
+   * workers are all asleep, so nobody reads the ranges yet */
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task = &task;
+    for (unsigned k = 0; k < size(); k++) {
+      m_ranges[k].bounds.store(
+        packRange((uint64_t) numTasks * k / size(),
+                  (uint64_t) numTasks * (k + 1) / size()));
+    }
+    m_busy = m_threads.size();
+    m_job += 1;
+  }
+  m_wake.notify_all();
+
+  /* Work, then wait for the stragglers */
+  drain(0);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [&] { return m_busy == 0; });
+  m_task = NULL;
+
+  if (m_error) {
+    std::rethrow_exception(m_error);
+  }
+}
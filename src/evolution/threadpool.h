@@ -0,0 +1,172 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "information.h"
+
+
+/* -------------------------------------------------------------------------- *
+ * Thread pinning                                                             *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief Where the workers of a pool run.  Pinning is a hint: it is only
+ *  implemented on Linux, and a pool whose threads cannot be pinned runs
+ *  unpinned.  Only the workers are pinned, the thread calling `parallelFor`
+ *  stays where it is.
+ *
+ *    Pinning           Placement of thread `k` of `n`
+ *
+ *    PINNING_NONE      Wherever the scheduler puts it (the default)
+ *    PINNING_CORES     The `k`-th CPU the process may run on, node by node
+ *    PINNING_NUMA      Any CPU of node `k * numNodes / n`, so the threads of
+ *                      a node have neighbouring indices, start on
+ *                      neighbouring task ranges and steal from each other
+ *                      first
+ */
+typedef enum {
+  PINNING_NONE,
+  PINNING_CORES,
+  PINNING_NUMA
+} ThreadPinning;
+
+/**
+ * @brief Parses a pinning name, `none`, `cores` or `numa`
+ *
+ * @note This function throws an exception when the name is unknown.
+ */
+ThreadPinning parseThreadPinning(const std::string &name);
+
+/**
+ * @brief Selects the pinning of the pools created from now on, for the
+ *  whole process
+ *
+ * @param pinning
+ */
+void setThreadPinning(ThreadPinning pinning);
+ThreadPinning getThreadPinning(void);
+
+/**
+ * @brief CPUs the process may run on, grouped by NUMA node as listed in
+ *  `/sys/devices/system/node`.  A machine without that directory is a
+ *  single node, and so is any platform other than Linux, where the only
+ *  node is empty.
+ */
+std::vector<std::vector<unsigned> > numaNodes(void);
+
+
+/* -------------------------------------------------------------------------- *
+ * Thread pool                                                                *
+ * -------------------------------------------------------------------------- */
+
+/**
+ * @brief A fixed set of worker threads that run indexed tasks.  The threads
+ *  are started once and sleep between jobs, so a generation step does not
+ *  pay for thread creation.
+ *
+ *  Tasks are scheduled by work stealing.  Every job is split into one
+ *  contiguous range of task indices per thread, each thread runs its own
+ *  range from the front, and a thread whose range is empty steals the back
+ *  half of the range of another thread.  Threads mostly run neighbouring
+ *  tasks, and a thread stuck in expensive tasks (chunks with many births,
+ *  say) is relieved by the others without a shared counter they all
+ *  contend on.
+ */
+class ThreadPool {
+ public:
+
+  /* A task receives its own index and the index of the thread running it,
+   * in `[0, size())` */
+  typedef std::function<void(unsigned task, unsigned thread)> Task;
+
+ private:
+
+  /* Tasks `[begin, end)` still to run from the range of one thread, packed
+   * as `begin << 32 | end` so the owner and the thieves update it with a
+   * single compare-and-swap.  Every range has a cache line of its own */
+  struct alignas(64) TaskRange {
+    std::atomic<uint64_t> bounds;
+  };
+  static_assert(sizeof(TaskRange) == 64, "a range fills a cache line");
+
+  std::vector<std::thread> m_threads;
+
+  /* One range per thread.  `new` does not honour `alignas` before C++17 */
+  std::vector<TaskRange, AlignedAllocator<TaskRange, 64> > m_ranges;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;   //! Signals workers that a job started
+  std::condition_variable m_done;   //! Signals the caller that it finished
+
+  const Task *m_task;               //! Current job
+  unsigned m_busy;                  //! Workers still inside the current job
+  unsigned long m_job;              //! Incremented for every job
+  bool m_stop;
+  std::exception_ptr m_error;       //! First exception thrown by a task
+
+  void worker(unsigned thread);
+  void drain(unsigned thread);
+  bool pop(unsigned thread, unsigned &task);
+  bool steal(unsigned thread, unsigned &task);
+  void pin(ThreadPinning pinning);
+
+ public:
+
+  /**
+   * @brief Starts `numThreads - 1` workers.  The thread calling
+   *  `parallelFor` does its share of the work as thread 0, so a pool of
+   *  size one runs everything inline.
+   *
+   * @param numThreads
+   * @param pinning Where the workers run, the process-wide setting by
+   *  default
+   */
+  explicit ThreadPool(unsigned numThreads,
+                      ThreadPinning pinning = getThreadPinning());
+  ~ThreadPool();
+
+  /* Number of threads, including the caller */
+  unsigned size(void) const;
+
+  /**
+   * @brief Runs `task(k, thread)` for every `k` in `[0, numTasks)` and waits
+   *  for all of them to finish.  Every task runs exactly once, on whichever
+   *  thread gets to it, so tasks must not depend on the thread for anything
+   *  but scratch storage.  If a task throws, the first exception is
+   *  rethrown here once the other tasks are done.
+   *
+   * @param numTasks
+   * @param task
+   */
+  void parallelFor(unsigned numTasks, const Task &task);
+
+  /**
+   * @brief Runs `task(k, thread, partials[k])` for every `k` in
+   *  `[0, numTasks)`, each on a default-constructed partial result, then
+   *  calls `merge(result, partials[k])` in task order.  The result does not
+   *  depend on the number of threads or on who stole what.  `partials` is
+   *  only storage, which the caller can keep from one call to the next.
+   */
+  template <typename T, typename ReduceTask, typename Merge>
+  void parallelReduce(unsigned numTasks, std::vector<T> &partials, T &result,
+                      const ReduceTask &task, const Merge &merge) {
+    partials.assign(numTasks, T());
+    parallelFor(numTasks, [&](unsigned k, unsigned thread) {
+      task(k, thread, partials[k]);
+    });
+
+    for (unsigned k = 0; k < numTasks; k++) {
+      merge(result, partials[k]);
+    }
+  }
+};
+
+
+#endif /* end of include guard: THREADPOOL_H */
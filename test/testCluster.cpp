@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "halo.h"
+#include "island.h"
+#include "testFixtures.h"
+#include "transport.h"
+
+/* Runs one thread per transport, which stand in for the processes */
+template <typename Function>
+static void runIslands(std::vector<std::unique_ptr<SocketTransport>>
+                       &transports, Function function) {
+  std::vector<std::thread> threads;
+  for (unsigned rank = 0; rank < transports.size(); rank++) {
+    threads.push_back(std::thread([&, rank]() {
+      function(*transports[rank]);
+    }));
+  }
+
+  for (unsigned n = 0; n < threads.size(); n++) {
+    threads[n].join();
+  }
+}
+
+static std::vector<std::unique_ptr<SocketTransport>> meshTransports(
+unsigned size) {
+  std::vector<std::vector<int>> mesh = socketMesh(size);
+  std::vector<std::unique_ptr<SocketTransport>> transports;
+  for (unsigned rank = 0; rank < size; rank++) {
+    transports.emplace_back(new SocketTransport(rank, mesh[rank]));
+  }
+  return transports;
+}
+
+TEST(cluster, topologies) {
+  const MigrationTopology topologies[] = {
+    TOPOLOGY_RING, TOPOLOGY_FULL, TOPOLOGY_RANDOM
+  };
+  const unsigned size = 5;
+
+  /* Island `a` sends to `b` exactly when `b` receives from `a` */
+  for (MigrationTopology topology : topologies) {
+    for (uint64_t generation = 0; generation < 20; generation++) {
+      std::vector<std::vector<unsigned>> destinations(size);
+      std::vector<std::vector<unsigned>> sources(size);
+      for (unsigned rank = 0; rank < size; rank++) {
+        migrationPeers(topology, rank, size, 3, generation,
+                       destinations[rank], sources[rank]);
+      }
+
+      for (unsigned a = 0; a < size; a++) {
+        for (unsigned b = 0; b < size; b++) {
+          unsigned sends = std::count(destinations[a].begin(),
+                                      destinations[a].end(), b);
+          unsigned receives = std::count(sources[b].begin(),
+                                         sources[b].end(), a);
+          EXPECT_EQ(sends, receives);
+          EXPECT_TRUE(a != b || sends == 0);
+        }
+      }
+    }
+  }
+
+  std::vector<unsigned> destinations;
+  std::vector<unsigned> sources;
+  migrationPeers(TOPOLOGY_FULL, 0, 1, 3, 0, destinations, sources);
+  EXPECT_TRUE(destinations.empty());
+  EXPECT_TRUE(sources.empty());
+}
+
+TEST(cluster, exchange) {
+  std::vector<std::unique_ptr<SocketTransport>> transports =
+    meshTransports(3);
+
+  /* Every island sends every other island a message much larger than the
+   * socket buffers at once */
+  const unsigned sizeMessage = 4 << 20;
+  std::vector<std::vector<Message>> received(3);
+  runIslands(transports, [&](Transport &transport) {
+    std::vector<Message> outgoing;
+    std::vector<Message> incoming;
+    for (unsigned peer = 0; peer < transport.size(); peer++) {
+      if (peer != transport.rank()) {
+        Message message;
+        message.peer = peer;
+        message.data.assign(sizeMessage + peer, 'a' + transport.rank());
+        outgoing.push_back(message);
+        message.data.clear();
+        incoming.push_back(message);
+      }
+    }
+
+    transport.exchange(outgoing, incoming);
+    received[transport.rank()] = incoming;
+  });
+
+  for (unsigned rank = 0; rank < 3; rank++) {
+    ASSERT_EQ(received[rank].size(), 2);
+    for (unsigned n = 0; n < 2; n++) {
+      const Message &message = received[rank][n];
+      EXPECT_EQ(message.data.size(), sizeMessage + rank);
+      EXPECT_EQ(message.data.front(), 'a' + message.peer);
+      EXPECT_EQ(message.data.back(), 'a' + message.peer);
+    }
+  }
+}
+
+TEST(cluster, islands) {
+  Parameters params = testParameters();
+  MigrationPolicy policy;
+  policy.topology = TOPOLOGY_RANDOM;
+  policy.rate = 0.05;
+  policy.interval = 2;
+
+  /* The same cluster, once over socket pairs and once over Unix sockets */
+  char directory[] = "/tmp/islandsXXXXXX";
+  ASSERT_TRUE(mkdtemp(directory) != NULL);
+
+  std::vector<std::unique_ptr<SocketTransport>> unixTransports(3);
+  std::vector<std::thread> threads;
+  for (unsigned rank = 0; rank < 3; rank++) {
+    threads.push_back(std::thread([&, rank]() {
+      unixTransports[rank] = SocketTransport::connectUnix(directory, rank, 3);
+    }));
+  }
+  for (unsigned n = 0; n < threads.size(); n++) {
+    threads[n].join();
+  }
+  rmdir(directory);
+
+  std::vector<std::unique_ptr<SocketTransport>> transports =
+    meshTransports(3);
+
+  std::vector<std::string> snapshots[2];
+  for (unsigned run = 0; run < 2; run++) {
+    snapshots[run].resize(3);
+    std::vector<uint64_t> emigrants(3);
+    std::vector<uint64_t> immigrants(3);
+
+    runIslands(run == 0 ? transports : unixTransports,
+    [&](Transport &transport) {
+      Island island(params, 11, transport, policy);
+      island.run(10);
+      snapshots[run][transport.rank()] = snapshot(island.getEcosystem());
+      emigrants[transport.rank()] = island.getNumEmigrants();
+      immigrants[transport.rank()] = island.getNumImmigrants();
+    });
+
+    /* Agents are neither lost nor duplicated on the way */
+    uint64_t numEmigrants = std::accumulate(emigrants.begin(),
+                                            emigrants.end(), 0);
+    EXPECT_GT(numEmigrants, 0);
+    EXPECT_EQ(numEmigrants, std::accumulate(immigrants.begin(),
+                                            immigrants.end(), 0));
+  }
+
+  /* The transport makes no difference, but the islands do */
+  EXPECT_EQ(snapshots[0], snapshots[1]);
+  EXPECT_NE(snapshots[0][0], snapshots[0][1]);
+}
+
+TEST(cluster, latticeBands) {
+  Parameters params = testParameters();
+  const unsigned width = 20;
+  const unsigned height = 12;
+
+  Lattice whole(params, width, height, 5);
+  whole.run(8);
+  std::vector<std::string> rows(height);
+  for (unsigned y = 0; y < height; y++) {
+    MigrantBatch batch(params.sizeChromosome);
+    whole.packRow(1 + y, batch);
+    rows[y] = batch.data();
+  }
+
+  /* Two bands share one peer, three have two.  Either way the torus evolves
+   * exactly as in one piece */
+  for (unsigned numBands = 2; numBands <= 3; numBands++) {
+    std::vector<std::unique_ptr<SocketTransport>> transports =
+      meshTransports(numBands);
+    std::vector<std::string> bandRows(height);
+
+    runIslands(transports, [&](Transport &transport) {
+      unsigned firstRow;
+      unsigned numRows;
+      latticeBand(height, numBands, transport.rank(), firstRow, numRows);
+      Lattice band(params, width, height, 5, firstRow, numRows);
+      band.setHaloExchange(std::unique_ptr<HaloExchange>(
+                             new TransportHalo(transport)));
+      band.run(8);
+
+      for (unsigned row = 1; row <= numRows; row++) {
+        MigrantBatch batch(params.sizeChromosome);
+        band.packRow(row, batch);
+        bandRows[firstRow + row - 1] = batch.data();
+      }
+    });
+
+    for (unsigned y = 0; y < height; y++) {
+      EXPECT_EQ(bandRows[y], rows[y]) << numBands << " bands, row " << y;
+    }
+  }
+
+  unsigned firstRow;
+  unsigned numRows;
+  latticeBand(10, 4, 3, firstRow, numRows);
+  EXPECT_EQ(firstRow, 7);
+  EXPECT_EQ(numRows, 3);
+  EXPECT_THROW(latticeBand(3, 4, 0, firstRow, numRows),
+               std::invalid_argument);
+}
@@ -1,7 +1,16 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <set>
+#include <sstream>
+#include "checkpoint.h"
+#include "delta.h"
 #include "ecosystem.h"
+#include "lattice.h"
+#include "testFixtures.h"
 
 TEST(ecosystem, serialization) {
   Parameters params;
@@ -27,3 +36,482 @@ TEST(ecosystem, serialization) {
     ia >> e2;
   }
 }
+
+TEST(ecosystem, reproducible) {
+  Parameters params = testParameters();
+
+  Ecosystem a(params, 7);
+  Ecosystem b(params, 7);
+  Ecosystem c(params, 8);
+  a.run(5);
+  b.run(5);
+  c.run(5);
+
+  EXPECT_EQ(snapshot(a), snapshot(b));
+  EXPECT_NE(snapshot(a), snapshot(c));
+}
+
+TEST(ecosystem, threadCountIndependent) {
+  Parameters params = testParameters();
+  params.sizePopulation = 3000;
+
+  Ecosystem serial(params, 11);
+  Ecosystem threaded(params, 11);
+  serial.run(4);
+  threaded.run(4, 4);
+
+  EXPECT_EQ(snapshot(serial), snapshot(threaded));
+}
+
+TEST(ecosystem, runningStatistics) {
+  double values[100];
+  double mean = 0;
+  for (unsigned k = 0; k < 100; k++) {
+    values[k] = 1e6 + sin(k);
+    mean += values[k] / 100;
+  }
+  double variance = 0;
+  for (unsigned k = 0; k < 100; k++) {
+    variance += (values[k] - mean) * (values[k] - mean) / 100;
+  }
+
+  /* Uneven chunks, merged */
+  RunningStatistics total;
+  RunningStatistics chunk;
+  for (unsigned k = 0; k < 100; k++) {
+    chunk.add(values[k]);
+    if (k % 37 == 0 || k == 99) {
+      total.merge(chunk);
+      chunk.clear();
+    }
+  }
+
+  EXPECT_EQ(total.count(), 100);
+  EXPECT_NEAR(total.mean(), mean, 1e-9);
+  EXPECT_NEAR(total.variance(), variance, 1e-9);
+}
+
+TEST(ecosystem, statistics) {
+  Parameters params = testParameters();
+  params.sizePopulation = 2500;
+
+  Ecosystem e(params, 3);
+  EXPECT_EQ(e.meanEntropy(), 0);
+  EXPECT_EQ(e.meanSurvivalFraction(), 0);
+  e.run(6, 3);
+
+  EXPECT_GT(e.meanEntropy(), 0);
+  EXPECT_GT(e.stdevEntropy(), 0);
+  EXPECT_GT(e.meanSurvivalFraction(), 0);
+  EXPECT_LT(e.meanSurvivalFraction(), 1);
+
+  /* The statistics collected during the step match a separate pass over
+   * the same agents */
+  std::istringstream iss(snapshot(e));
+  boost::archive::binary_iarchive ia(iss);
+  Ecosystem loaded;
+  ia >> loaded;
+  EXPECT_NEAR(loaded.meanEntropy(), e.meanEntropy(), 1e-12);
+  EXPECT_NEAR(loaded.stdevEntropy(), e.stdevEntropy(), 1e-12);
+
+  /* And do not depend on the number of threads */
+  Ecosystem serial(params, 3);
+  serial.run(6);
+  EXPECT_EQ(serial.meanEntropy(), e.meanEntropy());
+  EXPECT_EQ(serial.stdevEntropy(), e.stdevEntropy());
+  EXPECT_EQ(serial.meanSurvivalFraction(), e.meanSurvivalFraction());
+}
+
+TEST(ecosystem, checkpoint) {
+  Parameters params = testParameters();
+  params.sizePopulation = 1500;
+
+  Ecosystem e(params, 5);
+  e.run(3);
+  e.saveCheckpoint("ecosystem.ckpt");
+  EXPECT_TRUE(isCheckpoint("ecosystem.ckpt"));
+
+  /* The mapped ecosystem is the same, and evolves the same */
+  Ecosystem loaded;
+  loaded.loadCheckpoint("ecosystem.ckpt");
+  EXPECT_EQ(snapshot(loaded), snapshot(e));
+  EXPECT_NEAR(loaded.meanEntropy(), e.meanEntropy(), 1e-12);
+
+  e.run(4);
+  loaded.run(4);
+  EXPECT_EQ(snapshot(loaded), snapshot(e));
+
+  /* The file is not modified by running the mapped ecosystem */
+  Ecosystem reloaded;
+  reloaded.loadCheckpoint("ecosystem.ckpt");
+  EXPECT_EQ(reloaded.getGeneration(), 3);
+
+  /* Boost archives are not checkpoints */
+  {
+    std::ofstream ofs("ecosystem.bin");
+    boost::archive::binary_oarchive oa(ofs);
+    oa << e;
+  }
+  EXPECT_FALSE(isCheckpoint("ecosystem.bin"));
+  EXPECT_THROW(reloaded.loadCheckpoint("ecosystem.bin"), std::runtime_error);
+  EXPECT_THROW(reloaded.loadCheckpoint("missing.ckpt"), std::runtime_error);
+}
+
+/* Checkpoints several times larger than the write buffer of the file, with
+ * chunks of every array straddling its boundaries */
+TEST(ecosystem, largeCheckpoint) {
+  Parameters params = testParameters();
+  params.sizeChromosome = 72;
+  const unsigned numAgents = 40000;
+
+  Population p(params.sizeChromosome);
+  Random random(9);
+  SlotVector order;
+  for (unsigned n = 0; n < 2 * numAgents; n++) {
+    unsigned slot = p.allocate();
+    Buffer::Word *chromosome = p.chromosome(slot);
+    for (unsigned k = 0; k < params.sizeChromosome / Buffer::wordBytes; k++) {
+      chromosome[k] = random();
+    }
+    p.countOnes(slot);
+    p.setEnergy(slot, n);
+    if (n % 2) {
+      order.push_back(slot);
+    }
+  }
+  std::reverse(order.begin(), order.end());
+
+  CheckpointSnapshot snapshot;
+  snapshot.capture(params, 4, 7, p, order);
+  for (unsigned mode = 0; mode < 2; mode++) {
+    if (mode == 0) {
+      writeCheckpoint("large.ckpt", params, 4, 7, p, order);
+    } else {
+      snapshot.write("large.ckpt", false);
+    }
+
+    Parameters loaded;
+    uint64_t seed, generation;
+    Population q = mapCheckpoint("large.ckpt", loaded, seed, generation);
+    ASSERT_EQ(q.size(), numAgents);
+    EXPECT_EQ(generation, 7);
+    for (unsigned k = 0; k < numAgents; k++) {
+      ASSERT_EQ(q.getEnergy(k), p.getEnergy(order[k]));
+      ASSERT_EQ(q.getNumOnes(k), p.getNumOnes(order[k]));
+      ASSERT_EQ(memcmp(q.chromosome(k), p.chromosome(order[k]),
+                       p.stride() * Buffer::wordBytes), 0);
+    }
+  }
+}
+
+TEST(ecosystem, periodicCheckpoints) {
+  Parameters params = testParameters();
+  params.sizePopulation = 1200;
+
+#ifdef HAVE_LIBZ
+  const unsigned numModes = 2;
+#else
+  const unsigned numModes = 1;
+
+  /* Without zlib, compressed checkpoints are refused up front */
+  Ecosystem uncompressed(params, 21);
+  EXPECT_THROW(uncompressed.setCheckpoint("periodic.ckpt", 4, true),
+               std::invalid_argument);
+#endif
+
+  for (unsigned compress = 0; compress < numModes; compress++) {
+    Ecosystem e(params, 21);
+    e.setCheckpoint("periodic.ckpt", 4, compress);
+    e.run(10);
+    e.flushCheckpoints();
+    EXPECT_TRUE(isCheckpoint("periodic.ckpt"));
+
+    /* Resuming from generation 8 catches up exactly */
+    Ecosystem resumed;
+    resumed.loadCheckpoint("periodic.ckpt");
+    EXPECT_EQ(resumed.getGeneration(), 8);
+    resumed.run(2);
+    EXPECT_EQ(snapshot(resumed), snapshot(e));
+  }
+
+  /* Failed writes surface on the next save */
+  Ecosystem e(params, 21);
+  e.setCheckpoint("missing/periodic.ckpt", 1);
+  EXPECT_THROW({
+    e.run(3);
+    e.flushCheckpoints();
+  }, std::runtime_error);
+}
+
+TEST(ecosystem, deltaRecording) {
+  Parameters params = testParameters();
+  params.sizePopulation = 1200;
+
+  /* Direct runs to compare the replays with */
+  Ecosystem seven(params, 33);
+  seven.run(7);
+  Ecosystem e(params, 33);
+  e.setDeltaRecording("history.delta", 4);
+  e.run(10);
+
+  DeltaReader reader("history.delta");
+  EXPECT_FALSE(reader.seek(11));
+
+  /* Generation 7 comes from the FULL record of generation 4 */
+  ASSERT_TRUE(reader.seek(7));
+  reader.saveCheckpoint("replayed.ckpt");
+  Ecosystem replayed;
+  replayed.loadCheckpoint("replayed.ckpt");
+  EXPECT_EQ(replayed.getGeneration(), 7);
+  EXPECT_EQ(snapshot(replayed), snapshot(seven));
+
+  /* The lineage rebuilt from the events alone, starting from the first
+   * FULL record, crosses the FULL records of generations 4 and 8: every
+   * parent is known and was alive when it mated, and the live agents are
+   * the ones the records list */
+  DeltaReader history("history.delta");
+  ASSERT_TRUE(history.next());
+  std::set<uint64_t> alive;
+  for (unsigned k = 0; k < history.getOrder().size(); k++) {
+    alive.insert(history.getId(history.getOrder()[k]));
+  }
+  std::set<uint64_t> known(alive);
+  std::set<uint64_t> generationsWithBirths;
+  unsigned numBirths = 0;
+
+  while (history.next()) {
+    const std::vector<DeltaBirth> &births = history.getBirths();
+    for (unsigned n = 0; n < births.size(); n++) {
+      if (births[n].father != noParent) {
+        EXPECT_EQ(known.count(births[n].father), 1);
+        EXPECT_EQ(known.count(births[n].mother), 1);
+        EXPECT_EQ(alive.count(births[n].father), 1);
+        EXPECT_EQ(alive.count(births[n].mother), 1);
+      }
+      alive.insert(births[n].id);
+      known.insert(births[n].id);
+      generationsWithBirths.insert(history.getGeneration());
+      numBirths += 1;
+    }
+
+    const std::vector<uint64_t> &deaths = history.getDeaths();
+    for (unsigned n = 0; n < deaths.size(); n++) {
+      EXPECT_EQ(alive.erase(deaths[n]), 1);
+    }
+
+    std::set<uint64_t> listed;
+    for (unsigned k = 0; k < history.getOrder().size(); k++) {
+      listed.insert(history.getId(history.getOrder()[k]));
+    }
+    EXPECT_EQ(alive, listed);
+  }
+  EXPECT_EQ(generationsWithBirths.size(), 10);
+  EXPECT_GT(numBirths, 0);
+
+  EXPECT_EQ(history.getGeneration(), 10);
+  history.saveCheckpoint("replayed.ckpt");
+  replayed.loadCheckpoint("replayed.ckpt");
+  EXPECT_EQ(snapshot(replayed), snapshot(e));
+}
+
+TEST(ecosystem, pairingEngines) {
+  const unsigned sizes[] = {0, 1, 2, 3, 17, 1000, 9001};
+  PermutationPairing permutation;
+  ShufflePairing shuffle;
+  ThreadPool serial(1);
+  ThreadPool threaded(3);
+
+  for (unsigned size : sizes) {
+
+    /* Live slots scattered over a larger slab */
+    Population p(8);
+    p.reserve(2 * size);
+    SlotVector order;
+    for (unsigned n = 0; n < 2 * size; n++) {
+      unsigned slot = p.allocate();
+      if (n % 2) {
+        order.push_back(slot);
+      }
+    }
+    std::reverse(order.begin(), order.end());
+    SlotVector sorted(order);
+    std::sort(sorted.begin(), sorted.end());
+
+    SlotVector a(order);
+    SlotVector b(order);
+    SlotVector c(order);
+    permutation.arrange(p, a, 1, 2, serial);
+    permutation.arrange(p, b, 1, 2, threaded);
+    permutation.arrange(p, c, 1, 3, serial);
+    EXPECT_EQ(a, b);
+    if (size > 3) {
+      EXPECT_NE(a, c);
+    }
+
+    /* Every agent once, with pairs in the order of their first member.  The
+     * order is reversed, so that is the reverse memory order */
+    SlotVector d(a);
+    std::sort(d.begin(), d.end());
+    EXPECT_EQ(d, sorted);
+    for (unsigned k = 2; k + 1 < size; k += 2) {
+      EXPECT_GT(std::max(a[k - 2], a[k - 1]), std::max(a[k], a[k + 1]));
+    }
+
+    /* Only the sequence of agents matters, not their slots: the same agents
+     * in other slots are paired the same way */
+    SlotVector moved(order);
+    for (unsigned k = 0; k < size; k++) {
+      moved[k] = order[k] - 1;
+    }
+    permutation.arrange(p, moved, 1, 2, threaded);
+    for (unsigned k = 0; k < size; k++) {
+      EXPECT_EQ(moved[k], a[k] - 1);
+    }
+
+    SlotVector e(order);
+    shuffle.arrange(p, e, 1, 2, serial);
+    std::sort(e.begin(), e.end());
+    EXPECT_EQ(e, sorted);
+  }
+
+  /* The engines pair agents uniformly: agent 0 meets each of the other 9
+   * about as often */
+  Population p(8);
+  SlotVector order;
+  for (unsigned n = 0; n < 10; n++) {
+    order.push_back(p.allocate());
+  }
+  std::vector<unsigned> partners(10, 0);
+  for (unsigned stream = 0; stream < 9000; stream++) {
+    permutation.arrange(p, order, 5, stream, serial);
+    unsigned k = std::find(order.begin(), order.end(), 0) - order.begin();
+    partners[order[k ^ 1]] += 1;
+  }
+  for (unsigned n = 1; n < 10; n++) {
+    EXPECT_NEAR(partners[n], 1000, 150);
+  }
+
+  /* Resuming from a checkpoint, whose agents are in other slots, is exact
+   * with either engine */
+  for (const char *name : {"shuffle", "permutation"}) {
+    Parameters params = testParameters();
+    params.sizePopulation = 1500;
+    Ecosystem e(params, 17);
+    e.setPairingEngine(createPairingEngine(name));
+    e.run(6);
+    e.saveCheckpoint("pairing.ckpt");
+    e.run(6);
+
+    Ecosystem resumed;
+    resumed.loadCheckpoint("pairing.ckpt");
+    resumed.setPairingEngine(createPairingEngine(name));
+    resumed.run(6);
+    EXPECT_TRUE(snapshot(resumed) == snapshot(e)) << name;
+  }
+
+  /* The results still do not depend on the number of threads */
+  Parameters params = testParameters();
+  params.sizePopulation = 3000;
+  Ecosystem e1(params, 9);
+  Ecosystem e3(params, 9);
+  e1.setPairingEngine(createPairingEngine("permutation"));
+  e3.setPairingEngine(createPairingEngine("permutation"));
+  e1.run(5, 1);
+  e3.run(5, 3);
+  EXPECT_EQ(snapshot(e1), snapshot(e3));
+  EXPECT_STREQ(e1.getPairingEngine().name(), "permutation");
+  EXPECT_THROW(createPairingEngine("tournament"), std::invalid_argument);
+}
+
+TEST(ecosystem, profile) {
+  Parameters params = testParameters();
+  params.sizePopulation = 3000;
+  Ecosystem e(params, 5);
+  EXPECT_THROW(parseProfileFormat("xml"), std::invalid_argument);
+
+  if (!instrumentationEnabled) {
+    EXPECT_THROW(e.setProfile("profile.csv", PROFILE_CSV),
+                 std::runtime_error);
+    return;
+  }
+
+  /* The counts of a generation add up to the population it leaves */
+  for (unsigned n = 0; n < 3; n++) {
+    unsigned before = std::max(e.size(), params.sizePopulation);
+    e.run(1, 2);
+    const GenerationProfile &profile = e.getProfile();
+    EXPECT_EQ(profile.generation, e.getGeneration());
+    EXPECT_EQ(profile.counts[COUNTER_AGENTS], before);
+    EXPECT_EQ(profile.counts[COUNTER_ENCOUNTERS], before / 2);
+    EXPECT_LE(profile.counts[COUNTER_KILLS], before / 2);
+    EXPECT_LE(profile.counts[COUNTER_BIRTHS],
+              profile.counts[COUNTER_MATINGS]);
+    EXPECT_EQ(e.size(), before - profile.counts[COUNTER_KILLS] -
+              profile.counts[COUNTER_STARVED] +
+              profile.counts[COUNTER_BIRTHS]);
+    EXPECT_GT(profile.cycles[TIMER_FEEDING], 0);
+  }
+
+  /* One line per generation, after the CSV header */
+  e.setProfile("profile.csv", PROFILE_CSV);
+  e.run(2);
+  std::ifstream csv("profile.csv");
+  std::string header, line;
+  std::getline(csv, header);
+  EXPECT_EQ(header.find("generation,algaeCycles,"), 0);
+  EXPECT_EQ(header.find(",births,allocations"), header.size() - 19);
+  std::getline(csv, line);
+  EXPECT_EQ(line.find("4,"), 0);
+  std::getline(csv, line);
+  EXPECT_EQ(line.find("5,"), 0);
+  EXPECT_FALSE(std::getline(csv, line));
+
+  e.setProfile("profile.json", PROFILE_JSON);
+  e.run(1);
+  std::ifstream json("profile.json");
+  std::getline(json, line);
+  EXPECT_EQ(line.find("{\"generation\": 6, \"algaeCycles\": "), 0);
+  EXPECT_EQ(line.back(), '}');
+
+  EXPECT_THROW(e.setProfile("missing/profile.out", PROFILE_CSV),
+               std::runtime_error);
+}
+
+/* Every row of a lattice band, as one string */
+static std::string latticeSnapshot(const Lattice &lattice) {
+  MigrantBatch batch(lattice.getParameters().sizeChromosome);
+  for (unsigned row = 1; row <= lattice.numRows(); row++) {
+    lattice.packRow(row, batch);
+  }
+  return batch.data();
+}
+
+TEST(ecosystem, lattice) {
+  Parameters params = testParameters();
+  EXPECT_THROW(Lattice(params, 6, 2), std::invalid_argument);
+  EXPECT_THROW(Lattice(params, 7, 8), std::invalid_argument);
+  EXPECT_THROW(Lattice(params, 8, 8, 0, 6, 4), std::invalid_argument);
+
+  /* Tiles at the edges are cut short */
+  Lattice serial(params, 70, 40, 3);
+  Lattice threaded(params, 70, 40, 3);
+  serial.run(10);
+  threaded.run(10, 3);
+
+  EXPECT_EQ(latticeSnapshot(serial), latticeSnapshot(threaded));
+  EXPECT_EQ(serial.meanEntropy(), threaded.meanEntropy());
+  EXPECT_EQ(serial.getGeneration(), 10);
+  EXPECT_GT(serial.size(), 0);
+  EXPECT_LE(serial.size(), 70 * 40);
+  EXPECT_GT(serial.meanEntropy(), 0);
+  EXPECT_GT(serial.meanSurvivalFraction(), 0);
+  EXPECT_LT(serial.meanSurvivalFraction(), 1);
+
+  Lattice other(params, 70, 40, 4);
+  other.run(10);
+  EXPECT_NE(latticeSnapshot(serial), latticeSnapshot(other));
+
+  /* A band cannot run without its halo */
+  Lattice band(params, 8, 8, 0, 2, 4);
+  EXPECT_THROW(band.run(1), std::runtime_error);
+}
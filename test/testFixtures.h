@@ -0,0 +1,34 @@
+#ifndef TESTFIXTURES_H
+#define TESTFIXTURES_H
+
+#include <sstream>
+#include <string>
+#include "ecosystem.h"
+
+/* Parameters for a small, lively population */
+static inline Parameters testParameters(void) {
+  Parameters params;
+  params.sizePopulation = 200;
+  params.sizeChromosome = 32;
+  params.muNumMutations = 2.0;
+  params.muNumCrossovers = 1.5;
+  params.lambdaEnergy = 3.0;
+  params.sigmaPredation = 1.0;
+  params.lambdaPredation = 0.1;
+  params.lambdaScoreFeed = 1.0;
+  params.lambdaEntropyFeed = 1.0;
+  params.muEnergyStarve = 1.0;
+  params.muMating = 0.5;
+  return params;
+}
+
+/* Serialized state of an ecosystem, for comparisons */
+static inline std::string snapshot(const Ecosystem &e) {
+  std::ostringstream oss;
+  boost::archive::binary_oarchive oa(oss);
+  oa << e;
+  return oss.str();
+}
+
+
+#endif /* end of include guard: TESTFIXTURES_H */
@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
 #include <iostream>
 #include <fstream>
+#include <cmath>
+#include <vector>
 #include "agent.h"
+#include "kernels.h"
+#include "population.h"
 
 
 TEST(genetics, mutate) {
@@ -11,12 +15,96 @@ TEST(genetics, mutate) {
   Parameters params;
   params.muNumMutations = 2.5;
 
-  unsigned numMutations = mutate(a, params);
+  Random rng(1);
+  unsigned numMutations = mutate(a, params, rng);
   const Buffer &ca = a.getChromosomeConst();
   const Buffer &cb = b.getChromosomeConst();
   EXPECT_LE(distance(ca, cb), numMutations);
 }
 
+TEST(genetics, mutationEngines) {
+  const MutationEngine engines[] = {
+    MUTATION_POISSON, MUTATION_GEOMETRIC, MUTATION_MASK
+  };
+  const double rates[] = {3.0, 40.0, 200.0};
+  const unsigned size = 61;
+  const unsigned numTrials = 400;
+
+  for (unsigned e = 0; e < 3; e++) {
+    setMutationEngine(engines[e]);
+    for (unsigned r = 0; r < 3; r++) {
+      Parameters params;
+      params.muNumMutations = rates[r];
+
+      Random rng(e * 10 + r);
+      double total = 0;
+      for (unsigned n = 0; n < numTrials; n++) {
+        Agent a(size, 0x00);
+        unsigned numMutations = mutate(a, params, rng);
+        const Buffer &c = a.getChromosomeConst();
+        total += hammingWeight(c);
+
+        /* Nothing leaks into the padding */
+        EXPECT_EQ(c, Buffer(c.data(), size));
+
+        if (engines[e] == MUTATION_POISSON) {
+          EXPECT_LE(hammingWeight(c), numMutations);
+        } else {
+          EXPECT_EQ(hammingWeight(c), numMutations);
+        }
+      }
+
+      /* Close to the requested rate on average.  Repeated flips make the
+       * Poisson engine undershoot a little at high rates */
+      double expected = rates[r];
+      if (engines[e] == MUTATION_POISSON) {
+        double n = 8.0 * size;
+        expected = n * (1 - exp(- 2 * rates[r] / n)) / 2;
+      }
+      EXPECT_NEAR(total / numTrials, expected, 0.1 * expected + 0.3)
+          << "engine " << engines[e] << " rate " << rates[r];
+    }
+  }
+
+  setMutationEngine(MUTATION_AUTO);
+  EXPECT_EQ(selectMutationEngine(2.0, 1024), MUTATION_POISSON);
+  EXPECT_EQ(selectMutationEngine(200.0, 1024), MUTATION_GEOMETRIC);
+  EXPECT_EQ(selectMutationEngine(2000.0, 1024), MUTATION_MASK);
+}
+
+TEST(genetics, weightCache) {
+  Parameters params;
+  params.muNumCrossovers = 5.0;
+
+  Agent a(37, 0x3C);
+  Agent b(37, 0x00);
+  EXPECT_EQ(a.getNumOnes(), 4 * 37);
+  EXPECT_EQ(b.getNumOnes(), 0);
+
+  /* Writes through the chromosome are picked up */
+  b[3] = 0x07;
+  EXPECT_EQ(b.getNumOnes(), 3);
+
+  const MutationEngine engines[] = {
+    MUTATION_POISSON, MUTATION_GEOMETRIC, MUTATION_MASK
+  };
+  const double rates[] = {4.0, 20.0, 90.0};
+  Random rng(9);
+  for (unsigned e = 0; e < 3; e++) {
+    setMutationEngine(engines[e]);
+    params.muNumMutations = rates[e];
+    for (unsigned n = 0; n < 50; n++) {
+      mutate(a, params, rng);
+      EXPECT_EQ(a.getNumOnes(), hammingWeight(a.getChromosomeConst()));
+
+      Agent c = crossover(a, b, params, rng);
+      EXPECT_EQ(c.getNumOnes(), hammingWeight(c.getChromosomeConst()));
+      EXPECT_DOUBLE_EQ(c.getEntropy(), shannonEntropy(c.getChromosomeConst()));
+    }
+  }
+  setMutationEngine(MUTATION_AUTO);
+}
+
 TEST(genetics, crossover) {
   Agent a(20, 0x00);
   Agent b(20, 0xFF);
@@ -24,7 +112,8 @@ TEST(genetics, crossover) {
   Parameters params;
   params.muNumCrossovers = 2.5;
 
-  Agent c = crossover(a, b, params);
+  Random rng(2);
+  Agent c = crossover(a, b, params, rng);
   const Buffer &cChromosome = c.getChromosomeConst();
   std::cout << "0b";
   for (unsigned k = 0; k < 8 * cChromosome.size(); k++) {
@@ -33,6 +122,238 @@ TEST(genetics, crossover) {
   std::cout << std::endl;
 }
 
+TEST(genetics, predationScore) {
+  const PopcountKernel kernels[] = {
+    POPCOUNT_SCALAR, POPCOUNT_POPCNT, POPCOUNT_AVX2, POPCOUNT_AVX512
+  };
+  const unsigned sizes[] = {1, 3, 8, 33, 64, 128, 256, 1000, 1024};
+
+  /* Every pair of cells once: a = 0..3 repeated, b = each value 4 times */
+  Buffer a(4, (char) 0xE4);
+  Buffer b(4, 0x00);
+  b[1] = 0x55;
+  b[2] = (char) 0xAA;
+  b[3] = (char) 0xFF;
+  EXPECT_EQ(predationScoreReference(a, b), 0);
+  EXPECT_EQ(predationScore(a, b), 0);
+
+  b = Buffer(1, 0x55);
+  EXPECT_EQ(predationScoreReference(Buffer(1, 0x00), b), 4);
+
+  uint64_t state = 12345;
+  for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    Buffer x(sizes[s], 0x00);
+    Buffer y(sizes[s], 0x00);
+    for (unsigned k = 0; k < x.size(); k++) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      x[k] = (char)(state >> 56);
+      y[k] = (char)(state >> 48);
+    }
+
+    int expected = predationScoreReference(x, y);
+    EXPECT_EQ(predationScoreReference(y, x), - expected);
+
+    for (unsigned n = 0; n < sizeof(kernels) / sizeof(kernels[0]); n++) {
+      if (!popcountKernelSupported(kernels[n])) {
+        continue;
+      }
+
+      setPopcountKernel(kernels[n]);
+      for (int fixed = 0; fixed < 2; fixed++) {
+        setFixedLengthKernels(fixed);
+        EXPECT_EQ(predationScore(x, y), expected)
+            << popcountKernelName(kernels[n]) << " size " << sizes[s]
+            << " fixed " << fixed;
+        EXPECT_EQ(predationScore(y, x), - expected);
+      }
+    }
+  }
+
+  setPopcountKernel(POPCOUNT_AUTO);
+}
+
+TEST(genetics, randomStreams) {
+  Random a(42, 7);
+  Random b(42, 7);
+  Random c(42, 8);
+
+  uint64_t x = a();
+  EXPECT_EQ(x, b());
+  EXPECT_NE(x, c());
+
+  /* Re-keying restarts the stream */
+  a.seed(42, 7);
+  EXPECT_EQ(a(), x);
+
+  /* Copies continue from the same position */
+  Random d(a);
+  EXPECT_EQ(a(), d());
+
+  double u = gsl_rng_uniform(a.get());
+  EXPECT_GE(u, 0.0);
+  EXPECT_LT(u, 1.0);
+
+  /* Bulk uniforms are the same numbers */
+  double values[5];
+  d = a;
+  d.uniforms(values, 5);
+  for (unsigned k = 0; k < 5; k++) {
+    EXPECT_EQ(values[k], gsl_rng_uniform(a.get()));
+  }
+  EXPECT_EQ(a(), d());
+}
+
+TEST(genetics, bulkGaussians) {
+  const unsigned count = 20001;
+  std::vector<double> values(count);
+  Random a(3, 1);
+  a.gaussians(2.0, values.data(), count);
+
+  double sum = 0;
+  double sumSquares = 0;
+  for (unsigned k = 0; k < count; k++) {
+    EXPECT_TRUE(std::isfinite(values[k]));
+    sum += values[k];
+    sumSquares += values[k] * values[k];
+  }
+  EXPECT_NEAR(sum / count, 0.0, 0.05);
+  EXPECT_NEAR(sumSquares / count, 4.0, 0.15);
+
+  /* Same stream, same samples; odd counts use up an even number of draws */
+  Random b(3, 1);
+  double first[3];
+  b.gaussians(2.0, first, 3);
+  EXPECT_EQ(first[0], values[0]);
+  EXPECT_EQ(first[1], values[1]);
+  EXPECT_EQ(first[2], values[2]);
+
+  Random c(3, 1);
+  for (unsigned k = 0; k < 4; k++) {
+    c();
+  }
+  EXPECT_EQ(b(), c());
+}
+
+/* Population of `numAgents` random `size`-byte chromosomes in slots
+ * `0, 1, ...` */
+static Population randomPopulation(unsigned size, unsigned numAgents,
+                                   Random &random) {
+  Population population(size);
+  for (unsigned n = 0; n < numAgents; n++) {
+    unsigned slot = population.allocate();
+    Buffer::Word *c = population.chromosome(slot);
+    for (unsigned k = 0; k < size / Buffer::wordBytes; k++) {
+      c[k] = random();
+    }
+    population.countOnes(slot);
+  }
+  return population;
+}
+
+TEST(genetics, batchedPredation) {
+  Parameters params;
+  params.lambdaPredation = 0.1;
+  Random random(5);
+  Population population = randomPopulation(64, 1200, random);
+
+  /* Without noise the outcome is a function of the score, so the batch
+   * agrees with `predation` pair by pair, across several blocks */
+  const unsigned numPairs = 600;
+  std::vector<unsigned> pairs(2 * numPairs);
+  for (unsigned k = 0; k < 2 * numPairs; k++) {
+    pairs[k] = (k * 7) % 1200;
+  }
+
+  params.sigmaPredation = 1e-9;
+  std::vector<PredationOutcome> outcomes(numPairs);
+  predation(population, pairs.data(), numPairs, params, random,
+            outcomes.data());
+  for (unsigned k = 0; k < numPairs; k++) {
+    EXPECT_EQ(outcomes[k], predation(population, pairs[2 * k],
+                                     pairs[2 * k + 1], params, random));
+  }
+
+  /* With noise the first agent wins with probability `P(p < K)` */
+  params.sigmaPredation = 1.0;
+  params.lambdaPredation = 0.0;
+  const double S = sqrt(64 * 4);
+  int score = predationScoreWords(population.chromosome(0),
+                                  population.chromosome(1),
+                                  population.stride());
+  ASSERT_NE(score, 0);
+  pairs.assign(2 * numPairs, 0);
+  for (unsigned k = 0; k < numPairs; k++) {
+    pairs[2 * k + 1] = 1;
+  }
+
+  unsigned numFirst = 0;
+  const unsigned numTrials = 20;
+  for (unsigned n = 0; n < numTrials; n++) {
+    predation(population, pairs.data(), numPairs, params, random,
+              outcomes.data());
+    for (unsigned k = 0; k < numPairs; k++) {
+      PredationOutcome expected = score > 0 ? PREDATION_FIRST_SURVIVES :
+                                  PREDATION_SECOND_SURVIVES;
+      EXPECT_NE(outcomes[k], score > 0 ? PREDATION_SECOND_SURVIVES :
+                PREDATION_FIRST_SURVIVES);
+      numFirst += outcomes[k] == expected;
+    }
+  }
+
+  double expected = 0.5 * erfc(- std::abs(score) / (S * sqrt(2.0)));
+  EXPECT_NEAR((double) numFirst / (numTrials * numPairs), expected, 0.02)
+      << "score " << score;
+}
+
+TEST(genetics, batchedMating) {
+  Parameters params;
+  params.muMating = 0.5;
+  Random random(8);
+
+  /* Slot 0 is blank, slot 1 differs from it in 16 bits (d = 0.25), and
+   * slot 2 in every bit (d = 8) */
+  Population population(64);
+  for (unsigned n = 0; n < 3; n++) {
+    unsigned slot = population.allocate();
+    Buffer::Word *c = population.chromosome(slot);
+    for (unsigned k = 0; k < 8; k++) {
+      c[k] = n == 0 ? 0 : n == 1 ? 0x3 : UINT64_MAX;
+    }
+    population.countOnes(slot);
+  }
+
+  /* Identical chromosomes always mate, opposite ones never, and the rest
+   * with probability `(1 - d)^beta` */
+  const unsigned numPairs = 600;
+  const unsigned numWords = (numPairs + 63) / 64;
+  const unsigned partners[] = {0, 2, 1};
+  const double probabilities[] = {1.0, 0.0, 0.75};
+  std::vector<unsigned> pairs(2 * numPairs);
+  std::vector<uint64_t> mask(numWords);
+
+  for (unsigned n = 0; n < 3; n++) {
+    for (unsigned k = 0; k < numPairs; k++) {
+      pairs[2 * k] = 0;
+      pairs[2 * k + 1] = partners[n];
+    }
+
+    unsigned numBatched = 0;
+    unsigned numSingle = 0;
+    for (unsigned trial = 0; trial < 10; trial++) {
+      mask.assign(numWords, UINT64_MAX);
+      mate(population, pairs.data(), numPairs, params, random, mask.data());
+      EXPECT_EQ(mask.back() >> (numPairs % 64), 0);
+      for (unsigned k = 0; k < numPairs; k++) {
+        numBatched += (mask[k / 64] >> (k % 64)) & 1;
+        numSingle += mate(population, 0, partners[n], params, random);
+      }
+    }
+
+    EXPECT_NEAR(numBatched / (10.0 * numPairs), probabilities[n], 0.02);
+    EXPECT_NEAR(numSingle / (10.0 * numPairs), probabilities[n], 0.02);
+  }
+}
+
 TEST(genetics, serialization) {
   Agent a(4, 0x00);
   a[1] = 0x01;
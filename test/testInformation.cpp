@@ -2,6 +2,7 @@
 #include <cmath>
 #include <fstream>
 #include "information.h"
+#include "kernels.h"
 
 
 TEST(information, buffer) {
@@ -20,6 +21,31 @@ TEST(information, buffer) {
   EXPECT_EQ(b ^ b, a);
 }
 
+TEST(information, bufferWords) {
+  Buffer a(13, 0x00);
+
+  /* Storage is aligned and padded to whole blocks */
+  EXPECT_EQ((uintptr_t) a.words() % 64, 0);
+  EXPECT_EQ(a.numWords() % Buffer::blockWords, 0);
+  EXPECT_GE(a.numWords() * Buffer::wordBytes, a.size());
+
+  /* Negation must not leak into the padding */
+  Buffer b = ~a;
+  EXPECT_EQ(hammingWeight(b), 8 * a.size());
+  EXPECT_EQ(b, Buffer(13, 0xFF));
+
+  /* Bit access across a word boundary agrees with the byte view */
+  a.flipBit(63);
+  a.flipBit(64);
+  EXPECT_EQ(a.getBit(63), 1);
+  EXPECT_EQ(a.getBit(64), 1);
+  EXPECT_EQ((unsigned char) a[7], 0x80);
+  EXPECT_EQ((unsigned char) a[8], 0x01);
+
+  a.resize(8);
+  EXPECT_EQ(hammingWeight(a), 1);
+}
+
 TEST(information, hammingSingleChar) {
   Buffer buffer(1, 0x00);
   EXPECT_EQ(hammingWeight(buffer), 0);
@@ -80,6 +106,60 @@ TEST(information, distance) {
   EXPECT_LE(dAC, dAB + dBC);
 }
 
+TEST(information, popcountKernels) {
+  const PopcountKernel kernels[] = {
+    POPCOUNT_TABLE, POPCOUNT_SCALAR, POPCOUNT_POPCNT, POPCOUNT_AVX2,
+    POPCOUNT_AVX512
+  };
+
+  /* Sizes chosen to hit the vector blocks, every kind of tail and every
+   * fixed-length kernel */
+  const unsigned sizes[] = {1, 7, 64, 200, 256, 1000, 1024, 4099};
+
+  for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    Buffer a(sizes[s], 0x00);
+    Buffer b(sizes[s], 0x00);
+    for (unsigned k = 0; k < a.size(); k++) {
+      a[k] = (char)(k * 37 + 11);
+      b[k] = (char)(k * k + 5);
+    }
+
+    /* Reference counts, one bit at a time */
+    unsigned weight = 0;
+    unsigned dist = 0;
+    for (unsigned k = 0; k < 8 * a.size(); k++) {
+      weight += a.getBit(k);
+      dist += a.getBit(k) ^ b.getBit(k);
+    }
+
+    for (unsigned n = 0; n < sizeof(kernels) / sizeof(kernels[0]); n++) {
+      if (!popcountKernelSupported(kernels[n])) {
+        continue;
+      }
+
+      setPopcountKernel(kernels[n]);
+      EXPECT_EQ(getPopcountKernel(), kernels[n]);
+      for (int fixed = 0; fixed < 2; fixed++) {
+        setFixedLengthKernels(fixed);
+        EXPECT_EQ(hammingWeight(a), weight)
+            << popcountKernelName(kernels[n]) << " fixed " << fixed;
+        EXPECT_EQ(distance(a, b), dist)
+            << popcountKernelName(kernels[n]) << " fixed " << fixed;
+      }
+    }
+  }
+
+  EXPECT_TRUE(getFixedLengthKernels());
+  setPopcountKernel(POPCOUNT_AUTO);
+  EXPECT_NE(getPopcountKernel(), POPCOUNT_AUTO);
+}
+
+TEST(information, distanceSizeMismatch) {
+  Buffer a(4, 0x00);
+  Buffer b(5, 0x00);
+  EXPECT_THROW(distance(a, b), std::invalid_argument);
+}
+
 TEST(information, bitFlip) {
   Buffer a(20, 0x00);
   Buffer b(a);
@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+#include "kernels.h"
+#include "migrants.h"
+#include "population.h"
+
+
+TEST(population, slots) {
+  Population p(100);
+  EXPECT_EQ(p.size(), 0);
+  EXPECT_EQ(p.stride(), Buffer::paddedNumWords(100));
+
+  unsigned a = p.allocate();
+  unsigned b = p.allocate();
+  EXPECT_NE(a, b);
+  EXPECT_EQ(p.size(), 2);
+
+  /* Every slot starts on a cache line */
+  EXPECT_EQ((uintptr_t) p.chromosome(a) % 64, 0);
+  EXPECT_EQ((uintptr_t) p.chromosome(b) % 64, 0);
+
+  /* Released slots are reused, and come back blank */
+  p.chromosome(a)[0] = 0xFF;
+  p.setEnergy(a, 3);
+  p.release(a);
+  EXPECT_EQ(p.size(), 1);
+
+  unsigned c = p.allocate();
+  EXPECT_EQ(c, a);
+  EXPECT_EQ(p.chromosome(c)[0], 0);
+  EXPECT_EQ(p.getEnergy(c), 0);
+}
+
+TEST(population, claims) {
+  Population p(16);
+  Population q(16);
+  for (unsigned n = 0; n < 6; n++) {
+    p.allocate();
+    q.allocate();
+  }
+  p.release(4);
+  p.release(1);
+  q.release(4);
+  q.release(1);
+
+  /* Claim `j` is the slot the `j`th `allocate` hands out, growing past the
+   * free list if needed */
+  p.openClaims(5);
+  EXPECT_EQ(p.capacity(), 9);
+  unsigned claims[5];
+  for (unsigned j = 0; j < 5; j++) {
+    claims[j] = p.claim(j);
+  }
+
+  for (unsigned j = 0; j < 3; j++) {
+    EXPECT_EQ(q.allocate(), claims[j]);
+  }
+
+  /* Only the claims taken leave the free list */
+  p.closeClaims(3);
+  EXPECT_EQ(p.size(), 7);
+  EXPECT_EQ(p.allocate(), claims[3]);
+  EXPECT_EQ(p.allocate(), claims[4]);
+}
+
+TEST(population, agents) {
+  Population p(13);
+  Agent a(13, 0x5A, 2.5);
+  a[12] = 0x01;
+
+  unsigned slot = p.insert(a);
+  Agent b = p.getAgent(slot);
+  EXPECT_EQ(a.getChromosomeConst(), b.getChromosomeConst());
+  EXPECT_EQ(a.getEnergy(), b.getEnergy());
+  EXPECT_EQ(p.getNumOnes(slot), 4 * 12 + 1);
+  EXPECT_EQ(b.getNumOnes(), p.getNumOnes(slot));
+
+  Agent c(12, 0x00);
+  EXPECT_THROW(p.insert(c), std::invalid_argument);
+}
+
+TEST(population, genetics) {
+  Parameters params = {};
+  params.lambdaScoreFeed = 1.0;
+  params.muMating = 0.5;
+
+  Population p(16);
+  Agent a(16, 0x0F, 1.0);
+  Agent b(16, (char) 0xA5, 1.0);
+  unsigned sa = p.insert(a);
+  unsigned sb = p.insert(b);
+
+  /* Slot overloads agree with the agent versions */
+  Random r1(5);
+  Random r2(5);
+  EXPECT_EQ(predation(p, sa, sb, params, r1), predation(a, b, params, r2));
+  EXPECT_EQ(mate(p, sa, sb, params, r1), mate(a, b, params, r2));
+
+  feed(p, sa, sb, params);
+  feed(a, b, params);
+  EXPECT_DOUBLE_EQ(p.getEnergy(sa), a.getEnergy());
+}
+
+TEST(population, crossover) {
+  Parameters params = {};
+  params.muNumCrossovers = 6.0;
+  params.lambdaEnergy = 2.0;
+  params.muNumMutations = 10.0;
+
+  const unsigned size = 45;
+  Population p(size);
+  Agent a(size, 0x00);
+  Agent b(size, 0x00);
+  for (unsigned k = 0; k < size; k++) {
+    a[k] = (char)(3 * k + 1);
+    b[k] = (char)(~(3 * k + 1));
+  }
+  unsigned sa = p.insert(a);
+  unsigned sb = p.insert(b);
+
+  for (unsigned seed = 0; seed < 20; seed++) {
+    unsigned child = p.allocate(false);
+    const Buffer::Word *w = p.chromosome(child);
+    Random r1(seed);
+    Random r2(seed);
+    crossover(p, sa, sb, child, params, r1);
+    Agent c = crossover(a, b, params, r2);
+
+    /* Same child either way */
+    EXPECT_EQ(p.getAgent(child).getChromosomeConst(), c.getChromosomeConst());
+    EXPECT_EQ(p.getEnergy(child), params.lambdaEnergy);
+
+    /* The cached weight is right, whatever the slot held before */
+    EXPECT_EQ(p.getNumOnes(child), hammingWeight(c.getChromosomeConst()));
+    mutate(p, child, params, r1);
+    EXPECT_EQ(p.getNumOnes(child), popcountWords(w, p.stride()));
+
+    /* Every byte comes from one of the parents, padding stays zero */
+    for (unsigned k = 0; k < size; k++) {
+      EXPECT_TRUE(c[k] == a[k] || c[k] == b[k]);
+    }
+    EXPECT_EQ(w[p.stride() - 1], 0);
+
+    p.release(child);
+  }
+}
+
+TEST(population, copies) {
+  Population p(20);
+  unsigned a = p.allocate();
+  p.chromosome(a)[1] = 0x0F;
+  p.countOnes(a);
+  p.setEnergy(a, 4);
+
+  /* Copies are deep */
+  Population q(p);
+  q.chromosome(a)[1] = 0;
+  EXPECT_EQ(p.chromosome(a)[1], 0x0F);
+  EXPECT_EQ(q.getNumOnes(a), 4);
+  EXPECT_EQ(q.size(), 1);
+
+  Population r(std::move(p));
+  EXPECT_EQ(r.getEnergy(a), 4);
+  EXPECT_EQ(r.chromosome(a)[1], 0x0F);
+}
+
+TEST(population, external) {
+  const unsigned size = 24;
+  const unsigned stride = Buffer::paddedNumWords(size);
+  Buffer::WordVector slab(4 * stride, 0);
+  std::vector<double> energy(4, 1.0);
+  std::vector<unsigned> numOnes(4, 0);
+  slab[stride] = 0x3;
+  numOnes[1] = 2;
+
+  std::shared_ptr<void> owner = std::make_shared<int>(0);
+  Population p(size, 2, 4, slab.data(), energy.data(), numOnes.data(), owner);
+  EXPECT_TRUE(p.isExternal());
+  EXPECT_EQ(p.size(), 2);
+  EXPECT_EQ(p.capacity(), 4);
+  EXPECT_EQ(p.chromosome(1), slab.data() + stride);
+
+  /* Allocating within the capacity stays in place */
+  unsigned c = p.allocate();
+  EXPECT_EQ(c, 2);
+  EXPECT_TRUE(p.isExternal());
+
+  /* Growing moves into owned memory and keeps the agents */
+  p.reserve(16);
+  EXPECT_FALSE(p.isExternal());
+  EXPECT_EQ(p.chromosome(1)[0], 0x3);
+  EXPECT_EQ(p.getNumOnes(1), 2);
+  EXPECT_EQ(p.getEnergy(0), 1.0);
+  EXPECT_EQ(p.size(), 3);
+}
+
+TEST(population, migrants) {
+  Population p(13);
+  Agent a(13, 0x5A, 2.5);
+  a[12] = 0x01;
+  Agent b(13, 0x0F, 0.5);
+
+  MigrantBatch batch(13);
+  batch.append(p, p.insert(a));
+  batch.append(p, p.insert(b));
+  EXPECT_EQ(batch.size(), 2);
+  EXPECT_EQ(batch.data().size(), 16 + 2 * (8 + 13));
+
+  /* The message is all that travels */
+  MigrantBatch received;
+  received.data() = batch.data();
+  received.validate();
+  ASSERT_EQ(received.size(), 2);
+  EXPECT_EQ(received.sizeChromosome(), 13);
+
+  Population q(13);
+  unsigned slot = received.insert(q, 0);
+  EXPECT_EQ(q.getAgent(slot).getChromosomeConst(), a.getChromosomeConst());
+  EXPECT_EQ(q.getEnergy(slot), 2.5);
+  EXPECT_EQ(q.getNumOnes(slot), 4 * 12 + 1);
+
+  slot = received.insert(q, 1);
+  EXPECT_EQ(q.getAgent(slot).getChromosomeConst(), b.getChromosomeConst());
+  EXPECT_EQ(q.getEnergy(slot), 0.5);
+
+  Population r(12);
+  EXPECT_THROW(received.insert(r, 0), std::invalid_argument);
+
+  received.data().pop_back();
+  EXPECT_THROW(received.validate(), std::runtime_error);
+  received.data() = "not a batch of agents";
+  EXPECT_THROW(received.validate(), std::runtime_error);
+
+  /* Clearing keeps the memory for the next batch */
+  size_t capacity = batch.data().capacity();
+  batch.clear(13);
+  EXPECT_EQ(batch.size(), 0);
+  EXPECT_EQ(batch.data().capacity(), capacity);
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "threadpool.h"
+
+static const unsigned numTasks = 1000;
+
+/* Pools of one to four threads, with every pinning */
+template <typename Function>
+static void forEachPool(Function function) {
+  const ThreadPinning pinnings[] = {PINNING_NONE, PINNING_CORES, PINNING_NUMA};
+  for (ThreadPinning pinning : pinnings) {
+    for (unsigned numThreads = 1; numThreads <= 4; numThreads++) {
+      ThreadPool pool(numThreads, pinning);
+      EXPECT_EQ(pool.size(), numThreads);
+      function(pool);
+    }
+  }
+}
+
+TEST(threadPool, everyTaskOnce) {
+  forEachPool([](ThreadPool &pool) {
+
+    /* A few tasks are much longer than the others, and get their
+     * neighbours stolen */
+    std::vector<std::atomic<unsigned> > runs(numTasks);
+    for (unsigned k = 0; k < numTasks; k++) {
+      runs[k].store(0);
+    }
+    pool.parallelFor(numTasks, [&](unsigned task, unsigned thread) {
+      EXPECT_LT(thread, pool.size());
+      if (task % 97 == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+      runs[task] += 1;
+    });
+    for (unsigned k = 0; k < numTasks; k++) {
+      EXPECT_EQ(runs[k].load(), 1u);
+    }
+
+    pool.parallelFor(0, [](unsigned, unsigned) {
+      FAIL();
+    });
+  });
+}
+
+TEST(threadPool, stealing) {
+  ThreadPool pool(3);
+
+  /* Task 0 is the first of the range of its thread, and only returns once
+   * the other threads have run everything else, the rest of its range
+   * included */
+  std::atomic<unsigned> numDone(0);
+  std::atomic<bool> stolen(false);
+  pool.parallelFor(numTasks, [&](unsigned task, unsigned) {
+    if (task == 0) {
+      auto deadline = std::chrono::steady_clock::now() +
+                      std::chrono::seconds(10);
+      while (numDone.load() < numTasks - 1 &&
+             std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      stolen = numDone.load() == numTasks - 1;
+    }
+    numDone += 1;
+  });
+  EXPECT_TRUE(stolen.load());
+}
+
+TEST(threadPool, reduceInTaskOrder) {
+  forEachPool([](ThreadPool &pool) {
+    std::vector<std::string> partials;
+    std::string result = "tasks:";
+    pool.parallelReduce(numTasks, partials, result,
+    [](unsigned task, unsigned, std::string &partial) {
+      partial = std::to_string(task) + ",";
+    }, [](std::string &result, const std::string &partial) {
+      result += partial;
+    });
+
+    std::string expected = "tasks:";
+    for (unsigned k = 0; k < numTasks; k++) {
+      expected += std::to_string(k) + ",";
+    }
+    EXPECT_EQ(result, expected);
+  });
+}
+
+TEST(threadPool, exceptions) {
+  forEachPool([](ThreadPool &pool) {
+    std::atomic<unsigned> numRun(0);
+    EXPECT_THROW(pool.parallelFor(numTasks, [&](unsigned task, unsigned) {
+      numRun += 1;
+      if (task == 500) {
+        throw std::runtime_error("task");
+      }
+    }), std::runtime_error);
+
+    /* The other tasks still ran, and the pool is usable again */
+    EXPECT_EQ(numRun.load(), numTasks);
+    pool.parallelFor(numTasks, [](unsigned, unsigned) { });
+  });
+}
+
+TEST(threadPool, pinning) {
+  EXPECT_EQ(parseThreadPinning("none"), PINNING_NONE);
+  EXPECT_EQ(parseThreadPinning("cores"), PINNING_CORES);
+  EXPECT_EQ(parseThreadPinning("numa"), PINNING_NUMA);
+  EXPECT_THROW(parseThreadPinning("sockets"), std::invalid_argument);
+
+  EXPECT_EQ(getThreadPinning(), PINNING_NONE);
+  setThreadPinning(PINNING_NUMA);
+  EXPECT_EQ(getThreadPinning(), PINNING_NUMA);
+  setThreadPinning(PINNING_NONE);
+
+  EXPECT_FALSE(numaNodes().empty());
+}